@@ -125,14 +125,34 @@ bool NetApp::init()
 	if (!listen.parse(config_.get<std::string>("listen")))
 		return false;
 
-	server_.reset(new NetAsio::Acceptor(listen.host, 
-		boost::lexical_cast<std::string>(listen.port),
-		*io_service_pool_,
-		*worker_pool_, 
-		server_dispatcher_));
-	if (server_)
+	//
+	// thread-per-core: 每个核一个分片，各自监听(SO_REUSEPORT)并在本线程处理消息
+	//
+	const size_t cores = config_.get("cores", 0);
+	if (cores > 0)
 	{
-		server_->listen();
+		core_pool_.reset(new NetAsio::CorePool(cores, server_dispatcher_,
+			config_.get("pincores", 0) != 0));
+		if (!core_pool_ || !core_pool_->init())
+		{
+			LOG4CXX_ERROR(logger, "NetApp::init core_pool_ init failed");
+			return false;
+		}
+
+		if (!core_pool_->listen(listen.host, boost::lexical_cast<std::string>(listen.port)))
+			return false;
+	}
+	else
+	{
+		server_.reset(new NetAsio::Acceptor(listen.host, 
+			boost::lexical_cast<std::string>(listen.port),
+			*io_service_pool_,
+			*worker_pool_, 
+			server_dispatcher_));
+		if (server_)
+		{
+			server_->listen();
+		}
 	}
 
 	clients_.reset(new NetAsio::Connector(
@@ -146,7 +166,7 @@ bool NetApp::init()
 		{
 			if (v.first == "connect")
 			{
-				URL url;
+				TinyURL url;
 				if (url.parse(v.second.data()))
 				{
 					std::cout << url.make() << std::endl;
@@ -174,6 +194,9 @@ void NetApp::run()
 
 	if (worker_pool_)
 		worker_pool_->run();
+
+	if (core_pool_)
+		core_pool_->run();
 }
 
 void NetApp::fini()
@@ -181,6 +204,9 @@ void NetApp::fini()
 	if (server_)
 		server_->close();
 
+	if (core_pool_)
+		core_pool_->close();
+
 	if (clients_)
 		clients_->close();
 
@@ -188,6 +214,17 @@ void NetApp::fini()
 		io_service_pool_->fini();
 	if (worker_pool_)
 		worker_pool_->fini();
+	if (core_pool_)
+		core_pool_->fini();
+}
+
+size_t NetApp::sessionCount()
+{
+	if (core_pool_)
+		return core_pool_->sessionCount();
+	if (server_)
+		return server_->size();
+	return 0;
 }
 
 bool NetApp::loadConfig()
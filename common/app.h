@@ -7,6 +7,7 @@
 #include <boost/property_tree/ptree.hpp>
 #include "net_asio/acceptor.h"
 #include "net_asio/connector.h"
+#include "net_asio/core_pool.h"
 #include "mylogger.h"
 
 //
@@ -90,15 +91,55 @@ public:
 
 	std::string makeNodeName(const std::string& name);
 
-	bool sendTo(uint id);
-	bool broadcastTo(uint type);
-	bool broadcastToAll();
+	//
+	// 发送给本节点接受的连接(会话):
+	//   广播基于分片快照，不阻塞新连接的接入
+	//   thread-per-core模式下投递到各个核分片执行
+	//
+	template <typename ProtoT>
+	bool sendTo(uint32 id, const ProtoT& proto)
+	{
+		if (core_pool_)
+			core_pool_->sendTo(id, proto);
+		else if (server_)
+			server_->sendTo(id, proto);
+		else
+			return false;
+		return true;
+	}
+
+	template <typename ProtoT>
+	bool broadcastTo(uint32 type, const ProtoT& proto)
+	{
+		if (core_pool_)
+			core_pool_->broadcastTo(type, proto);
+		else if (server_)
+			server_->broadcastTo(type, proto);
+		else
+			return false;
+		return true;
+	}
+
+	template <typename ProtoT>
+	bool broadcastToAll(const ProtoT& proto)
+	{
+		if (core_pool_)
+			core_pool_->broadcastToAll(proto);
+		else if (server_)
+			server_->broadcastToAll(proto);
+		else
+			return false;
+		return true;
+	}
 
 	boost::asio::io_service* get_signal_service()
 	{
 		return worker_pool_ ? &worker_pool_->get_io_service() : NULL;
 	}
 
+	/// 当前会话数
+	size_t sessionCount();
+
 	/// TODO:临时用法
 	boost::shared_ptr<NetAsio::Acceptor> acceptor() { return server_; }
 	boost::shared_ptr<NetAsio::Connector> connector() { return clients_; }
@@ -110,6 +151,9 @@ protected:
 
 	/// 扮演服务器
 	boost::shared_ptr<NetAsio::Acceptor> server_;
+
+	/// 扮演服务器(thread-per-core模式，配置<cores>大于0时启用)
+	boost::shared_ptr<NetAsio::CorePool> core_pool_;
 	ProtobufMsgDispatcher& server_dispatcher_;
 
 	/// 扮演客户端
@@ -98,41 +98,34 @@ public:
     static bool packMsgByName(std::string &buf, const std::string &name, const MsgT &msg) {
         if (name.empty()) return false;
 
-        std::string data = serialize<SerializerT, MsgT>(msg);
-        if (data.empty()) return false;
+        buf.assign(sizeof(MessageHeader) + name.size(), '\0');
 
-        buf.resize(sizeof(MessageHeader) + name.size() + data.size());
+        uint8_t *msg_name = (uint8_t *) (buf.data()) + sizeof(MessageHeader);
+        memcpy(msg_name, name.c_str(), name.size());
+
+        // body is encoded right after the name
+        if (!serializeTo<SerializerT, MsgT>(buf, msg)) return false;
 
         MessageHeader *header = (MessageHeader *) buf.data();
         {
-            header->size = name.size() + data.size();
+            header->size = buf.size() - sizeof(MessageHeader);
             header->type_is_name = 1;
             header->type_len = name.size();
         }
-
-        uint8_t *msg_name = (uint8_t *) (buf.data()) + sizeof(MessageHeader);
-        memcpy(msg_name, name.c_str(), name.size());
-
-        uint8_t *msg_proto = msg_name + name.size();
-        memcpy(msg_proto, data.data(), data.size());
         return true;
     }
 
     template<template<typename> class SerializerT = ProtoSerializer, typename MsgT>
     static bool packMsgByType(std::string &buf, uint16_t type, const MsgT &msg) {
-        std::string data = serialize<SerializerT, MsgT>(msg);
-        if (data.empty()) return false;
+        buf.assign(sizeof(MessageHeader), '\0');
+        if (!serializeTo<SerializerT, MsgT>(buf, msg)) return false;
 
-        buf.resize(sizeof(MessageHeader) + data.size());
         MessageHeader *header = (MessageHeader *) buf.data();
         {
-            header->size = data.size();
+            header->size = buf.size() - sizeof(MessageHeader);
             header->type_is_name = 0;
             header->type = type;
         }
-
-        uint8_t *msg_proto = (uint8_t *) (buf.data()) + sizeof(MessageHeader);
-        memcpy(msg_proto, data.data(), data.size());
         return true;
     };
 
@@ -159,7 +152,7 @@ public:
     // Return Is:
     //  is  nullptr - no  reply
     //  not nullptr - has reply
-    virtual MessageBufferPtr process(const std::string &msgbody, ArgTypes... args) const = 0;
+    virtual MessageBufferPtr process(const char *msgbody, size_t size, ArgTypes... args) const = 0;
 
 
     uint16_t msgtype() const { return msgtype_; }
@@ -204,10 +197,11 @@ public:
 
     virtual ~MessageHandlerT_N() {}
 
-    MessageBufferPtr process(const std::string &msgbody, ArgTypes... args) const final {
-        RequestT request;
-        if (deserialize<SerializerT, RequestT>(request, msgbody)) {
-            ReplyT reply = handler_(request, args...);
+    MessageBufferPtr process(const char *msgbody, size_t size, ArgTypes... args) const final {
+        ProtoArenaScope scope;
+        ProtoArenaObject<RequestT> request(scope.arena());
+        if (deserializeFrom<SerializerT, RequestT>(request.get(), msgbody, size)) {
+            ReplyT reply = handler_(request.get(), args...);
 
             auto buff = std::make_shared<MessageBuffer>();
             if (DispatcherT::template write2Buffer<SerializerT, ReplyT>(*buff.get(), reply))
@@ -244,10 +238,11 @@ public:
 
     virtual ~MessageHandlerT_N() {}
 
-    MessageBufferPtr process(const std::string &msgbody, ArgTypes... args) const final {
-        RequestT request;
-        if (deserialize<SerializerT, RequestT>(request, msgbody)) {
-            handler_(request, args...);
+    MessageBufferPtr process(const char *msgbody, size_t size, ArgTypes... args) const final {
+        ProtoArenaScope scope;
+        ProtoArenaObject<RequestT> request(scope.arena());
+        if (deserializeFrom<SerializerT, RequestT>(request.get(), msgbody, size)) {
+            handler_(request.get(), args...);
             return nullptr;
         } else {
             throw MsgDispatcherException("deserialize faileds");
@@ -300,19 +295,32 @@ public:
     // Message Dispatching
     //
     MessageBufferPtr dispatch(const std::string &msgdata, ArgTypes... args) {
-        MessageHeader *msgheader = (MessageHeader *) msgdata.data();
+        return dispatch(msgdata.data(), msgdata.size(), args...);
+    }
+
+    MessageBufferPtr dispatch(const char *msgdata, size_t msgsize, ArgTypes... args) {
+        if (msgsize < sizeof(MessageHeader)) {
+            throw MsgDispatcherException("message size is invalid");
+            return nullptr;
+        }
+
+        MessageHeader *msgheader = (MessageHeader *) msgdata;
 
         if (msgheader->type_is_name) {
             throw MsgDispatcherException("message header error");
             return nullptr;
         }
 
-        uint8_t *msg_body = (uint8_t *) msgheader + sizeof(MessageHeader);
-        std::string msgbody((char *) msg_body, msgheader->size);
+        if (msgheader->msgsize() > msgsize) {
+            throw MsgDispatcherException("message size is invalid");
+            return nullptr;
+        }
+
+        const char *msg_body = msgdata + sizeof(MessageHeader);
 
         auto it = handlers_.find(msgheader->type);
         if (it != handlers_.end()) {
-            return it->second->process(msgbody, args...);
+            return it->second->process(msg_body, msgheader->size, args...);
         } else {
             throw MsgDispatcherException("handler not exist for : " + std::to_string(msgheader->type));
         }
@@ -386,31 +394,34 @@ public:
     // Message Dispatching
     //
     MessageBufferPtr dispatch(const std::string &msgdata, ArgTypes... args) {
-        if (msgdata.size() < sizeof(MessageHeader)) {
+        return dispatch(msgdata.data(), msgdata.size(), args...);
+    }
+
+    MessageBufferPtr dispatch(const char *msgdata, size_t msgsize, ArgTypes... args) {
+        if (msgsize < sizeof(MessageHeader)) {
             throw MsgDispatcherException("message size is invalid");
             return nullptr;
         }
 
-        MessageHeader *msgheader = (MessageHeader *) msgdata.data();
-        if (msgheader->msgsize() != msgdata.size()) {
+        MessageHeader *msgheader = (MessageHeader *) msgdata;
+        if (msgheader->msgsize() != msgsize) {
             throw MsgDispatcherException("message size is invalid");
             return nullptr;
         }
 
-        if (0 == msgheader->type_is_name || 0 == msgheader->type_len) {
+        if (0 == msgheader->type_is_name || 0 == msgheader->type_len || msgheader->type_len > msgheader->size) {
             throw MsgDispatcherException("message header error");
             return nullptr;
         }
 
-        const char *msg_name = (char *) msgheader + sizeof(MessageHeader);
-        uint8_t *msg_body = (uint8_t *) msg_name + msgheader->type_len;
+        const char *msg_name = msgdata + sizeof(MessageHeader);
+        const char *msg_body = msg_name + msgheader->type_len;
 
         std::string msgname(msg_name, msgheader->type_len);
-        std::string msgbody((char *) msg_body, msgheader->size - msgheader->type_len);
 
         auto it = handlers_.find(msgname);
         if (it != handlers_.end()) {
-            return it->second->process(msgbody, args...);
+            return it->second->process(msg_body, msgheader->size - msgheader->type_len, args...);
         } else {
             throw MsgDispatcherException("handler not exist for : " + msgname);
         }
@@ -1,42 +1,201 @@
 #include "mycache2.h"
 #include "mylogger.h"
+#include "redis.h"
+#include <atomic>
+#include <ctime>
 
 static LoggerPtr logger(Logger::getLogger("mycache"));
 
 
 //////////////////////////////////////////////////////////////////////
 
+//
+// Invalidations of the L0, by Redis client-side caching in broadcast mode
+// (RESP2): a subscriber on the loop gets __redis__:invalidate, and a second
+// connection on the loop turns the tracking on redirected to it. Both are
+// checked every second, without a round trip: a connection is lost once
+// hiredis has called its disconnect callback, and then set up again, the
+// tracked keys in L0 are dropped meanwhile.
+//
+class L0Tracking
+{
+public:
+	L0Tracking(SyncMyCache* cache, const std::string& url, const std::vector<std::string>& prefixes, tiny::EventLoop* loop)
+		: cache_(cache), prefixes_(prefixes), subscriber_(url, loop), tracker_(url, loop),
+		  redirect_(0), live_(false), setup_since_(0)
+	{
+		loop->onTimer([this]() { check(); }, 1.0, 0.0);
+	}
+
+	// BCAST without prefix tracks every key
+	bool tracked(const std::string& key) const
+	{
+		if (prefixes_.empty())
+			return true;
+
+		for (std::vector<std::string>::const_iterator it = prefixes_.begin(); it != prefixes_.end(); ++ it)
+		{
+			if (key.compare(0, it->size(), *it) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool live() const { return live_; }
+
+	void check()
+	{
+		// a reply may never come if the subscriber is lost meanwhile
+		if (setup_since_ && time(NULL) - setup_since_ < 5)
+			return;
+
+		if (!subscriber_.isConnected())
+			redirect_ = 0;
+
+		// a reconnected tracker has no tracking on, only this one connection has
+		if (live_ && redirect_ && tracker_.isConnected())
+			return;
+
+		if (live_)
+		{
+			LOG4CXX_WARN(logger, "L0Tracking: lost, L0 of the tracked keys dropped");
+			live_ = false;
+		}
+
+		cache_->invalidate_inproc(prefixes_);
+		setup();
+	}
+
+protected:
+	// CLIENT ID of the subscriber, SUBSCRIBE, then CLIENT TRACKING
+	void setup()
+	{
+		setup_since_ = time(NULL);
+
+		// still subscribed, only the tracker was lost
+		if (redirect_)
+		{
+			enable(redirect_);
+			return;
+		}
+
+		subscriber_.cmd<uint64_t>({"CLIENT", "ID"}, [this](tiny::RedisCommand<uint64_t>& c) {
+			if (!c.ok())
+			{
+				setup_since_ = 0;
+				return;
+			}
+
+			const uint64_t redirect = c.reply();
+			bool ok = subscriber_.subscribe({"SUBSCRIBE", "__redis__:invalidate"}, [this, redirect](const RedisReplyView& reply) {
+				if (reply[0].str() == "subscribe")
+				{
+					redirect_ = redirect;
+					enable(redirect);
+				}
+				else if (reply[0].str() == "message")
+				{
+					onInvalidate(reply[2]);
+				}
+			});
+
+			if (!ok)
+				setup_since_ = 0;
+		});
+	}
+
+	void enable(uint64_t redirect)
+	{
+		std::vector<std::string> args = {"CLIENT", "TRACKING", "on", "REDIRECT", std::to_string(redirect), "BCAST"};
+		for (std::vector<std::string>::const_iterator it = prefixes_.begin(); it != prefixes_.end(); ++ it)
+		{
+			args.push_back("PREFIX");
+			args.push_back(*it);
+		}
+
+		tracker_.cmd<std::string>(args, [this, redirect](tiny::RedisCommand<std::string>& c) {
+			if (c.ok() && c.reply() == "OK")
+			{
+				live_ = tracker_.isConnected();
+				LOG4CXX_INFO(logger, "L0Tracking: on, redirect to " << redirect);
+			}
+			else
+			{
+				LOG4CXX_ERROR(logger, "L0Tracking: CLIENT TRACKING failed");
+			}
+
+			setup_since_ = 0;
+		});
+	}
+
+	// keys, or nil when the server flushed
+	void onInvalidate(const RedisReplyView& keys)
+	{
+		if (keys.isNil())
+		{
+			cache_->invalidate_inproc(prefixes_);
+			return;
+		}
+
+		for (size_t i = 0; i < keys.size(); ++ i)
+			cache_->invalidate_inproc(keys[i].str().str());
+	}
+
+private:
+	SyncMyCache* cache_;
+	const std::vector<std::string> prefixes_;
+
+	tiny::AsyncRedisClient subscriber_;
+	tiny::AsyncRedisClient tracker_;
+	uint64_t redirect_;
+
+	std::atomic<bool> live_;
+	time_t setup_since_;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+SyncMyCache::SyncMyCache() : generation_(0), tracking_(NULL)
+{
+}
+
+SyncMyCache::~SyncMyCache()
+{
+	delete tracking_;
+	close();
+}
+
 bool SyncMyCache::connect(int level, const std::string& address)
 {
 	if (level <= 0) return false;
 
 	boost::lock_guard<boost::mutex> guard(mutex_);
 
-	RedisConnectionPool* pool = new RedisConnectionPool();
-	if (pool)
+	RedisMultiplexer*& node = nodes_[address];
+	if (!node)
 	{
-		pool->setServerAddress(address);
-		pool->createAll();
-		clients_[level] = pool;
-		return true;
+		node = new RedisMultiplexer(address);
+		node->start();
 	}
 
-	return false;
+	clients_[level] = node;
+	return true;
 }
 
 void SyncMyCache::close()
 {
 	boost::lock_guard<boost::mutex> guard(mutex_);
 
-	for (Connections::iterator it = clients_.begin(); it != clients_.end(); ++ it)
+	for (Nodes::iterator it = nodes_.begin(); it != nodes_.end(); ++ it)
 	{
-		it->second->removeAll();
+		it->second->stop();
 		delete it->second;
 	}
+	nodes_.clear();
 	clients_.clear();
 }
 
-RedisConnectionPool* SyncMyCache::client(int level)
+RedisMultiplexer* SyncMyCache::client(int level)
 {
 	boost::lock_guard<boost::mutex> guard(mutex_);
 	Connections::iterator it = clients_.find(level);
@@ -45,26 +204,30 @@ RedisConnectionPool* SyncMyCache::client(int level)
 	return NULL;
 }
 
-bool SyncMyCache::get_from_remote(mycache::KVMap& kvs, const std::string& key, int level)
+bool SyncMyCache::get_from_remote(const std::vector<std::string>& args, const RedisReplyView::Callback& callback, int level)
 {
 	if (level <= 0) return false;
 
-	ScopedRedisConnection redis(client(level));
+	RedisMultiplexer* redis = client(level);
 	if (redis)
 	{
-		return redis->hgetall(key, kvs);
+		return redis->command_argv(args, callback);
 	}
 	return false;
 }
 
-bool SyncMyCache::set_to_remote(const mycache::KVMap& kvs, const std::string& key, int level)
+bool SyncMyCache::set_to_remote(const std::vector<std::string>& args, int level)
 {
 	if (level <= 0) return false;
 
-	ScopedRedisConnection redis(client(level));
+	RedisMultiplexer* redis = client(level);
 	if (redis)
 	{
-		return redis->hmset(key, kvs);
+		bool ok = false;
+		redis->command_argv(args, [&ok](const RedisReplyView& reply) {
+			ok = (reply.str() == "OK");
+		});
+		return ok;
 	}
 	return false;
 }
@@ -73,10 +236,14 @@ bool SyncMyCache::del_from_remote(const std::string& key, int level)
 {
 	if (level <= 0) return false;
 
-	ScopedRedisConnection redis(client(level));
+	RedisMultiplexer* redis = client(level);
 	if (redis)
 	{
-		return redis->del(key);
+		bool ok = false;
+		redis->command_argv({"DEL", key}, [&ok](const RedisReplyView& reply) {
+			ok = (reply.integer() == 1);
+		});
+		return ok;
 	}
 	return false;
 }
@@ -90,6 +257,58 @@ void SyncMyCache::dump_inproc()
 	}
 }
 
+bool SyncMyCache::track(int level, const std::vector<std::string>& prefixes, tiny::EventLoop* loop)
+{
+	RedisMultiplexer* redis = client(level);
+	if (!redis || !loop || tracking_)
+		return false;
+
+	tracking_ = new L0Tracking(this, redis->url(), prefixes, loop);
+	return true;
+}
+
+void SyncMyCache::invalidate_inproc(const std::string& key)
+{
+	boost::lock_guard<boost::mutex> guard(cache_mutex_);
+	generation_ ++;
+	cache_.erase(key);
+}
+
+void SyncMyCache::invalidate_inproc(const std::vector<std::string>& prefixes)
+{
+	boost::lock_guard<boost::mutex> guard(cache_mutex_);
+	generation_ ++;
+
+	if (prefixes.empty())
+	{
+		cache_.clear();
+		return;
+	}
+
+	for (L0Map::iterator it = cache_.begin(); it != cache_.end(); )
+	{
+		bool matched = false;
+		for (std::vector<std::string>::const_iterator p = prefixes.begin(); p != prefixes.end() && !matched; ++ p)
+			matched = (it->first.compare(0, p->size(), *p) == 0);
+
+		if (matched)
+			it = cache_.erase(it);
+		else
+			++ it;
+	}
+}
+
+bool SyncMyCache::inproc_usable(const std::string& key)
+{
+	return !tracking_ || tracking_->live() || !tracking_->tracked(key);
+}
+
+uint64_t SyncMyCache::inproc_generation()
+{
+	boost::lock_guard<boost::mutex> guard(cache_mutex_);
+	return generation_;
+}
+
 
 ///////////////////////////////////////////////////////////////////
 
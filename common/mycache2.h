@@ -7,10 +7,14 @@
 #include <boost/unordered_map.hpp>
 #include <boost/any.hpp>
 #include "myredis.h"
-#include "myredis_pool.h"
+#include "myredis_mux.h"
+#include "mycache2_codec.h"
 
 class SyncMyCache;
 class AsyncMyCache;
+class L0Tracking;
+
+namespace tiny { class EventLoop; }
 
 ////////////////////////////////////////////////////////////
 //
@@ -28,8 +32,6 @@ namespace mycache
 		LV_GLOBAL = 2,  // L2
 	};
 
-	typedef std::map<std::string, std::string> KVMap;
-	
 	// synchronous mode
 	extern SyncMyCache* sync;
 
@@ -41,25 +43,51 @@ namespace mycache
 	struct Get : public myredis::HGetAll
 	{
 	public:
-		virtual void replied_as_kvs(RedisReply::Map& kvs)
+		// only these fields by HMGET, all by HGETALL if empty
+		void setFields(const std::vector<std::string>& fields)
+		{
+			fields_ = fields;
+		}
+
+		virtual void request()
 		{
-			// hit
-			if (kvs.size() > 0)
+			if (!client) return;
+
+			if (fields_.empty())
 			{
-				ValueT value;
-				if (value.parseFromKVMap(kvs))
-					this->result(&value);
-				else
-					this->result(NULL);
+				myredis::HGetAll::request();
+				return;
 			}
-			// miss
-			else
+
+			std::vector<std::string> args;
+			fieldsArgs(args, key_, fields_);
+			client->command_argv(this, args);
+		}
+
+		virtual void called(void* data)
+		{
+			// the copy only when it's wanted in the context, as Command::called
+			if (data && context && varname.size())
 			{
-				this->result(NULL);
+				RedisReply reply;
+				reply.parseFrom((redisReply*)data);
+				context->set(varname, reply);
 			}
+
+			RedisReplyView hash((redisReply*)data);
+
+			ValueT value;
+			bool hit = fields_.empty() 
+				? HashCodec<ValueT>::decode(value, hash) 
+				: HashCodec<ValueT>::decodeFields(value, fields_, hash);
+
+			this->result(hit ? &value : NULL);
 		}
 
 		virtual void result(const ValueT* value) = 0;
+
+	protected:
+		std::vector<std::string> fields_;
 	};
 
 	template <typename ValueT>
@@ -71,12 +99,29 @@ namespace mycache
 			kvs_ = kvs;
 		}
 
+		// HMSET argv from HashCodec
+		void setArgs(std::vector<std::string>& args)
+		{
+			args_.swap(args);
+		}
+
+		virtual void request()
+		{
+			if (client && args_.size())
+				client->command_argv(this, args_);
+			else
+				myredis::HMSet::request();
+		}
+
 		virtual void replied(RedisReply& reply)
 		{
 			result(reply.getStr() == "OK");
 		}
 
 		virtual void result(bool okay) {}
+
+	protected:
+		std::vector<std::string> args_;
 	};
 
 	struct Del : public myredis::Del
@@ -104,7 +149,8 @@ namespace mycache
 class SyncMyCache
 {
 public:
-	typedef std::map<int, RedisConnectionPool*> Connections;
+	typedef std::map<int, RedisMultiplexer*> Connections;
+	typedef std::map<std::string, RedisMultiplexer*> Nodes;
 	typedef boost::unordered_map<std::string, boost::any> L0Map;
 
 	static SyncMyCache& instance()
@@ -113,12 +159,32 @@ public:
 		return sync_mycache;
 	}
 
+	SyncMyCache();
+	~SyncMyCache();
+
 public:
-	RedisConnectionPool* client(int level);
+	//
+	// One connection per Redis (address), shared by all threads and by the
+	// levels on the same address: concurrent commands are pipelined on it
+	// (myredis_mux.h) rather than each thread holding a connection.
+	//
+	RedisMultiplexer* client(int level);
 	bool connect(int level, const std::string& address);
 	void close();
 	void dump_inproc();
 
+	//
+	// L0 kept coherent by the Redis of a level (CLIENT TRACKING in broadcast
+	// mode): keys under the prefixes (all keys if none) are dropped from L0
+	// as soon as anyone writes them there, and skip L0 while the tracking
+	// is down. Call it once at startup, after connect(level).
+	//
+	bool track(int level, const std::vector<std::string>& prefixes, tiny::EventLoop* loop);
+
+	// dropped from L0, by the tracking
+	void invalidate_inproc(const std::string& key);
+	void invalidate_inproc(const std::vector<std::string>& prefixes);
+
 public:
 	//
 	// From/To specified cache
@@ -129,6 +195,10 @@ public:
 	template<typename ValueT>
 	bool set_to(const std::string& key, const ValueT& value, int level);	
 
+	// only the fields by HMGET
+	template<typename ValueT>
+	bool get_fields_from(const std::string& key, ValueT& value, const std::vector<std::string>& fields, int level);
+
 	bool del_from(const std::string& key, int level);
 	
 
@@ -152,16 +222,27 @@ public:
 	bool del(const std::string& key, int maxlevel = -1);
 	
 private:
-	bool get_from_remote(mycache::KVMap& kvs, const std::string& key, int level);
-	bool set_to_remote(const mycache::KVMap& kvs, const std::string& key, int level);
+	bool get_from_remote(const std::vector<std::string>& args, const RedisReplyView::Callback& callback, int level);
+	bool set_to_remote(const std::vector<std::string>& args, int level);
 	bool del_from_remote(const std::string& key, int level);
 
+	// L0 of a tracked key only when the tracking is up
+	bool inproc_usable(const std::string& key);
+	uint64_t inproc_generation();
+
+	// fill L0 unless something was invalidated since generation
+	template<typename ValueT>
+	bool cache_inproc(const std::string& key, const ValueT& value, uint64_t generation);
+
 	// L0
 	L0Map cache_;
 	boost::mutex cache_mutex_;
+	uint64_t generation_;
+	L0Tracking* tracking_;
 
 	// L1,L2,...
 	Connections clients_;
+	Nodes nodes_;
 	boost::mutex mutex_;
 };
 
@@ -197,6 +278,10 @@ public:
 	template<typename ValueT>
 	bool set_to(mycache::Set<ValueT>* cb, const std::string& key, const ValueT& value, int level);
 
+	// only the fields by HMGET
+	template <typename ValueT>
+	bool get_fields_from(mycache::Get<ValueT>* cb, const std::string& key, const std::vector<std::string>& fields, int level);
+
 	bool del_from(mycache::Del* cb, const std::string& key, int level);
 
 	//
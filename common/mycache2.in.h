@@ -5,6 +5,9 @@ inline bool SyncMyCache::get_from(const std::string& key, ValueT& value, int lev
 	// in memory
 	if (0 == level)
 	{
+		if (!inproc_usable(key))
+			return false;
+
 		boost::lock_guard<boost::mutex> guard(cache_mutex_);
 		L0Map::iterator it = cache_.find(key);
 		if (it != cache_.end())
@@ -23,11 +26,14 @@ inline bool SyncMyCache::get_from(const std::string& key, ValueT& value, int lev
 	// in remote
 	else
 	{
-		mycache::KVMap kvs;
-		if (get_from_remote(kvs, key, level))
-		{
-			return value.parseFromKVMap(kvs);
-		}
+		bool hit = false;
+		std::vector<std::string> args;
+		args.push_back("HGETALL");
+		args.push_back(key);
+		get_from_remote(args, [&value, &hit](const RedisReplyView& hash) {
+			hit = mycache::HashCodec<ValueT>::decode(value, hash);
+		}, level);
+		return hit;
 	}
 
 	return false;
@@ -39,22 +45,41 @@ inline bool SyncMyCache::set_to(const std::string& key, const ValueT& value, int
 	// to memory
 	if (0 == level)
 	{
+		if (!inproc_usable(key))
+			return false;
+
 		boost::lock_guard<boost::mutex> guard(cache_mutex_);
 		cache_[key] = value;
+		return true;
 	}
 	// to remote
 	else
 	{
-		mycache::KVMap kvs;
-		if (value.saveToKVMap(kvs))
+		std::vector<std::string> args;
+		if (mycache::HashCodec<ValueT>::encode(args, key, value))
 		{
-			return set_to_remote(kvs, key, level);
+			return set_to_remote(args, level);
 		}
 	}
 
 	return false;
 }
 
+template<typename ValueT>
+inline bool SyncMyCache::get_fields_from(const std::string& key, ValueT& value, const std::vector<std::string>& fields, int level)
+{
+	if (level <= 0 || fields.empty()) 
+		return false;
+
+	bool hit = false;
+	std::vector<std::string> args;
+	mycache::fieldsArgs(args, key, fields);
+	get_from_remote(args, [&value, &fields, &hit](const RedisReplyView& values) {
+		hit = mycache::HashCodec<ValueT>::decodeFields(value, fields, values);
+	}, level);
+	return hit;
+}
+
 inline bool SyncMyCache::del_from(const std::string& key, int level)
 {
 	// from memory
@@ -96,6 +121,7 @@ template <typename ValueT>
 inline bool SyncMyCache::get_and_cache(const std::string& key, ValueT& value, int cachelv /*= 0*/, int maxlevel /*= -1*/)
 {
 	const int maxlv = (maxlevel == -1 ? mycache::LV_GLOBAL : maxlevel);
+	const uint64_t generation = inproc_generation();
 
 	for (int lv = 0; lv <= maxlv; lv++)
 	{
@@ -105,7 +131,10 @@ inline bool SyncMyCache::get_and_cache(const std::string& key, ValueT& value, in
 			{
 				for (int i = 0; i <= cachelv; i++)
 				{
-					set_to(key, value, i);
+					if (0 == i)
+						cache_inproc(key, value, generation);
+					else
+						set_to(key, value, i);
 				}
 			}
 			return true;
@@ -115,6 +144,21 @@ inline bool SyncMyCache::get_and_cache(const std::string& key, ValueT& value, in
 	return false;
 }
 
+template<typename ValueT>
+inline bool SyncMyCache::cache_inproc(const std::string& key, const ValueT& value, uint64_t generation)
+{
+	if (!inproc_usable(key))
+		return false;
+
+	// it may have changed after it was read
+	boost::lock_guard<boost::mutex> guard(cache_mutex_);
+	if (generation != generation_)
+		return false;
+
+	cache_[key] = value;
+	return true;
+}
+
 template<typename ValueT>
 inline bool SyncMyCache::set(const std::string& key, const ValueT& value, int level)
 {
@@ -191,15 +235,15 @@ inline bool AsyncMyCache::set_to(mycache::Set<ValueT>* cb, const std::string& ke
 	}
 	else
 	{	
-		mycache::KVMap kvs;
-		if (!value.saveToKVMap(kvs))
+		std::vector<std::string> args;
+		if (!mycache::HashCodec<ValueT>::encode(args, key, value))
 		{
 			cb->result(false);
 			delete cb;
 			return false;
 		}
 
-		cb->setKVS(key, kvs);
+		cb->setArgs(args);
 
 		AsyncRedisClient* redis = client(level);
 		if (redis)
@@ -217,6 +261,15 @@ inline bool AsyncMyCache::set_to(mycache::Set<ValueT>* cb, const std::string& ke
 	return false;
 }
 
+template <typename ValueT>
+inline bool AsyncMyCache::get_fields_from(mycache::Get<ValueT>* cb, const std::string& key, const std::vector<std::string>& fields, int level)
+{
+	if (!cb) return false;
+
+	cb->setFields(fields);
+	return get_from(cb, key, level);
+}
+
 inline bool AsyncMyCache::del_from(mycache::Del* cb, const std::string& key, int level)
 {
 	if (!cb) cb = new mycache::Del;
@@ -0,0 +1,156 @@
+#ifndef __COMMON_MYCACHE2_CODEC_H
+#define __COMMON_MYCACHE2_CODEC_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include "redis_reply_view.h"
+#include "tinyreflection.h"
+
+//
+// Value <-> Redis hash codec of mycache, apart from the clients so that it
+// can be used (and tested) without them.
+//
+
+namespace mycache 
+{
+	typedef std::map<std::string, std::string> KVMap;
+
+	// ValueT has parseFromKVMap/saveToKVMap, taking a KVMap& or a const KVMap&
+	template <typename ValueT>
+	struct HasKVMap
+	{
+		template <typename U> static char test(decltype(std::declval<U&>().parseFromKVMap(std::declval<KVMap&>()))*);
+		template <typename U> static long test(...);
+
+		static const bool value = sizeof(test<ValueT>(0)) == sizeof(char);
+	};
+
+	//
+	// Value <-> Redis hash, without an intermediate KVMap.
+	//
+	// A struct declared by StructFactory (tinyreflection.h) has one field per
+	// property in its compact binary (BinaryField), written straight into
+	// the HMSET argv and read straight from the reply. Types with
+	// parseFromKVMap/saveToKVMap still go through their KVMap.
+	//
+	template <typename ValueT, bool KVMapT = HasKVMap<ValueT>::value>
+	struct HashCodec
+	{
+		static Struct<ValueT>* descriptor()
+		{
+			return StructFactory::instance().structByType<ValueT>();
+		}
+
+		// HMSET key field value ...
+		static bool encode(std::vector<std::string>& args, const std::string& key, const ValueT& value)
+		{
+			Struct<ValueT>* desc = descriptor();
+			if (!desc) return false;
+
+			typename Struct<ValueT>::PropertyContainer props = desc->propertyIterator();
+			args.reserve(args.size() + 2 + 2 * props.size());
+			args.push_back("HMSET");
+			args.push_back(key);
+			for (size_t i = 0; i < props.size(); i++)
+			{
+				args.push_back(props[i]->name());
+				args.push_back(std::string());
+				props[i]->encode(value, args.back());
+			}
+			return true;
+		}
+
+		// HGETALL: field value ...
+		static bool decode(ValueT& value, const RedisReplyView& hash)
+		{
+			Struct<ValueT>* desc = descriptor();
+			if (!desc || hash.size() == 0) return false;
+
+			bool ok = true;
+			hash.forEachPair([desc, &value, &ok](const RedisStringView& field, const RedisStringView& bin) {
+				typename Property<ValueT>::Ptr prop = desc->propertyByName(field.str());
+				if (prop && !prop->decode(value, bin.data, bin.size))
+					ok = false;
+			});
+			return ok;
+		}
+
+		// HMGET: values of fields, nil if not there
+		static bool decodeFields(ValueT& value, const std::vector<std::string>& fields, const RedisReplyView& values)
+		{
+			Struct<ValueT>* desc = descriptor();
+			if (!desc || values.size() != fields.size()) return false;
+
+			bool found = false;
+			for (size_t i = 0; i < fields.size(); i++)
+			{
+				RedisReplyView bin = values[i];
+				if (bin.isNil()) continue;
+
+				typename Property<ValueT>::Ptr prop = desc->propertyByName(fields[i]);
+				if (!prop || !prop->decode(value, bin.str().data, bin.str().size))
+					return false;
+				found = true;
+			}
+			return found;
+		}
+	};
+
+	template <typename ValueT>
+	struct HashCodec<ValueT, true>
+	{
+		static bool encode(std::vector<std::string>& args, const std::string& key, const ValueT& value)
+		{
+			KVMap kvs;
+			if (!value.saveToKVMap(kvs)) return false;
+
+			args.reserve(args.size() + 2 + 2 * kvs.size());
+			args.push_back("HMSET");
+			args.push_back(key);
+			for (KVMap::const_iterator it = kvs.begin(); it != kvs.end(); ++it)
+			{
+				args.push_back(it->first);
+				args.push_back(it->second);
+			}
+			return true;
+		}
+
+		static bool decode(ValueT& value, const RedisReplyView& hash)
+		{
+			if (hash.size() == 0) return false;
+
+			KVMap kvs;
+			hash.forEachPair([&kvs](const RedisStringView& field, const RedisStringView& bin) {
+				kvs[field.str()].assign(bin.data, bin.size);
+			});
+			return value.parseFromKVMap(kvs);
+		}
+
+		static bool decodeFields(ValueT& value, const std::vector<std::string>& fields, const RedisReplyView& values)
+		{
+			if (values.size() != fields.size()) return false;
+
+			KVMap kvs;
+			for (size_t i = 0; i < fields.size(); i++)
+			{
+				if (!values[i].isNil())
+					kvs[fields[i]] = values[i].str().str();
+			}
+			return kvs.size() > 0 && value.parseFromKVMap(kvs);
+		}
+	};
+
+	// HMGET key field ...
+	inline void fieldsArgs(std::vector<std::string>& args, const std::string& key, const std::vector<std::string>& fields)
+	{
+		args.reserve(args.size() + 2 + fields.size());
+		args.push_back("HMGET");
+		args.push_back(key);
+		args.insert(args.end(), fields.begin(), fields.end());
+	}
+}
+
+#endif // __COMMON_MYCACHE2_CODEC_H
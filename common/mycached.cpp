@@ -1,11 +1,17 @@
 #include "mycached.h"
 #include <string>
 #include <queue>
+#include <deque>
+#include <algorithm>
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
 
 #include "mylogger.h"
 #include "mycache.h"
 #include "mycache.pb.h"
+#include "tinymetrics.h"
+#include <google/protobuf/io/coded_stream.h>
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
 #include <yaml-cpp/yaml.h>
@@ -36,31 +42,153 @@ static void s_catch_signals (void)
 static YAML::Node config;
 static int s_tablenum = 10;
 static int s_cacheonly = 0;
+static int s_load_wait = 1000;
+static int s_refresh_ttl = 0;
+static double s_refresh_beta = 1.0;
+static size_t s_max_backlog = 10000;
+static int s_metrics_port = 0;
+static std::string s_metrics_file;
 
 ///////////////////////////////////////////////////////////////////////
 
 static std::string getKVSTableName(const std::string& key)
 {
-	static char name[255] = "";
+	char name[255] = "";
 
 	uint32_t hash = hash_murmur(key);
 	snprintf(name, sizeof(name), "kvs_%u", (hash%s_tablenum));
 	return name;
 }
 
+//
+// Cache updates, each one is a single atomic round trip
+//
+
+// value, touchtime, flag of a hit
+static RedisScriptPtr s_cache_get = RedisScripts::instance().add("mycached.get",
+	"local hash = redis.call('HMGET', KEYS[1], 'value', 'touchtime', 'flag') "
+	"if not hash[1] then return false end "
+	"return hash");
+
+// filled from mysql, unless a set came first
+static RedisScriptPtr s_cache_fill = RedisScripts::instance().add("mycached.fill",
+	"if redis.call('EXISTS', KEYS[1]) == 1 then return 0 end "
+	"redis.call('HMSET', KEYS[1], 'value', ARGV[1], 'flag', ARGV[2], 'touchtime', ARGV[3]) "
+	"return 1");
+
+// flag is the version of the set while it's not in mysql, a set older
+// than the last one is refused (0); version 0 (cache only) always applies
+static RedisScriptPtr s_cache_set = RedisScripts::instance().add("mycached.set",
+	"local version = tonumber(ARGV[2]) "
+	"local last = tonumber(redis.call('HGET', KEYS[1], 'version')) "
+	"if version > 0 and last and last > version then return 0 end "
+	"redis.call('HMSET', KEYS[1], 'value', ARGV[1], 'flag', ARGV[2], 'version', ARGV[2], 'touchtime', ARGV[3]) "
+	"return 1");
+
+// refreshed from mysql, unless it's dirty or changed since it was read
+static RedisScriptPtr s_cache_refresh = RedisScripts::instance().add("mycached.refresh",
+	"local hash = redis.call('HMGET', KEYS[1], 'touchtime', 'flag') "
+	"if hash[1] ~= ARGV[2] or (hash[2] and hash[2] ~= '0') then return 0 end "
+	"redis.call('HMSET', KEYS[1], 'value', ARGV[1], 'touchtime', ARGV[3]) "
+	"return 1");
+
+// flushed to mysql, clean unless a newer set came in
+static RedisScriptPtr s_cache_clean = RedisScripts::instance().add("mycached.clean",
+	"if redis.call('HGET', KEYS[1], 'flag') ~= ARGV[1] then return 0 end "
+	"redis.call('HSET', KEYS[1], 'flag', 0) "
+	"return 1");
+
+static std::string nowString()
+{
+	std::ostringstream oss;
+	oss << (unsigned int)time(0);
+	return oss.str();
+}
+
+//
+// Probabilistic early refresh (XFetch): a hit is refreshed from mysql a bit
+// before it's refresh_ttl old, the earlier the slower the load is. So one
+// request reloads a hot key before it goes stale, not all of them at once.
+//
+static bool shouldRefresh(const std::string& touchtime, double cost)
+{
+	if (s_refresh_ttl <= 0 || touchtime.empty())
+		return false;
+
+	static __thread unsigned int seed = 0;
+	if (0 == seed)
+		seed = (unsigned int)time(0) ^ (unsigned int)pthread_self();
+
+	double rnd = (rand_r(&seed) + 1.0) / (RAND_MAX + 1.0);
+	double early = -cost * s_refresh_beta * log(rnd);
+	return time(0) + early >= strtod(touchtime.c_str(), NULL) + s_refresh_ttl;
+}
+
+// false on mysql errors
+static bool loadFromDB(MyCacheWorker* worker, const std::string& key, bool& found, std::string& value)
+{
+	found = false;
+
+	MySqlConnectionByKey mysql(key, worker->dbPool());
+	if (!mysql)
+	{
+		LOG4CXX_WARN(logger, "get " << key << " .. mysql is not ready");
+		return true;
+	}
+
+	try {
+		mysqlpp::Query query = mysql->query();
+		query << "select * from "<< getKVSTableName(key) << " where `key`=" << mysqlpp::quote << key;
+		mysqlpp::StoreQueryResult res = query.store();
+		if (res && res.num_rows() == 1)
+		{
+			value.assign(res[0]["value"].data(), res[0]["value"].size());
+			found = true;
+		}
+	}
+	catch (std::exception& err)
+	{
+		LOG4CXX_WARN(logger, "get " << key << " .. mysql error:" << err.what());
+		return false;
+	}
+
+	return true;
+}
+
+static double elapsed(const boost::posix_time::ptime& start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
 struct GetMsgHandler : public MsgHandler
 {
 	bool doMsg(std::string& reply, const std::string& msg)
 	{
 		std::string key = msg;
+		MyCacheLoads& loads = MyCacheServer::instance()->loads();
 
 		RedisConnectionByKey redis(key, worker->cachePool());
 		if (redis)
 		{
-			RedisReply::Map kvs;
-			if (redis->hgetall(key, kvs))
+			bool hit = false;
+			std::string touchtime;
+			std::string flag;
+			redis->evalsha([&reply, &hit, &touchtime, &flag](const RedisReplyView& hash) {
+				if (hash.size() == 3 && REDIS_REPLY_STRING == hash[0].type())
+				{
+					reply = hash[0].str().str();
+					touchtime = hash[1].str().str();
+					flag = hash[2].str().str();
+					hit = true;
+				}
+			}, *s_cache_get, {key});
+
+			if (hit)
 			{
-				reply = kvs["value"];
+				// dirty ones are newer than mysql
+				if (0 == s_cacheonly && (flag.empty() || "0" == flag) && shouldRefresh(touchtime, loads.cost()))
+					refresh(redis, key, touchtime);
+
 				LOG4CXX_INFO(logger, "get " << key << " .. hit");
 				return true;
 			}
@@ -72,38 +200,66 @@ struct GetMsgHandler : public MsgHandler
 
 		if (0 == s_cacheonly)
 		{
-			MySqlConnectionByKey mysql(key, worker->dbPool());
-			if (mysql)
+			// written but not flushed yet
+			MyCacheWriteBack* writeback = MyCacheServer::instance()->writeBack(key);
+			MyCacheWriteBack::Entry pending;
+			if (writeback && writeback->lookup(key, pending))
 			{
-				try {
-					mysqlpp::Query query = mysql->query();
-					query << "select * from "<< getKVSTableName(key) << " where `key`=" << mysqlpp::quote << key;
-					mysqlpp::StoreQueryResult res = query.store();
-					if (res)
-					{
-						if (res.num_rows() == 1)
-						{
-							reply.resize(res[0]["value"].size());
-							reply.assign(res[0]["value"].data(), res[0]["value"].size());
-
-							redis->hmset("%b value %b flag %u touchtime %u", 
-								key.data(), key.size(),
-								reply.data(), reply.size(), 0, (unsigned int)time(0));
-
-							LOG4CXX_INFO(logger, "get " << key << " .. miss");
-							return true;
-						}
-					}
+				if (pending.erased)
+				{
+					reply = "";
+					LOG4CXX_INFO(logger, "get " << key << " .. non-exists(pending)");
+					return true;
 				}
-				catch (std::exception& err)
+
+				reply = pending.value;
+				if (redis)
 				{
-					LOG4CXX_WARN(logger, "get " << key << " .. mysql error:" << err.what());
-					return false;
+					RedisReply filled;
+					redis->evalsha(filled, *s_cache_fill, {key}, {reply, std::to_string(pending.version), nowString()});
 				}
+
+				LOG4CXX_INFO(logger, "get " << key << " .. miss(pending)");
+				return true;
 			}
-			else
+
+			// someone is loading it, wait for the result
+			MyCacheLoads::LoadPtr load;
+			if (!loads.begin(key, load))
+			{
+				if (loads.wait(load, s_load_wait))
+				{
+					if (!load->ok)
+						return false;
+
+					reply = load->found ? load->value : "";
+					LOG4CXX_INFO(logger, "get " << key << " .. miss(shared)");
+					return true;
+				}
+
+				LOG4CXX_WARN(logger, "get " << key << " .. wait timeout");
+				load.reset();
+			}
+
+			bool found = false;
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			bool ok = loadFromDB(worker, key, found, reply);
+			if (ok && found && redis)
 			{
-				LOG4CXX_WARN(logger, "get " << key << " .. mysql is not ready");
+				RedisReply filled;
+				redis->evalsha(filled, *s_cache_fill, {key}, {reply, "0", nowString()});
+			}
+
+			if (load)
+				loads.finish(key, load, ok, found, reply, elapsed(start));
+
+			if (!ok)
+				return false;
+
+			if (found)
+			{
+				LOG4CXX_INFO(logger, "get " << key << " .. miss");
+				return true;
 			}
 		}
 
@@ -111,8 +267,86 @@ struct GetMsgHandler : public MsgHandler
 		LOG4CXX_INFO(logger, "get " << key << " .. non-exists");
 		return true;
 	}
+
+	// only one refresh of a key at a time, the others keep the hit
+	void refresh(RedisConnectionByKey& redis, const std::string& key, const std::string& touchtime)
+	{
+		MyCacheLoads& loads = MyCacheServer::instance()->loads();
+		MyCacheLoads::LoadPtr load;
+		if (!loads.begin(key, load))
+			return;
+
+		bool found = false;
+		std::string value;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		bool ok = loadFromDB(worker, key, found, value);
+		if (ok && found)
+		{
+			RedisReply refreshed;
+			redis->evalsha(refreshed, *s_cache_refresh, {key}, {value, touchtime, nowString()});
+			LOG4CXX_INFO(logger, "get " << key << " .. refreshed:" << refreshed.getInteger());
+		}
+
+		loads.finish(key, load, ok, found, value, elapsed(start));
+	}
 };
 
+///////////////////////////////////////////////////////////////////
+
+bool MyCacheLoads::begin(const std::string& key, LoadPtr& load)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	LoadPtr& inflight = loads_[key];
+	if (inflight)
+	{
+		load = inflight;
+		return false;
+	}
+
+	inflight.reset(new Load);
+	load = inflight;
+	return true;
+}
+
+void MyCacheLoads::finish(const std::string& key, const LoadPtr& load, bool ok, bool found, const std::string& value, double cost)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::map<std::string, LoadPtr>::iterator it = loads_.find(key);
+		if (it != loads_.end() && it->second == load)
+			loads_.erase(it);
+
+		if (ok)
+			cost_ = cost_ > 0 ? cost_ * 0.9 + cost * 0.1 : cost;
+	}
+
+	boost::mutex::scoped_lock lock(load->mutex);
+	load->ok = ok;
+	load->found = found;
+	load->value = value;
+	load->done = true;
+	load->cond.notify_all();
+}
+
+bool MyCacheLoads::wait(const LoadPtr& load, int timeoutms)
+{
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutms);
+
+	boost::mutex::scoped_lock lock(load->mutex);
+	while (!load->done)
+	{
+		if (!load->cond.timed_wait(lock, deadline))
+			return load->done;
+	}
+	return true;
+}
+
+double MyCacheLoads::cost()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return cost_;
+}
+
 struct SetMsgHandler : public MsgHandler
 {
 	bool doMsg(std::string& reply, const std::string& msg)
@@ -126,17 +360,42 @@ struct SetMsgHandler : public MsgHandler
 			LOG4CXX_INFO(logger, "<" << pthread_self() << "> set : " << setmsg.key() << ", " << setmsg.value().size());
 
 
+			MyCacheWriteBack* writeback = s_cacheonly ? NULL : MyCacheServer::instance()->writeBack(key);
+			uint64_t version = writeback ? MyCacheServer::instance()->nextVersion() : 0;
+
+			bool cached = false;
 			RedisConnectionByKey redis(key, worker->cachePool());
 			if (redis)
 			{
-				redis->hmset("%s value %b flag %u touchtime %u", key.c_str(),
-						value.data(), value.size(), 0, (unsigned int)time(0));
+				RedisReply setreply;
+				cached = redis->evalsha(setreply, *s_cache_set, {key}, {value, std::to_string(version), nowString()});
+
+				// a newer set of the key is already in, this one is overwritten
+				if (cached && setreply.type == REDIS_REPLY_INTEGER && setreply.getInteger() == 0)
+				{
+					LOG4CXX_INFO(logger, "set " << key << " .. superseded by a newer version");
+					reply = "OK";
+					return true;
+				}
 			}
 			else
 			{
 				LOG4CXX_WARN(logger, "set " << key << " .. redis is not ready");
 			}
 
+			// acknowledged once redis has it, the flusher writes mysql
+			if (writeback)
+			{
+				if (!cached || !writeback->push(key, value, version))
+				{
+					LOG4CXX_WARN(logger, "set " << key << " .. write-back failed");
+					return false;
+				}
+
+				reply = "OK";
+				return true;
+			}
+
 			if (0 == s_cacheonly)
 			{
 				MySqlConnectionByKey mysql(key, worker->dbPool());
@@ -193,6 +452,19 @@ struct DelMsgHandler : public MsgHandler
 			LOG4CXX_WARN(logger, "del " << key << " .. redis is not ready");
 		}
 
+		// queued behind the pending sets of the key
+		MyCacheWriteBack* writeback = s_cacheonly ? NULL : MyCacheServer::instance()->writeBack(key);
+		if (writeback)
+		{
+			if (!writeback->erase(key, MyCacheServer::instance()->nextVersion()))
+			{
+				LOG4CXX_WARN(logger, "del " << key << " .. write-back failed");
+				return false;
+			}
+
+			reply = "OK";
+			return true;
+		}
 
 		if (0 == s_cacheonly)
 		{
@@ -241,7 +513,176 @@ MsgHandler* MsgHandler::createByType(unsigned char cmdtype)
 
 ///////////////////////////////////////////////////////////////////
 
+static RedisShardingPool* newCachePool()
+{
+	RedisShardingPool* cachepool = new RedisShardingPool();
+	cachepool->setShardNum(config["caches"].size());
+
+	for (YAML::const_iterator it = config["caches"].begin(); 
+		it != config["caches"].end(); ++it)
+	{
+		cachepool->addSharding(it->as<std::string>());
+	}
 
+	if (!cachepool->isReady())
+	{
+		LOG4CXX_ERROR(logger, "redis is not ready! " << cachepool->shardNum());
+		delete cachepool;
+		return NULL;
+	}
+
+	cachepool->init();
+
+	LOG4CXX_INFO(logger, "redis init .. " << cachepool->shardNum());
+	return cachepool;
+}
+
+static MySqlShardingPool* newDBPool()
+{
+	MySqlShardingPool* dbpool = new MySqlShardingPool();
+	dbpool->setShardNum(config["databases"].size());
+
+	for (YAML::const_iterator it = config["databases"].begin(); 
+		it != config["databases"].end(); ++it)
+	{
+		dbpool->addSharding(it->as<std::string>());
+	}
+
+	if (!dbpool->isReady())
+	{
+		LOG4CXX_ERROR(logger, "mysql is not ready! " << dbpool->shardNum());
+		delete dbpool;
+		return NULL;
+	}
+
+	dbpool->init();
+
+	LOG4CXX_INFO(logger, "mysql init .. " << dbpool->shardNum());
+	return dbpool;
+}
+
+///////////////////////////////////////////////////////////////////
+
+bool MyCacheWriteBack::flush(MySqlShardingPool* dbpool, RedisShardingPool* cachepool, size_t maxrows)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if (flushing_.empty())
+		{
+			if (pending_.empty())
+				return true;
+
+			flushing_.swap(pending_);
+			if (!rotate())
+			{
+				LOG4CXX_ERROR(logger, "write-back " << shard_ << " journal failed: " << journal_path_);
+			}
+		}
+	}
+
+	// retried by the next round
+	if (!writeToMySQL(dbpool, maxrows))
+		return false;
+
+	cleanCache(cachepool);
+
+	boost::mutex::scoped_lock lock(mutex_);
+	flushing_.clear();
+	remove(flushing_path_.c_str());
+	return true;
+}
+
+bool MyCacheWriteBack::writeToMySQL(MySqlShardingPool* dbpool, size_t maxrows)
+{
+	MySqlConnectionByShard mysql(shard_, dbpool);
+	if (!mysql)
+	{
+		LOG4CXX_WARN(logger, "write-back " << shard_ << " .. mysql is not ready");
+		return false;
+	}
+
+	// table -> rows
+	typedef std::map<std::string, std::vector<Entries::const_iterator> > TableRows;
+	TableRows replaces;
+	TableRows deletes;
+	for (Entries::const_iterator it = flushing_.begin(); it != flushing_.end(); ++it)
+	{
+		if (it->second.erased)
+			deletes[getKVSTableName(it->first)].push_back(it);
+		else
+			replaces[getKVSTableName(it->first)].push_back(it);
+	}
+
+	if (maxrows == 0)
+		maxrows = 1;
+
+	try {
+		mysqlpp::Query query = mysql->query();
+
+		for (TableRows::const_iterator table = replaces.begin(); table != replaces.end(); ++table)
+		{
+			const std::vector<Entries::const_iterator>& rows = table->second;
+			for (size_t begin = 0; begin < rows.size(); begin += maxrows)
+			{
+				size_t end = std::min(rows.size(), begin + maxrows);
+
+				query.reset();
+				query << "replace into " << table->first << "(`key`, value, flag, touchtime) values";
+				for (size_t i = begin; i < end; i++)
+				{
+					query << (i == begin ? "(" : ",(")
+						  << mysqlpp::quote << rows[i]->first << ","
+						  << mysqlpp::quote << rows[i]->second.value << ","
+						  << 0 << ","
+						  << time(0) << ")";
+				}
+				query.execute();
+			}
+		}
+
+		for (TableRows::const_iterator table = deletes.begin(); table != deletes.end(); ++table)
+		{
+			const std::vector<Entries::const_iterator>& rows = table->second;
+			for (size_t begin = 0; begin < rows.size(); begin += maxrows)
+			{
+				size_t end = std::min(rows.size(), begin + maxrows);
+
+				query.reset();
+				query << "delete from " << table->first << " where `key` in (";
+				for (size_t i = begin; i < end; i++)
+					query << (i == begin ? "" : ",") << mysqlpp::quote << rows[i]->first;
+				query << ")";
+				query.execute();
+			}
+		}
+	}
+	catch (std::exception& err)
+	{
+		LOG4CXX_WARN(logger, "write-back " << shard_ << " .. mysql error:" << err.what());
+		return false;
+	}
+
+	LOG4CXX_INFO(logger, "write-back " << shard_ << " flushed " << flushing_.size());
+	return true;
+}
+
+void MyCacheWriteBack::cleanCache(RedisShardingPool* cachepool)
+{
+	for (Entries::const_iterator it = flushing_.begin(); it != flushing_.end(); ++it)
+	{
+		if (it->second.erased)
+			continue;
+
+		RedisConnectionByKey redis(it->first, cachepool);
+		if (redis)
+		{
+			RedisReply reply;
+			redis->evalsha(reply, *s_cache_clean, {it->first}, {std::to_string(it->second.version)});
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////
 
 MyCacheWorker::MyCacheWorker(zmq::context_t* context, const std::string& address, int id)
 {
@@ -312,64 +753,22 @@ bool MyCacheWorker::connect()
 
 bool MyCacheWorker::initRedis()
 {
-	cachepool_ = new RedisShardingPool();
-	if (cachepool_)
-	{
-		cachepool_->setShardNum(config["caches"].size());
-
-		for (YAML::const_iterator it = config["caches"].begin(); 
-			it != config["caches"].end(); ++it)
-		{
-			cachepool_->addSharding(it->as<std::string>());
-		}
-
-		if (!cachepool_->isReady())
-    	{
-    		LOG4CXX_ERROR(logger, "redis is not ready! " << cachepool_->shardNum());
-    		return false;
-    	}
-
-    	cachepool_->init();
-
-    	LOG4CXX_INFO(logger, "redis init .. " << cachepool_->shardNum());
-    	return true;
-	}
-
-	return false;
+	cachepool_ = newCachePool();
+	return cachepool_ != NULL;
 }
 
 bool MyCacheWorker::initMySQL()
 {
-    dbpool_ = new MySqlShardingPool();
-    if (dbpool_)
-    {
-    	dbpool_->setShardNum(config["databases"].size());
-
-    	for (YAML::const_iterator it = config["databases"].begin(); 
-			it != config["databases"].end(); ++it)
-		{
-			dbpool_->addSharding(it->as<std::string>());
-		}
-
-    	if (!dbpool_->isReady())
-    	{
-    		LOG4CXX_ERROR(logger, "mysql is not ready! " << dbpool_->shardNum());
-    		return false;
-    	}
-
-    	cachepool_->init();
-    	
-    	LOG4CXX_INFO(logger, "mysql init .. " << dbpool_->shardNum());
-    	return true;
-    }
-
-    return false;
+	dbpool_ = newDBPool();
+	return dbpool_ != NULL;
 }
 
-void MyCacheWorker::run()
+bool MyCacheWorker::run()
 {
 	LOG4CXX_INFO(logger, "[" << name_ << "] worker started");
 
+	bool ok = true;
+
 	//  Tell backend we're ready for work
     socket_->send("READY", 5);
 
@@ -392,6 +791,10 @@ void MyCacheWorker::run()
 	        zmq::message_t request;
 	        socket_->recv(&request);
 
+	        //  No client: the broker retires us
+	        if (client_addr_msg.size() == 0)
+	        	break;
+
 	        //std::cout << "Worker: " << (char*)request.data() << std::endl;
 
 	        // Do the Request
@@ -440,6 +843,7 @@ void MyCacheWorker::run()
 		catch(const std::exception& err)
 		{
 			LOG4CXX_ERROR(logger, "[" << name_ << "] worker error : " << err.what());
+			ok = false;
 			break;
 		}
 	}
@@ -447,6 +851,7 @@ void MyCacheWorker::run()
 	LOG4CXX_INFO(logger, "[" << name_ << "] worker finished");
 
 	delete this;
+	return ok;
 }
 
 RedisShardingPool* MyCacheWorker::cachePool()
@@ -461,6 +866,211 @@ MySqlShardingPool* MyCacheWorker::dbPool()
 
 ///////////////////////////////////////////////////////////////////
 
+// jump consistent hash: a worker joining or leaving at the end moves only
+// the keys of one worker
+static int jumpHash(uint64_t key, int buckets)
+{
+	int64_t b = -1, j = 0;
+	while (j < buckets)
+	{
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = (b + 1) * (double(1LL << 31) / double((key >> 33) + 1));
+	}
+	return b;
+}
+
+MyCacheWorkerPool::Slot* MyCacheWorkerPool::find(const std::string& worker)
+{
+	for (size_t i = 0; i < slots_.size(); i++)
+	{
+		if (slots_[i].stats.worker == worker)
+			return &slots_[i];
+	}
+	return NULL;
+}
+
+void MyCacheWorkerPool::join(const std::string& worker)
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	if (find(worker))
+		return;
+
+	Slot slot;
+	slot.stats.worker = worker;
+	slot.since = boost::posix_time::microsec_clock::universal_time();
+	slot.latency = &Metrics::histogram("mycached.worker." + worker + ".latency_us");
+	slots_.push_back(slot);
+
+	idle_.push_back(worker);
+}
+
+void MyCacheWorkerPool::leave(const std::string& worker)
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	for (std::vector<Slot>::iterator it = slots_.begin(); it != slots_.end(); ++it)
+	{
+		if (it->stats.worker == worker)
+		{
+			slots_.erase(it);
+			Metrics::remove("mycached.worker." + worker + ".latency_us");
+			break;
+		}
+	}
+	idle_.remove(worker);
+}
+
+bool MyCacheWorkerPool::route(const std::string& key, std::string& worker)
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	if (idle_.empty())
+		return false;
+
+	// the worker of the key or none: the key waits for it while it's busy
+	std::list<std::string>::iterator it = idle_.begin();
+	if (!key.empty() && slots_.size() > 1)
+	{
+		const std::string& affine = slots_[jumpHash(hash_murmur(key), slots_.size())].stats.worker;
+		it = std::find(idle_.begin(), idle_.end(), affine);
+		if (it == idle_.end())
+			return false;
+	}
+
+	worker = *it;
+	idle_.erase(it);
+
+	Slot* slot = find(worker);
+	if (slot)
+	{
+		slot->stats.busy = true;
+		slot->since = boost::posix_time::microsec_clock::universal_time();
+	}
+	return true;
+}
+
+void MyCacheWorkerPool::done(const std::string& worker)
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	Slot* slot = find(worker);
+	if (!slot || !slot->stats.busy)
+		return;
+
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	int64_t us = (now - slot->since).total_microseconds();
+	double cost = us / 1000000.0;
+
+	Stats& stats = slot->stats;
+	stats.avg = (stats.requests == 0 ? cost : stats.avg * 0.9 + cost * 0.1);
+	stats.max = std::max(stats.max, cost);
+	stats.requests++;
+	stats.busy = false;
+	slot->since = now;
+	slot->latency->observe(us > 0 ? us : 0);
+
+	idle_.push_back(worker);
+}
+
+std::string MyCacheWorkerPool::affinity(const std::string& key) const
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	if (slots_.empty())
+		return "";
+	return slots_[jumpHash(hash_murmur(key), slots_.size())].stats.worker;
+}
+
+bool MyCacheWorkerPool::retirable(int idlesecs, std::string& worker) const
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	if (slots_.empty())
+		return false;
+
+	const Slot& last = slots_.back();
+	if (last.stats.busy)
+		return false;
+
+	if ((boost::posix_time::microsec_clock::universal_time() - last.since).total_seconds() < idlesecs)
+		return false;
+
+	worker = last.stats.worker;
+	return true;
+}
+
+size_t MyCacheWorkerPool::size() const
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	return slots_.size();
+}
+
+size_t MyCacheWorkerPool::idle() const
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	return idle_.size();
+}
+
+std::vector<MyCacheWorkerPool::Stats> MyCacheWorkerPool::stats() const
+{
+	boost::lock_guard<boost::mutex> guard(mutex_);
+	std::vector<Stats> all;
+	for (size_t i = 0; i < slots_.size(); i++)
+		all.push_back(slots_[i].stats);
+	return all;
+}
+
+///////////////////////////////////////////////////////////////////
+
+// a request waiting for an idle worker
+struct MyCachePending
+{
+	zmq::message_t client;
+	zmq::message_t request;
+	std::string key;
+};
+
+// key to route a request by: GET/DEL carry the key, SET a Cmd::Set with
+// the key in field 1, read without parsing the value
+static std::string requestKey(zmq::message_t& request)
+{
+	const size_t header = sizeof(uint8_t) + sizeof(uint64_t);
+	if (request.size() < header)
+		return "";
+
+	const char* data = (const char*)request.data();
+	const char* body = data + header;
+	const size_t bodylen = request.size() - header;
+
+	switch ((uint8_t)data[0])
+	{
+		case kMyCacheCmd_Get:
+		case kMyCacheCmd_Del:
+			return std::string(body, bodylen);
+
+		case kMyCacheCmd_Set:
+		{
+			google::protobuf::io::CodedInputStream is((const uint8_t*)body, bodylen);
+			uint32_t size = 0;
+			std::string key;
+			if (is.ReadTag() == 0x0A && is.ReadVarint32(&size) && is.ReadString(&key, size))
+				return key;
+			break;
+		}
+	}
+
+	return "";
+}
+
+// [worker][][client][][request]
+static void s_dispatch(zmq::socket_t* socket, const std::string& worker, zmq::message_t& client, zmq::message_t& request)
+{
+	zmq::message_t empty;
+	socket->send(worker.data(), worker.size(), ZMQ_SNDMORE);
+	socket->send(empty, ZMQ_SNDMORE);
+	socket->send(client, ZMQ_SNDMORE);
+	socket->send(empty, ZMQ_SNDMORE);
+	socket->send(request);
+}
+
+///////////////////////////////////////////////////////////////////
+
 MyCacheServer::MyCacheServer()
 {
 	address_ = "tcp://*:5555";
@@ -468,6 +1078,19 @@ MyCacheServer::MyCacheServer()
 	workers_socket_ = NULL;
 	context_ = NULL;
 	workernum_ = 3;
+	maxworkers_ = 0;
+	grow_backlog_ = 8;
+	shrink_idle_ = 60;
+	nextworker_ = 0;
+	starting_ = 0;
+
+	flush_cachepool_ = NULL;
+	flush_dbpool_ = NULL;
+	journal_dir_ = ".";
+	flush_interval_ = 100;
+	flush_rows_ = 500;
+	journal_sync_ = false;
+	version_ = 0;
 }
 
 MyCacheServer* MyCacheServer::instance()
@@ -487,6 +1110,14 @@ void MyCacheServer::fini()
 	safe_delete(context_);
 
 	worker_thrds.join_all();
+	flusher_thrds.join_all();
+
+	for (size_t i = 0; i < writebacks_.size(); i++)
+		safe_delete(writebacks_[i]);
+	writebacks_.clear();
+
+	safe_delete(flush_cachepool_);
+	safe_delete(flush_dbpool_);
 }
 
 
@@ -509,6 +1140,27 @@ bool MyCacheServer::loadConfig(const std::string& cfg, const std::string& server
 			workernum_ = 1;
 		}
 
+		// grow up to max_workers while more than grow_backlog requests wait,
+		// back to workers when the last one is idle for shrink_idle seconds
+		if (config["max_workers"])
+			maxworkers_ = config["max_workers"].as<int>();
+		if (config["grow_backlog"])
+			grow_backlog_ = config["grow_backlog"].as<int>();
+		if (config["shrink_idle"])
+			shrink_idle_ = config["shrink_idle"].as<int>();
+		if (config["max_backlog"])
+			s_max_backlog = config["max_backlog"].as<size_t>();
+
+		// worker latencies and backlog, see tinymetrics.h
+		if (config["metrics"])
+		{
+			const YAML::Node& metrics = config["metrics"];
+			if (metrics["port"])
+				s_metrics_port = metrics["port"].as<int>();
+			if (metrics["file"])
+				s_metrics_file = metrics["file"].as<std::string>();
+		}
+
 		if (config["caches"].size() == 0 || config["databases"].size() == 0)
 		{
 			LOG4CXX_ERROR(logger, "loadConfig failed: " << cfg << ": no caches/databases");
@@ -521,6 +1173,34 @@ bool MyCacheServer::loadConfig(const std::string& cfg, const std::string& server
 
 		s_cacheonly = config["cacheonly"].as<int>();
 
+		// ms a miss waits for the same key loading by another request
+		if (config["load_wait"])
+			s_load_wait = config["load_wait"].as<int>();
+
+		// refresh hits from mysql around refresh_ttl seconds, 0 to never
+		if (config["refresh_ttl"])
+			s_refresh_ttl = config["refresh_ttl"].as<int>();
+		if (config["refresh_beta"])
+			s_refresh_beta = config["refresh_beta"].as<double>();
+
+		// write-back to mysql, 0 to write inline
+		if (config["writeback"])
+		{
+			const YAML::Node& writeback = config["writeback"];
+			if (writeback["journal"])
+				journal_dir_ = writeback["journal"].as<std::string>();
+			if (writeback["interval"])
+				flush_interval_ = writeback["interval"].as<int>();
+			if (writeback["rows"])
+				flush_rows_ = writeback["rows"].as<int>();
+			if (writeback["sync"])
+				journal_sync_ = writeback["sync"].as<int>() != 0;
+		}
+		else
+		{
+			flush_interval_ = 0;
+		}
+
 		return true;
 
 	}
@@ -560,39 +1240,191 @@ bool MyCacheServer::init()
 		return false;
 	}
 
+	if (0 == s_cacheonly && flush_interval_ > 0 && !initWriteBack())
+		return false;
+
+	if (s_metrics_port > 0)
+		MetricsReporter::instance().serveHttp(s_metrics_port);
+	if (!s_metrics_file.empty())
+		MetricsReporter::instance().dumpTo(s_metrics_file);
+
+	if (maxworkers_ < workernum_)
+		maxworkers_ = workernum_;
+
     //  Launch pool of worker threads
     for (int i = 0; i < workernum_; i++) 
     {
-    	MyCacheWorker* worker = new MyCacheWorker(this->context_, "inproc://workers", i);
-    	if (worker && worker->init())
-    	{
-    		worker_thrds.create_thread(boost::bind(&MyCacheWorker::run, worker));
-    	}
+    	startWorker();
     }
 
 	return true;
 }
 
+void MyCacheServer::startWorker()
+{
+	starting_++;
+	MyCacheWorker* worker = new MyCacheWorker(this->context_, "inproc://workers", nextworker_++);
+	worker_thrds.create_thread(boost::bind(&MyCacheServer::runWorker, this, worker));
+}
+
+void MyCacheServer::runWorker(MyCacheWorker* worker)
+{
+	// connecting is slow, not in the broker
+	if (!worker->init())
+	{
+		LOG4CXX_ERROR(logger, "worker init failed");
+		starting_--;
+		delete worker;
+		return;
+	}
+
+	// a dead worker must not be routed to any more
+	const std::string name = worker->name();
+	if (!worker->run() && !s_interrupted)
+		workerpool_.leave(name);
+}
+
+void MyCacheServer::adjustWorkers(size_t backlog)
+{
+	static GaugeMetric& workers = Metrics::gauge("mycached.workers");
+	static GaugeMetric& idle = Metrics::gauge("mycached.workers_idle");
+	static GaugeMetric& waiting = Metrics::gauge("mycached.backlog");
+	workers.set(workerpool_.size());
+	idle.set(workerpool_.idle());
+	waiting.set(backlog);
+
+	// one at a time
+	if (starting_ > 0)
+		return;
+
+	const int running = (int)workerpool_.size();
+	if (backlog > (size_t)grow_backlog_ && running < maxworkers_)
+	{
+		LOG4CXX_INFO(logger, "workers grow : " << running + 1 << ", backlog " << backlog);
+		startWorker();
+		return;
+	}
+
+	std::string worker;
+	if (backlog == 0 && running > workernum_ && workerpool_.retirable(shrink_idle_, worker))
+	{
+		workerpool_.leave(worker);
+
+		//  No client address: stop
+		zmq::message_t client;
+		zmq::message_t request;
+		s_dispatch(workers_socket_, worker, client, request);
+
+		LOG4CXX_INFO(logger, "workers shrink : " << running - 1 << ", " << worker << " retired");
+	}
+}
+
+void MyCacheServer::dispatchBacklog(std::deque<MyCachePending*>& backlog)
+{
+	//  Oldest requests first, skipping those whose worker is busy: the later
+	//  ones of the same key wait for the same worker, so they keep their order
+	std::string next;
+	std::deque<MyCachePending*>::iterator it = backlog.begin();
+	while (it != backlog.end() && workerpool_.idle() > 0)
+	{
+		if (!workerpool_.route((*it)->key, next))
+		{
+			++it;
+			continue;
+		}
+
+		MyCachePending* pending = *it;
+		it = backlog.erase(it);
+		s_dispatch(workers_socket_, next, pending->client, pending->request);
+		delete pending;
+	}
+}
+
+bool MyCacheServer::initWriteBack()
+{
+	flush_cachepool_ = newCachePool();
+	flush_dbpool_ = newDBPool();
+	if (!flush_cachepool_ || !flush_dbpool_)
+		return false;
+
+	for (int shard = 0; shard < flush_dbpool_->shardNum(); shard++)
+	{
+		std::ostringstream journal;
+		journal << journal_dir_ << "/mycached.writeback." << shard;
+
+		MyCacheWriteBack* writeback = new MyCacheWriteBack(shard, journal.str());
+		writeback->setSync(journal_sync_);
+		if (!writeback->open())
+		{
+			delete writeback;
+			return false;
+		}
+
+		writebacks_.push_back(writeback);
+		flusher_thrds.create_thread(boost::bind(&MyCacheServer::runFlusher, this, writeback));
+	}
+
+	LOG4CXX_INFO(logger, "write-back init .. " << writebacks_.size() << " every " << flush_interval_ << "ms");
+	return true;
+}
+
+MyCacheWriteBack* MyCacheServer::writeBack(const std::string& key)
+{
+	if (writebacks_.empty() || !flush_dbpool_)
+		return NULL;
+
+	MySqlConnectionPool* pool = flush_dbpool_->getShardByKey(key);
+	if (!pool || pool->shard() < 0 || pool->shard() >= (int)writebacks_.size())
+		return NULL;
+
+	return writebacks_[pool->shard()];
+}
+
+uint64_t MyCacheServer::nextVersion()
+{
+	// increasing across restarts
+	boost::mutex::scoped_lock lock(version_mutex_);
+	uint64_t now = (uint64_t)time(0) << 20;
+	version_ = std::max(version_ + 1, now);
+	return version_;
+}
+
+void MyCacheServer::runFlusher(MyCacheWriteBack* writeback)
+{
+	LOG4CXX_INFO(logger, "[flusher " << writeback->shard() << "] started");
+
+	while (!s_interrupted)
+	{
+		writeback->flush(flush_dbpool_, flush_cachepool_, flush_rows_);
+		boost::this_thread::sleep(boost::posix_time::milliseconds(flush_interval_));
+	}
+
+	// what's left is in the journal if this fails
+	writeback->flush(flush_dbpool_, flush_cachepool_, flush_rows_);
+	writeback->flush(flush_dbpool_, flush_cachepool_, flush_rows_);
+
+	LOG4CXX_INFO(logger, "[flusher " << writeback->shard() << "] finished, " << writeback->pending() << " pending");
+}
+
 void MyCacheServer::run()
 {
 	if (!clients_socket_ || !workers_socket_) 
 		return;
 
 	//  Logic of LRU loop
-    //  - Poll backend always, frontend only if 1+ worker ready
-    //  - If worker replies, queue worker as ready and forward reply
-    //    to client if necessary
-    //  - If client requests, pop next worker and send request to it
-    //
-    //  A very simple queue structure with known max size
-    std::vector<std::string> worker_queue;
-    size_t worker_queue_selector = 0;
+    //  - Poll backend always, frontend while the backlog has room
+    //  - If worker replies, it's idle again: forward reply to client
+    //    if necessary, and give it the oldest request waiting
+    //  - If client requests, route it to an idle worker, the one of
+    //    its key if possible, or else queue it in the backlog
+    std::deque<MyCachePending*> backlog;
+    boost::posix_time::ptime lastadjust = boost::posix_time::microsec_clock::universal_time();
 
     //  Initialize poll set
     zmq::pollitem_t items[] = {
         	//  Always poll for worker activity on backend
             { *workers_socket_, 0, ZMQ_POLLIN, 0 },
-            //  Poll front-end only if we have available workers
+            //  Poll front-end only if the backlog isn't full
             { *clients_socket_, 0, ZMQ_POLLIN, 0 }
     };
 
@@ -600,7 +1432,7 @@ void MyCacheServer::run()
     {
     	try 
     	{
-	        if (worker_queue.size())
+	        if (backlog.size() < s_max_backlog)
 	            zmq::poll(&items[0], 2, 100);
 	        else
 	            zmq::poll(&items[0], 1, 100);
@@ -608,9 +1440,9 @@ void MyCacheServer::run()
 	        //  Handle worker activity on backend
 	        if (items[0].revents & ZMQ_POLLIN) 
 	        {
-	            //  Queue worker address for LRU routing
 	            zmq::message_t worker_addr;
 	            workers_socket_->recv(&worker_addr);
+	            std::string worker((char*)worker_addr.data(), worker_addr.size());
 
 	            //  Second frame is empty
 	            {
@@ -635,9 +1467,6 @@ void MyCacheServer::run()
 	            	zmq::message_t reply;
 	            	workers_socket_->recv(&reply);
 
-	            	// std::string ret((char*)reply.data(), reply.size());
-	            	// std::cout << "frontend->client:" << ret << std::endl;
-
 	            	clients_socket_->send(client_addr_msg, ZMQ_SNDMORE);
 	            	
 	            	// Sync Client(REQ)
@@ -648,16 +1477,22 @@ void MyCacheServer::run()
 	            	}
 
 	            	clients_socket_->send(reply);
+
+	            	workerpool_.done(worker);
 	            }
 	            else
 	            {
-	            	worker_queue.push_back(std::string((char*)worker_addr.data(), worker_addr.size()));
+	            	workerpool_.join(worker);
+	            	if (starting_ > 0)
+	            		starting_--;
 	            }
+
+	            dispatchBacklog(backlog);
 	        }
 	        if (items[1].revents & ZMQ_POLLIN) 
 	        {
 
-	            //  Now get next client request, route to LRU worker
+	            //  Now get next client request, route to a worker
 	            //  Client request is [address][empty][request]
 	            zmq::message_t client_addr_msg;
 	            clients_socket_->recv(&client_addr_msg);
@@ -672,18 +1507,25 @@ void MyCacheServer::run()
 
 	            zmq::message_t request;
 	            clients_socket_->recv(&request);
-	            
-	            if (worker_queue.size() > 0)
-	            {
-		            std::string worker_addr = worker_queue[(worker_queue_selector++) % worker_queue.size()];
 
-		            zmq::message_t empty;
-		            workers_socket_->send(worker_addr.data(), worker_addr.size(), ZMQ_SNDMORE);
-		           	workers_socket_->send(empty, ZMQ_SNDMORE);
-		            workers_socket_->send(client_addr_msg, ZMQ_SNDMORE);
-		            workers_socket_->send(empty, ZMQ_SNDMORE);
-		            workers_socket_->send(request);
-	        	}
+	            //  Behind the requests waiting for the same worker
+	            MyCachePending* pending = new MyCachePending;
+	            pending->client.move(&client_addr_msg);
+	            pending->request.move(&request);
+	            pending->key = requestKey(pending->request);
+	            backlog.push_back(pending);
+
+	            dispatchBacklog(backlog);
+	        }
+
+	        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	        if ((now - lastadjust).total_milliseconds() >= 1000)
+	        {
+	        	adjustWorkers(backlog.size());
+	        	lastadjust = now;
+
+	        	// workers joined or left, the keys may have moved
+	        	dispatchBacklog(backlog);
 	        }
     	}
     	catch (const std::exception& err)
@@ -693,7 +1535,11 @@ void MyCacheServer::run()
     	}
     }
 
-    LOG4CXX_INFO(logger, "server will be shutdown");
+    LOG4CXX_INFO(logger, "server will be shutdown, " << backlog.size() << " requests dropped");
+
+    for (size_t i = 0; i < backlog.size(); i++)
+    	delete backlog[i];
+    backlog.clear();
 
     fini();
 }
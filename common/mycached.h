@@ -3,13 +3,22 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <list>
+#include <deque>
+#include <cstdio>
+#include <stdint.h>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
 #include "zmq.hpp"
 #include "mydb.h"
 #include "myredis_pool.h"
 #include "hashkit.h"
+#include "mycached_writeback.h"
 
 class MyCacheWorker;
+class HistogramMetric;
+struct MyCachePending;
 
 struct MsgHandler
 {
@@ -29,7 +38,10 @@ public:
 
 	bool init();
 	void reset();
-	void run();
+	// false if it stopped on an error, not retired or interrupted
+	bool run();
+
+	const std::string& name() const { return name_; }
 
 	RedisShardingPool* cachePool();
 	MySqlShardingPool* dbPool();
@@ -51,6 +63,110 @@ private:
 	MySqlShardingPool* dbpool_;
 };
 
+//
+// Single-flight loads from MySQL: the first miss of a key loads it and the
+// others, from any worker, wait for its result instead of running the same
+// SELECT.
+//
+class MyCacheLoads
+{
+public:
+	struct Load
+	{
+		Load() : done(false), ok(false), found(false) {}
+
+		boost::mutex mutex;
+		boost::condition_variable cond;
+		bool done;
+		bool ok;
+		bool found;
+		std::string value;
+	};
+
+	typedef boost::shared_ptr<Load> LoadPtr;
+
+	MyCacheLoads() : cost_(0.0) {}
+
+	// true if the caller does the load and then finish()es it
+	bool begin(const std::string& key, LoadPtr& load);
+	void finish(const std::string& key, const LoadPtr& load, bool ok, bool found, const std::string& value, double cost);
+
+	// false if the load isn't done within timeoutms
+	bool wait(const LoadPtr& load, int timeoutms);
+
+	// average seconds of a load
+	double cost();
+
+private:
+	boost::mutex mutex_;
+	std::map<std::string, LoadPtr> loads_;
+	double cost_;
+};
+
+//
+// Routing of the broker, by the LRU worker pattern: a worker gets one
+// request at a time. A request with a key goes to the worker of the key
+// only (its connections are warm for the key, and the requests of a key
+// keep their order), it waits while that one is busy; the keys move only
+// when workers join or leave. Requests without a key go to the least
+// recently used idle worker. stats() may be called from any thread.
+// Latencies also go to Metrics as mycached.worker.<name>.latency_us,
+// removed when the worker leaves.
+//
+class MyCacheWorkerPool
+{
+public:
+	struct Stats
+	{
+		Stats() : requests(0), avg(0), max(0), busy(false) {}
+
+		std::string worker;
+		uint64_t requests;
+		double avg;	// seconds, moving average
+		double max;
+		bool busy;
+	};
+
+	// READY from a new worker, it's the last one
+	void join(const std::string& worker);
+	void leave(const std::string& worker);
+
+	// the worker of the key if it's idle (any idle one for no key), false if none
+	bool route(const std::string& key, std::string& worker);
+
+	// its reply came back, idle again
+	void done(const std::string& worker);
+
+	// worker of the key, empty if none
+	std::string affinity(const std::string& key) const;
+
+	// the last worker joined, if it has been idle for idlesecs
+	bool retirable(int idlesecs, std::string& worker) const;
+
+	size_t size() const;
+	size_t idle() const;
+
+	std::vector<Stats> stats() const;
+
+private:
+	struct Slot
+	{
+		Stats stats;
+		boost::posix_time::ptime since;	// dispatched, or idle since
+		HistogramMetric* latency;
+	};
+
+	Slot* find(const std::string& worker);
+
+	// in join order, keys map onto it by jump hash
+	std::vector<Slot> slots_;
+
+	// LRU first
+	std::list<std::string> idle_;
+
+	mutable boost::mutex mutex_;
+};
+
 class MyCacheServer
 {
 public:
@@ -67,18 +183,66 @@ public:
 
 	zmq::context_t* context() { return context_; }
 
+	// write-back queue of the key, NULL if writes go to MySQL directly
+	MyCacheWriteBack* writeBack(const std::string& key);
+
+	// version of a SET, non-zero
+	uint64_t nextVersion();
+
+	MyCacheLoads& loads() { return loads_; }
+
+	std::vector<MyCacheWorkerPool::Stats> workerStats() const { return workerpool_.stats(); }
+
+protected:
+	bool initWriteBack();
+	void runFlusher(MyCacheWriteBack* writeback);
+
+	// new worker thread, it says READY after connecting to redis/mysql
+	void startWorker();
+	void runWorker(MyCacheWorker* worker);
+
+	// grow with the backlog, shrink when idle
+	void adjustWorkers(size_t backlog);
+
+	// the waiting requests whose worker is idle
+	void dispatchBacklog(std::deque<MyCachePending*>& backlog);
+
 private:
 	zmq::context_t* context_;
 	zmq::socket_t*  clients_socket_;
 	zmq::socket_t*  workers_socket_;
 
 	int workernum_;
+	int maxworkers_;
+	int grow_backlog_;
+	int shrink_idle_;
 
 	std::string address_;
 
 	std::vector<MyCacheWorker*> workers_;
 
 	boost::thread_group worker_thrds;
+
+	// broker
+	MyCacheWorkerPool workerpool_;
+	int nextworker_;
+	boost::atomic<int> starting_;
+
+	// write-back
+	std::vector<MyCacheWriteBack*> writebacks_;
+	RedisShardingPool* flush_cachepool_;
+	MySqlShardingPool* flush_dbpool_;
+	std::string journal_dir_;
+	int flush_interval_;
+	int flush_rows_;
+	bool journal_sync_;
+
+	boost::mutex version_mutex_;
+	uint64_t version_;
+
+	MyCacheLoads loads_;
+
+	boost::thread_group flusher_thrds;
 };
 
 
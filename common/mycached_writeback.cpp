@@ -0,0 +1,239 @@
+#include "mycached_writeback.h"
+#include <unistd.h>
+#include "mylogger.h"
+
+static LoggerPtr logger(Logger::getLogger("mycache"));
+
+//
+// The journal and the queues of MyCacheWriteBack, flush() to MySQL is in
+// mycached.cpp
+//
+
+//
+// Journal record: op(1) keylen(4) key vallen(4) value version(8)
+//
+enum { kJournalSet = 0, kJournalErase = 1 };
+
+static bool readJournal(FILE* fp, void* data, size_t size)
+{
+	return size == 0 || fread(data, size, 1, fp) == 1;
+}
+
+static bool readJournal(FILE* fp, std::string& str)
+{
+	uint32_t size = 0;
+	if (!readJournal(fp, &size, sizeof(size)))
+		return false;
+
+	str.resize(size);
+	return readJournal(fp, &str[0], size);
+}
+
+static bool hasNewer(const MyCacheWriteBack::Entries& entries, const std::string& key, uint64_t version)
+{
+	MyCacheWriteBack::Entries::const_iterator it = entries.find(key);
+	return it != entries.end() && it->second.version > version;
+}
+
+static bool writeJournal(FILE* fp, const void* data, size_t size)
+{
+	return size == 0 || fwrite(data, size, 1, fp) == 1;
+}
+
+static bool writeJournal(FILE* fp, const std::string& str)
+{
+	uint32_t size = str.size();
+	return writeJournal(fp, &size, sizeof(size)) && writeJournal(fp, str.data(), str.size());
+}
+
+MyCacheWriteBack::MyCacheWriteBack(int shard, const std::string& journal)
+{
+	shard_ = shard;
+	journal_path_ = journal;
+	flushing_path_ = journal + ".flushing";
+	journal_ = NULL;
+	sync_ = false;
+}
+
+MyCacheWriteBack::~MyCacheWriteBack()
+{
+	close();
+}
+
+bool MyCacheWriteBack::open()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	if (journal_)
+		return true;
+
+	replay(flushing_path_, flushing_);
+	replay(journal_path_, pending_);
+
+	// rewrite what's pending, a torn tail of the last run is dropped
+	std::string tmppath = journal_path_ + ".tmp";
+	journal_ = fopen(tmppath.c_str(), "wb");
+	if (!journal_)
+	{
+		LOG4CXX_ERROR(logger, "write-back " << shard_ << " open failed: " << tmppath);
+		return false;
+	}
+
+	bool ok = true;
+	for (Entries::const_iterator it = pending_.begin(); it != pending_.end() && ok; ++it)
+		ok = append(it->first, it->second);
+
+	fclose(journal_);
+	journal_ = NULL;
+
+	if (!ok || rename(tmppath.c_str(), journal_path_.c_str()) != 0)
+	{
+		LOG4CXX_ERROR(logger, "write-back " << shard_ << " open failed: " << journal_path_);
+		return false;
+	}
+
+	journal_ = fopen(journal_path_.c_str(), "ab");
+	if (!journal_)
+	{
+		LOG4CXX_ERROR(logger, "write-back " << shard_ << " open failed: " << journal_path_);
+		return false;
+	}
+
+	LOG4CXX_INFO(logger, "write-back " << shard_ << " opened: " << journal_path_
+		<< ", replayed " << flushing_.size() << "+" << pending_.size());
+	return true;
+}
+
+void MyCacheWriteBack::close()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	if (journal_)
+	{
+		fclose(journal_);
+		journal_ = NULL;
+	}
+}
+
+bool MyCacheWriteBack::replay(const std::string& path, Entries& entries)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return true;
+
+	size_t count = 0;
+	while (true)
+	{
+		uint8_t op = 0;
+		std::string key;
+		Entry entry;
+		if (!readJournal(fp, &op, sizeof(op)))
+			break;
+
+		if (!readJournal(fp, key) 
+			|| !readJournal(fp, entry.value) 
+			|| !readJournal(fp, &entry.version, sizeof(entry.version)))
+		{
+			LOG4CXX_WARN(logger, "write-back " << shard_ << " torn record: " << path << " after " << count);
+			break;
+		}
+
+		entry.erased = (kJournalErase == op);
+		if (!hasNewer(entries, key, entry.version))
+			entries[key] = entry;
+		count++;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+bool MyCacheWriteBack::append(const std::string& key, const Entry& entry)
+{
+	uint8_t op = entry.erased ? kJournalErase : kJournalSet;
+	if (!writeJournal(journal_, &op, sizeof(op))
+		|| !writeJournal(journal_, key)
+		|| !writeJournal(journal_, entry.value)
+		|| !writeJournal(journal_, &entry.version, sizeof(entry.version))
+		|| fflush(journal_) != 0)
+	{
+		LOG4CXX_ERROR(logger, "write-back " << shard_ << " journal failed: " << journal_path_);
+		return false;
+	}
+
+	if (sync_)
+		fdatasync(fileno(journal_));
+	return true;
+}
+
+bool MyCacheWriteBack::add(const std::string& key, const Entry& entry)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	// an older write that lost the race, the newer one stays
+	if (hasNewer(pending_, key, entry.version) || hasNewer(flushing_, key, entry.version))
+		return true;
+
+	if (!journal_ || !append(key, entry))
+		return false;
+
+	pending_[key] = entry;
+	return true;
+}
+
+bool MyCacheWriteBack::push(const std::string& key, const std::string& value, uint64_t version)
+{
+	Entry entry;
+	entry.value = value;
+	entry.version = version;
+	return add(key, entry);
+}
+
+bool MyCacheWriteBack::erase(const std::string& key, uint64_t version)
+{
+	Entry entry;
+	entry.version = version;
+	entry.erased = true;
+	return add(key, entry);
+}
+
+bool MyCacheWriteBack::lookup(const std::string& key, Entry& entry)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	Entries::const_iterator it = pending_.find(key);
+	if (it != pending_.end())
+	{
+		entry = it->second;
+		return true;
+	}
+
+	it = flushing_.find(key);
+	if (it != flushing_.end())
+	{
+		entry = it->second;
+		return true;
+	}
+
+	return false;
+}
+
+size_t MyCacheWriteBack::pending()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return pending_.size() + flushing_.size();
+}
+
+bool MyCacheWriteBack::rotate()
+{
+	if (journal_)
+	{
+		fclose(journal_);
+		journal_ = NULL;
+	}
+
+	if (rename(journal_path_.c_str(), flushing_path_.c_str()) != 0)
+	{
+		LOG4CXX_ERROR(logger, "write-back " << shard_ << " rotate failed: " << journal_path_);
+	}
+
+	journal_ = fopen(journal_path_.c_str(), "ab");
+	return journal_ != NULL;
+}
@@ -0,0 +1,84 @@
+#ifndef __COMMON_MYCACHED_WRITEBACK_H
+#define __COMMON_MYCACHED_WRITEBACK_H
+
+#include <string>
+#include <map>
+#include <cstdio>
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+class MySqlShardingPool;
+class RedisShardingPool;
+
+//
+// Write-back of SETs to MySQL, one queue per MySQL shard.
+//
+// A SET is journaled and queued once Redis has it, and the flusher batches
+// the queue into multi-row REPLACEs. The journal is rotated to *.flushing
+// when the flusher takes a batch and removed once the batch is in MySQL,
+// so a restart replays whatever wasn't flushed.
+//
+// Dirty hashes carry the version of their SET in `flag`, which goes back
+// to 0 after the flush unless a newer SET came in. Writes of a key are
+// ordered by version: an older one than what's queued is dropped, like the
+// cache drops an older SET.
+//
+class MyCacheWriteBack
+{
+public:
+	struct Entry
+	{
+		Entry() : version(0), erased(false) {}
+
+		std::string value;
+		uint64_t version;
+		bool erased;
+	};
+
+	// key -> the latest SET
+	typedef std::map<std::string, Entry> Entries;
+
+	MyCacheWriteBack(int shard, const std::string& journal);
+	~MyCacheWriteBack();
+
+	// replay the journal left by last run
+	bool open();
+	void close();
+
+	bool push(const std::string& key, const std::string& value, uint64_t version);
+	bool erase(const std::string& key, uint64_t version);
+
+	// the latest write not in MySQL yet
+	bool lookup(const std::string& key, Entry& entry);
+
+	// write one batch to MySQL, false if it has to be retried
+	bool flush(MySqlShardingPool* dbpool, RedisShardingPool* cachepool, size_t maxrows);
+
+	int shard() const { return shard_; }
+	size_t pending();
+
+	void setSync(bool sync) { sync_ = sync; }
+
+private:
+	bool replay(const std::string& path, Entries& entries);
+	bool add(const std::string& key, const Entry& entry);
+	bool append(const std::string& key, const Entry& entry);
+	bool rotate();
+
+	bool writeToMySQL(MySqlShardingPool* dbpool, size_t maxrows);
+	void cleanCache(RedisShardingPool* cachepool);
+
+	int shard_;
+	std::string journal_path_;
+	std::string flushing_path_;
+	FILE* journal_;
+	bool sync_;
+
+	boost::mutex mutex_;
+	Entries pending_;
+
+	// the batch in flight, only the flusher changes it
+	Entries flushing_;
+};
+
+#endif // __COMMON_MYCACHED_WRITEBACK_H
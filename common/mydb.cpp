@@ -9,7 +9,7 @@ static LoggerPtr logger(Logger::getLogger("mysql"));
 
 bool MySqlConnection::connectByURL(const std::string& urltext)
 {
-	URL url;
+	TinyURL url;
 	if (!url.parse(urltext))
 	{
 		LOG4CXX_ERROR(logger, "connect " << urltext << " failed : address is invalid");
@@ -52,7 +52,7 @@ MySqlConnectionPool::MySqlConnectionPool()
 void MySqlConnectionPool::setServerAddress(const std::string& urltext)
 {
 	url_ = urltext;
-	URL url;
+	TinyURL url;
 	if (url.parse(urltext))
 	{
 		if (url.query["shard"].size() > 0)
@@ -13,7 +13,7 @@ namespace myredis {
 
 	bool command(RedisReply& reply, const char* format, ...)
 	{
-		ScopedRedisConnection redis;
+		ScopedRedisConnection redis(RedisConnectionPool::instance());
 		if (redis)
 		{
 			bool ret = false;
@@ -30,7 +30,7 @@ namespace myredis {
 
 	bool commandv(RedisReply& reply, const char* format, va_list ap)
 	{
-		ScopedRedisConnection redis;
+		ScopedRedisConnection redis(RedisConnectionPool::instance());
 		if (redis)
 		{
 			redis->command_v(reply, format, ap);
@@ -0,0 +1,131 @@
+#include "myredis_mux.h"
+#include "mylogger.h"
+
+static LoggerPtr logger(Logger::getLogger("myredis"));
+
+RedisMultiplexer::RedisMultiplexer(const std::string& url, int timeoutms, size_t maxbatch)
+	: url_(url), maxbatch_(maxbatch ? maxbatch : 1), client_(url), running_(false)
+{
+	// a reply never comes from a dead socket, the futures have to be settled
+	client_.setTimeout(timeoutms);
+}
+
+RedisMultiplexer::~RedisMultiplexer()
+{
+	stop();
+}
+
+bool RedisMultiplexer::start()
+{
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (running_)
+		return true;
+
+	bool connected = client_.connect();
+	if (!connected)
+		LOG4CXX_WARN(logger, "multiplexer starts unconnected: " << url_);
+
+	running_ = true;
+	thread_ = std::thread([this]() { run(); });
+	return connected;
+}
+
+void RedisMultiplexer::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		if (!running_)
+			return;
+		running_ = false;
+	}
+
+	ready_.notify_all();
+	if (thread_.joinable())
+		thread_.join();
+
+	client_.close();
+}
+
+std::future<bool> RedisMultiplexer::post(const std::vector<std::string>& args, const RedisReplyView::Callback& callback)
+{
+	std::unique_lock<std::mutex> guard(mutex_);
+	if (!running_)
+	{
+		std::promise<bool> failed;
+		failed.set_value(false);
+		return failed.get_future();
+	}
+
+	queue_.push_back(Command());
+	Command& cmd = queue_.back();
+	cmd.args = args;
+	cmd.callback = callback;
+	std::future<bool> done = cmd.done.get_future();
+	guard.unlock();
+
+	ready_.notify_one();
+	return done;
+}
+
+bool RedisMultiplexer::command_argv(const std::vector<std::string>& args, const RedisReplyView::Callback& callback)
+{
+	return post(args, callback).get();
+}
+
+size_t RedisMultiplexer::pending()
+{
+	std::lock_guard<std::mutex> guard(mutex_);
+	return queue_.size();
+}
+
+void RedisMultiplexer::run()
+{
+	Commands batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> guard(mutex_);
+			ready_.wait(guard, [this]() { return !running_ || !queue_.empty(); });
+			if (queue_.empty())
+				return;
+
+			// whatever waits, up to maxbatch
+			while (!queue_.empty() && batch.size() < maxbatch_)
+			{
+				batch.push_back(std::move(queue_.front()));
+				queue_.pop_front();
+			}
+		}
+
+		flush(batch);
+		batch.clear();
+	}
+}
+
+void RedisMultiplexer::flush(Commands& batch)
+{
+	// buffered, written by the first getReply
+	size_t sent = 0;
+	while (sent < batch.size() && client_.appendCommand_argv(batch[sent].args))
+		sent ++;
+
+	size_t replied = 0;
+	for (; replied < sent; replied ++)
+	{
+		Command& cmd = batch[replied];
+		bool ok = cmd.callback ? client_.getReply(cmd.callback) : client_.getReply([](const RedisReplyView&) {});
+		if (!ok)
+			break;
+		cmd.done.set_value(true);
+	}
+
+	if (replied == batch.size())
+		return;
+
+	// the replies left would be out of step, start over on a new connection
+	LOG4CXX_ERROR(logger, "multiplexer lost " << (batch.size() - replied) << " commands: " << url_);
+	client_.close();
+
+	for (size_t i = replied; i < batch.size(); i++)
+		batch[i].done.set_value(false);
+}
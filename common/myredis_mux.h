@@ -0,0 +1,79 @@
+#ifndef __COMMON_MYREDIS_MUX_H
+#define __COMMON_MYREDIS_MUX_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include "myredis_sync.h"
+
+//
+// One connection to a Redis shared by many threads: the commands are
+// queued, and an I/O thread writes all that are waiting in one go and then
+// reads their replies in order (pipelining), so a burst of callers costs
+// one round trip instead of one connection each.
+//
+//   RedisMultiplexer redis("redis://127.0.0.1:6379/1");
+//   redis.start();
+//
+//   std::future<bool> done = redis.post({"HGETALL", key}, [&](const RedisReplyView& reply) {...});
+//   ...
+//   if (done.get()) ...
+//
+// The callback runs on the I/O thread, before the future is ready; the view
+// is only valid within it. A future is false if the command got no reply:
+// not connected, or the socket failed or timed out, then the commands after
+// it in the batch fail too and the connection is made again for the next.
+// An error reply is still a reply, the callback sees it. A callback must
+// not wait on the same multiplexer, nothing else is read meanwhile.
+//
+class RedisMultiplexer
+{
+public:
+	RedisMultiplexer(const std::string& url, int timeoutms = 1000, size_t maxbatch = 256);
+	~RedisMultiplexer();
+
+	const std::string& url() const { return url_; }
+
+	// false if not connected yet, the next commands try again
+	bool start();
+	// the queued commands are still sent
+	void stop();
+
+	std::future<bool> post(const std::vector<std::string>& args, const RedisReplyView::Callback& callback = RedisReplyView::Callback());
+
+	// blocking
+	bool command_argv(const std::vector<std::string>& args, const RedisReplyView::Callback& callback = RedisReplyView::Callback());
+
+	size_t pending();
+
+private:
+	struct Command
+	{
+		std::vector<std::string> args;
+		RedisReplyView::Callback callback;
+		std::promise<bool> done;
+	};
+
+	typedef std::deque<Command> Commands;
+
+	void run();
+	void flush(Commands& batch);
+
+	const std::string url_;
+	const size_t maxbatch_;
+
+	// the I/O thread only
+	RedisClient client_;
+
+	std::mutex mutex_;
+	std::condition_variable ready_;
+	Commands queue_;
+	bool running_;
+	std::thread thread_;
+};
+
+#endif // __COMMON_MYREDIS_MUX_H
@@ -10,7 +10,7 @@ void RedisConnectionPool::setServerAddress(const std::string& urltext)
 	url_ = urltext;
 	shard_ = -1;
 
-	URL url;
+	TinyURL url;
 	if (url.parse(urltext))
 	{
 		if (url.query["shard"].size() > 0)
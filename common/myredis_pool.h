@@ -12,6 +12,7 @@ public:
 	RedisConnectionPool()
 	{
 		shard_ = -1;
+		setMetricsName("redis.pool");
 	}
 
 	~RedisConnectionPool() {}
@@ -0,0 +1,79 @@
+#ifndef __COMMON_MYREDIS_RATELIMIT_H
+#define __COMMON_MYREDIS_RATELIMIT_H
+
+#include <string>
+#include "myredis_pool.h"
+#include "redis_ratelimit.h"
+
+//
+// Rate limits over the sync client, see redis_ratelimit.h. Checks are let
+// through when Redis can't be reached, a throttle isn't worth an outage.
+//
+class RedisRateLimiter
+{
+public:
+	RedisRateLimiter(RedisConnectionPool* pool, size_t maxkeys = 10000)
+		: pool_(pool), tokens_(maxkeys) {}
+
+	// one token of the bucket
+	bool acquire(const std::string& key, const TokenBucket& bucket)
+	{
+		const int64_t now = RedisRateLimit::now();
+		switch (tokens_.take(key, now))
+		{
+			case RedisTokenCache::kGranted: return true;
+			case RedisTokenCache::kDenied: return false;
+			default: break;
+		}
+
+		long long granted = 0;
+		if (!eval(granted, *RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, bucket.batch, now)))
+			return true;
+
+		if (granted <= 0)
+		{
+			tokens_.put(key, 0, now + RedisRateLimit::denyFor(bucket), now);
+			return false;
+		}
+
+		if (granted > 1)
+			tokens_.put(key, granted - 1, now + bucket.lease_ms, now);
+		return true;
+	}
+
+	// one hit of the window
+	bool hit(const std::string& key, const SlidingWindow& window)
+	{
+		long long allowed = 1;
+		eval(allowed, *RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, RedisRateLimit::now()));
+		return allowed != 0;
+	}
+
+	// count of the fixed window after adding n, -1 if failed
+	long long count(const std::string& key, uint32_t window_ms, long long n = 1)
+	{
+		long long count = -1;
+		eval(count, *RedisRateLimit::counter(), key, RedisRateLimit::counterArgs(n, window_ms));
+		return count;
+	}
+
+private:
+	bool eval(long long& result, RedisScript& script, const std::string& key, const std::vector<std::string>& args)
+	{
+		ScopedRedisConnection redis(pool_);
+		if (!redis)
+			return false;
+
+		RedisReply reply;
+		if (!redis->evalsha(reply, script, {key}, args) || reply.type != REDIS_REPLY_INTEGER)
+			return false;
+
+		result = reply.getInteger();
+		return true;
+	}
+
+	RedisConnectionPool* pool_;
+	RedisTokenCache tokens_;
+};
+
+#endif // __COMMON_MYREDIS_RATELIMIT_H
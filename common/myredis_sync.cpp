@@ -37,6 +37,7 @@ bool RedisReply::parseFrom(redisReply* reply)
 
 	if (REDIS_REPLY_ARRAY == type)
 	{
+		elements.reserve(reply->elements);
 		for (size_t i = 0; i < reply->elements; i++)
 		{
 			std::string element;
@@ -84,6 +85,7 @@ RedisClient::RedisClient(const char* ip, int port)
 	port_ = port;
 	shard_ = -1;
 	index_ = 0;
+	timeout_ = 0;
 }
 
 RedisClient::RedisClient(const std::string& urltext)
@@ -92,9 +94,10 @@ RedisClient::RedisClient(const std::string& urltext)
 	port_ = 0;
 	shard_ = -1;
 	index_ = 0;
+	timeout_ = 0;
 	url_ = urltext;
 
-	URL url;
+	TinyURL url;
 	if (url.parse(urltext))
 	{
 		ip_ = url.host;
@@ -133,6 +136,9 @@ bool RedisClient::connect()
     	return false;
     }
 
+    if (timeout_ > 0)
+    	setTimeout(timeout_);
+
     if (index_ > 0)
     	select(index_);
 
@@ -176,6 +182,18 @@ void RedisClient::close()
 	} 
 }
 
+bool RedisClient::setTimeout(int millsecs)
+{
+	timeout_ = millsecs;
+	if (!context_)
+		return true;
+
+	struct timeval timeout;
+	timeout.tv_sec = millsecs/1000;
+	timeout.tv_usec = (millsecs%1000)*1000;
+	return redisSetTimeout(context_, timeout) == REDIS_OK;
+}
+
 void RedisClient::checkConnection()
 {
 	if (!isConnected())
@@ -231,6 +249,53 @@ bool RedisClient::command_argv(RedisReply& reply, const std::vector<std::string>
 	return true;
 }
 
+bool RedisClient::command_view(const RedisReplyView::Callback& callback, const char* format, ...)
+{
+	checkConnection();
+	if (!isConnected())
+		return false;
+
+	va_list ap;
+	va_start(ap, format);
+	redisReply* redisreply = (redisReply*)redisvCommand(context_, format, ap);
+	va_end(ap);
+
+	if (!redisreply)
+		return false;
+
+	callback(RedisReplyView(redisreply));
+	freeReplyObject(redisreply);
+	return true;
+}
+
+bool RedisClient::command_argv(const std::vector<std::string>& args, const RedisReplyView::Callback& callback)
+{
+	redisReply* redisreply = execArgv(args);
+	if (!redisreply)
+		return false;
+
+	callback(RedisReplyView(redisreply));
+	freeReplyObject(redisreply);
+	return true;
+}
+
+redisReply* RedisClient::execArgv(const std::vector<std::string>& args)
+{
+	checkConnection();
+	if (!isConnected())
+		return NULL;
+
+	std::vector<const char*> argv(args.size());
+	std::vector<size_t> argvlen(args.size());
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		argv[i] = args[i].data();
+		argvlen[i] = args[i].size();
+	}
+
+	return (redisReply*)redisCommandArgv(context_, (int)args.size(), argv.data(), argvlen.data());
+}
+
 bool RedisClient::appendCommand(const char* format, ...)
 {
 	checkConnection();
@@ -246,6 +311,23 @@ bool RedisClient::appendCommand(const char* format, ...)
     return ret == REDIS_OK;
 }
 
+bool RedisClient::appendCommand_argv(const std::vector<std::string>& args)
+{
+	checkConnection();
+	if (!isConnected())
+		return false;
+
+	std::vector<const char*> argv(args.size());
+	std::vector<size_t> argvlen(args.size());
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		argv[i] = args[i].data();
+		argvlen[i] = args[i].size();
+	}
+
+	return redisAppendCommandArgv(context_, (int)args.size(), argv.data(), argvlen.data()) == REDIS_OK;
+}
+
 bool RedisClient::getReply(RedisReply& reply)
 {
 	checkConnection();
@@ -259,6 +341,21 @@ bool RedisClient::getReply(RedisReply& reply)
 	return ret == REDIS_OK;
 }
 
+bool RedisClient::getReply(const RedisReplyView::Callback& callback)
+{
+	checkConnection();
+	if (!isConnected())
+		return false;
+
+	redisReply* redisreply = NULL;
+	if (redisGetReply(context_, (void **)&redisreply) != REDIS_OK || !redisreply)
+		return false;
+
+	callback(RedisReplyView(redisreply));
+	freeReplyObject(redisreply);
+	return true;
+}
+
 bool RedisClient::select(int index)
 {
 	RedisReply reply;
@@ -344,20 +441,20 @@ bool RedisClient::punsubscribe(const char* format, ...)
 
 bool RedisClient::hgetall(const std::string& key, RedisReply::Map& kvs)
 {
-	RedisReply reply;
-	if (command(reply, "HGETALL %b", key.data(), key.size()))
-	{
-		RedisReply::Array& elements = reply.getArray();
-		if (elements.size() < 2)
-			return false;
-
-		for (size_t i = 0; i < elements.size() - 1; i += 2)
-			kvs[elements[i]] = elements[i+1];
+	bool found = false;
+	bool ret = hgetall(key, [&kvs, &found](const RedisStringView& field, const RedisStringView& value) {
+		kvs[field.str()].assign(value.data, value.size);
+		found = true;
+	});
 
-		return true;
-	}
+	return ret && found;
+}
 
-	return false;
+bool RedisClient::hgetall(const std::string& key, const RedisReplyView::PairCallback& callback)
+{
+	return command_view([&callback](const RedisReplyView& reply) {
+		reply.forEachPair(callback);
+	}, "HGETALL %b", key.data(), key.size());
 }
 
 static void map2vector(const RedisReply::Map& kvs, RedisReply::Array& vec)
@@ -385,3 +482,71 @@ bool RedisClient::hmset(const std::string& key, const RedisReply::Map& kvs)
 }
 
 
+
+bool RedisClient::scriptLoad(RedisScript& script)
+{
+	redisReply* redisreply = execArgv(script.loadArgs());
+	if (!redisreply)
+		return false;
+
+	bool ret = false;
+	if (REDIS_REPLY_STRING == redisreply->type)
+	{
+		script.setSha1(std::string(redisreply->str, redisreply->len));
+		ret = true;
+	}
+	else
+	{
+		LOG4CXX_ERROR(logger, "script load failed: " << script.name() << ": "
+			<< (redisreply->str ? redisreply->str : ""));
+	}
+
+	freeReplyObject(redisreply);
+	return ret;
+}
+
+redisReply* RedisClient::execScript(RedisScript& script, const std::vector<std::string>& keys, const std::vector<std::string>& args)
+{
+	if (!script.loaded() && !scriptLoad(script))
+		return NULL;
+
+	redisReply* redisreply = execArgv(script.evalshaArgs(keys, args));
+	if (redisreply
+		&& REDIS_REPLY_ERROR == redisreply->type
+		&& RedisScript::isNoScript(redisreply->str, redisreply->len))
+	{
+		// flushed or a new server, load it and try once more
+		freeReplyObject(redisreply);
+		if (!scriptLoad(script))
+			return NULL;
+
+		redisreply = execArgv(script.evalshaArgs(keys, args));
+	}
+
+	return redisreply;
+}
+
+bool RedisClient::evalsha(RedisReply& reply, RedisScript& script,
+	const std::vector<std::string>& keys, const std::vector<std::string>& args)
+{
+	redisReply* redisreply = execScript(script, keys, args);
+	if (!redisreply)
+		return false;
+
+	reply.parseFrom(redisreply);
+	freeReplyObject(redisreply);
+	return REDIS_REPLY_ERROR != reply.type;
+}
+
+bool RedisClient::evalsha(const RedisReplyView::Callback& callback, RedisScript& script,
+	const std::vector<std::string>& keys, const std::vector<std::string>& args)
+{
+	redisReply* redisreply = execScript(script, keys, args);
+	if (!redisreply)
+		return false;
+
+	bool ret = REDIS_REPLY_ERROR != redisreply->type;
+	callback(RedisReplyView(redisreply));
+	freeReplyObject(redisreply);
+	return ret;
+}
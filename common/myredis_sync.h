@@ -7,6 +7,8 @@
 #include <map>
 #include <cstdarg>
 #include "hiredis/hiredis.h"
+#include "redis_reply_view.h"
+#include "redis_script.h"
 
 struct RedisReply
 {
@@ -51,13 +53,22 @@ public:
 	bool connectWithTimeOut(int millsecs);
 	void close();
 
+	// read/write timeout of the socket, kept across reconnects, 0 for none
+	bool setTimeout(int millsecs);
+
 	bool command(RedisReply& reply, const char* format, ...);
 	bool command_v(RedisReply& reply, const char* format, va_list ap);
 	bool command_argv(RedisReply& reply, const std::vector<std::string>& args);
 
+	// no copy of the reply, the view is only valid within the callback
+	bool command_view(const RedisReplyView::Callback& callback, const char* format, ...);
+	bool command_argv(const std::vector<std::string>& args, const RedisReplyView::Callback& callback);
+
 	// pipeline
 	bool appendCommand(const char* format, ...);
+	bool appendCommand_argv(const std::vector<std::string>& args);
 	bool getReply(RedisReply& reply);
+	bool getReply(const RedisReplyView::Callback& callback);
 
 public:
 	bool select(int index);
@@ -73,11 +84,22 @@ public:
 
 	// HASHES
 	bool hgetall(const std::string& key, RedisReply::Map& kvs);
+	bool hgetall(const std::string& key, const RedisReplyView::PairCallback& callback);
 	bool hmset(const std::string& key, const RedisReply::Map& kvs);
 
+	// LUA SCRIPTS: EVALSHA, loaded again if the server says NOSCRIPT
+	bool scriptLoad(RedisScript& script);
+	bool evalsha(RedisReply& reply, RedisScript& script,
+		const std::vector<std::string>& keys, const std::vector<std::string>& args = std::vector<std::string>());
+	bool evalsha(const RedisReplyView::Callback& callback, RedisScript& script,
+		const std::vector<std::string>& keys, const std::vector<std::string>& args = std::vector<std::string>());
+
 private:
 	void checkConnection();
 
+	redisReply* execArgv(const std::vector<std::string>& args);
+	redisReply* execScript(RedisScript& script, const std::vector<std::string>& keys, const std::vector<std::string>& args);
+
 	redisContext* context_;
 
 	std::string url_;
@@ -87,6 +109,8 @@ private:
 	int index_;
 
 	int shard_;
+
+	int timeout_;
 };
 
 typedef RedisClient RedisConnection;
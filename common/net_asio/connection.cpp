@@ -2,6 +2,7 @@
 #include <sstream>
 #include <boost/thread.hpp>
 #include "mylogger.h"
+#include "tinymetrics.h"
 
 NAMESPACE_NETASIO_BEGIN
 
@@ -9,6 +10,29 @@ static LoggerPtr logger(Logger::getLogger("tinyserver"));
 
 namespace {
 
+	/// 所有连接的收发统计
+	struct NetMetrics
+	{
+		NetMetrics()
+			: bytes_in(Metrics::counter("net.bytes_in")),
+			  bytes_out(Metrics::counter("net.bytes_out")),
+			  msgs_in(Metrics::counter("net.msgs_in")),
+			  msgs_out(Metrics::counter("net.msgs_out"))
+		{
+		}
+
+		CounterMetric& bytes_in;
+		CounterMetric& bytes_out;
+		CounterMetric& msgs_in;
+		CounterMetric& msgs_out;
+	};
+
+	NetMetrics& netMetrics()
+	{
+		static NetMetrics metrics;
+		return metrics;
+	}
+
 	template <typename T>
 	struct IDAllocator
 	{
@@ -158,6 +182,9 @@ bool Connection::readMessages()
 	    		<< ", type2=" << (int)mh->type_second);
 	    	#endif
 
+	    	netMetrics().msgs_in.inc();
+	    	netMetrics().bytes_in.inc(msgsize);
+
 	    	if (message_handler_)
 	    		message_handler_(shared_from_this(), 
 	    			boost::asio::buffer_cast<const char*>(readbuf_.data()),
@@ -198,6 +225,9 @@ void Connection::handle_write(const boost::system::error_code& e, SharedBuffer b
 	if (!e)
 	{
 		LOG4CXX_INFO(logger, debugString() << " - handle_write:" << buff.size);
+
+		netMetrics().msgs_out.inc();
+		netMetrics().bytes_out.inc(buff.size);
 	}
 	else
 	{
@@ -1,13 +1,24 @@
 #include "connection_manager.h"
-#include <algorithm>
-#include <boost/bind.hpp>
 
 NAMESPACE_NETASIO_BEGIN
 
+ConnectionManager::ConnectionManager() : size_(0)
+{
+}
+
 void ConnectionManager::start(ConnectionPtr c)
 {
-	boost::mutex::scoped_lock slock(connections_lock_);
-	connections_.insert(std::make_pair(c->id(), c));
+	{
+		Shard& s = shard(c->id());
+		boost::mutex::scoped_lock slock(s.lock);
+
+		if (s.connections.insert(std::make_pair(c->id(), c)).second)
+		{
+			s.types[c->type()].insert(std::make_pair(c->id(), c));
+			size_.fetch_add(1, boost::memory_order_relaxed);
+		}
+	}
+
 	c->start();
 }
 
@@ -19,24 +30,118 @@ void ConnectionManager::stop(ConnectionPtr c)
 
 void ConnectionManager::stop(uint32 id)
 {
-	boost::mutex::scoped_lock slock(connections_lock_);
+	ConnectionPtr conn;
 
-	ConnectionMap::iterator it = connections_.find(id);
-	if (it != connections_.end())
 	{
-		it->second->stop();
-		connections_.erase(it);
+		Shard& s = shard(id);
+		boost::mutex::scoped_lock slock(s.lock);
+		conn = remove(s, id);
 	}
+
+	if (conn)
+		conn->stop();
 }
 
 void ConnectionManager::stop_all()
 {
-	boost::mutex::scoped_lock slock(connections_lock_);
+	for (size_t i = 0; i < kShardNum; ++ i)
+	{
+		ConnectionMap conns;
+
+		{
+			Shard& s = shards_[i];
+			boost::mutex::scoped_lock slock(s.lock);
+			conns.swap(s.connections);
+			s.types.clear();
+			size_.fetch_sub(conns.size(), boost::memory_order_relaxed);
+		}
+
+		for (ConnectionMap::iterator it = conns.begin(); it != conns.end(); ++ it)
+			it->second->stop();
+	}
+}
+
+ConnectionPtr ConnectionManager::get(uint32 id)
+{
+	Shard& s = shard(id);
+	boost::mutex::scoped_lock slock(s.lock);
+
+	ConnectionMap::iterator it = s.connections.find(id);
+	if (it != s.connections.end())
+		return it->second;
+	return ConnectionPtr();
+}
+
+void ConnectionManager::set_type(ConnectionPtr c, uint32 type)
+{
+	Shard& s = shard(c->id());
+	boost::mutex::scoped_lock slock(s.lock);
+
+	if (s.connections.count(c->id()))
+	{
+		TypeIndex::iterator it = s.types.find(c->type());
+		if (it != s.types.end())
+		{
+			it->second.erase(c->id());
+			if (it->second.empty())
+				s.types.erase(it);
+		}
+
+		s.types[type].insert(std::make_pair(c->id(), c));
+	}
+
+	c->set_type(type);
+}
+
+void ConnectionManager::snapshot(ConnectionVector& conns)
+{
+	conns.reserve(conns.size() + size());
+
+	for (size_t i = 0; i < kShardNum; ++ i)
+	{
+		Shard& s = shards_[i];
+		boost::mutex::scoped_lock slock(s.lock);
+
+		for (ConnectionMap::iterator it = s.connections.begin(); it != s.connections.end(); ++ it)
+			conns.push_back(it->second);
+	}
+}
+
+void ConnectionManager::snapshot(uint32 type, ConnectionVector& conns)
+{
+	for (size_t i = 0; i < kShardNum; ++ i)
+	{
+		Shard& s = shards_[i];
+		boost::mutex::scoped_lock slock(s.lock);
+
+		TypeIndex::iterator tit = s.types.find(type);
+		if (tit == s.types.end())
+			continue;
+
+		for (ConnectionMap::iterator it = tit->second.begin(); it != tit->second.end(); ++ it)
+			conns.push_back(it->second);
+	}
+}
 
-	for (ConnectionMap::iterator it = connections_.begin(); it != connections_.end(); ++ it)
-		it->second->stop();
+ConnectionPtr ConnectionManager::remove(Shard& s, uint32 id)
+{
+	ConnectionMap::iterator it = s.connections.find(id);
+	if (it == s.connections.end())
+		return ConnectionPtr();
+
+	ConnectionPtr conn = it->second;
+	s.connections.erase(it);
+
+	TypeIndex::iterator tit = s.types.find(conn->type());
+	if (tit != s.types.end())
+	{
+		tit->second.erase(id);
+		if (tit->second.empty())
+			s.types.erase(tit);
+	}
 
-	connections_.clear();
+	size_.fetch_sub(1, boost::memory_order_relaxed);
+	return conn;
 }
 
-NAMESPACE_NETASIO_END
\ No newline at end of file
+NAMESPACE_NETASIO_END
@@ -1,23 +1,32 @@
 #ifndef _NET_ASIO_CONNECTION_MANAGER_H
 #define _NET_ASIO_CONNECTION_MANAGER_H
 
-#include <set>
-#include <map>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/unordered_map.hpp>
 #include "connection.h"
 #include "net.h"
 
 NAMESPACE_NETASIO_BEGIN
 
+typedef std::vector<ConnectionPtr> ConnectionVector;
+
 ////////////////////////////////////////////////////////
 //
-// TCP连接管理器
+// TCP连接管理器:
+//   1> 按连接ID分片(kShardNum个)，每个分片各自加锁，
+//      接受/关闭连接只竞争所在分片的锁
+//   2> 分片内按ID索引(O(1)查找)，并按连接类型建立二级索引
+//   3> 广播时逐个分片拷贝快照，发送过程中不持有任何锁
 //
 ////////////////////////////////////////////////////////
 class ConnectionManager : private boost::noncopyable
 {
 public:
+	ConnectionManager();
+
 	/// Add the specified connection to the manager and start it.
 	void start(ConnectionPtr c);
 
@@ -28,47 +37,73 @@ public:
 	/// Stop all connections.
 	void stop_all();
 
+	/// 按ID查找连接(不存在返回空)
+	ConnectionPtr get(uint32 id);
+
+	/// 修改连接类型，同时维护类型索引
+	void set_type(ConnectionPtr c, uint32 type);
+
+	/// 取得所有连接/某类型连接的快照
+	void snapshot(ConnectionVector& conns);
+	void snapshot(uint32 type, ConnectionVector& conns);
+
 	template <typename ProtoT>
 	void sendTo(uint32 id, const ProtoT& proto)
 	{
-		boost::mutex::scoped_lock slock(connections_lock_);
-
-		ConnectionMap::iterator it = connections_.find(id);
-		if (it != connections_.end())
-		{
-			it->second->send(proto);
-		}
+		ConnectionPtr conn = get(id);
+		if (conn)
+			conn->send(proto);
 	}
 
 	template <typename ProtoT>
 	void broadcastTo(uint32 type, const ProtoT& proto)
 	{
-		boost::mutex::scoped_lock slock(connections_lock_);
+		ConnectionVector conns;
+		snapshot(type, conns);
 
-		for (ConnectionMap::iterator it = connections_.begin(); 
-			it != connections_.end(); ++ it)
-			if (it->second->type() == type)
-				it->second->send(proto);
+		for (ConnectionVector::iterator it = conns.begin(); it != conns.end(); ++ it)
+			(*it)->send(proto);
 	}
 
 	template <typename ProtoT>
 	void broadcastToAll(const ProtoT& proto)
 	{
-		boost::mutex::scoped_lock slock(connections_lock_);
+		ConnectionVector conns;
+		snapshot(conns);
 
-		for (ConnectionMap::iterator it = connections_.begin(); 
-			it != connections_.end(); ++ it)
-			it->second->send(proto);
+		for (ConnectionVector::iterator it = conns.begin(); it != conns.end(); ++ it)
+			(*it)->send(proto);
 	}
 
-	size_t size() { return connections_.size(); }
+	size_t size() { return size_.load(boost::memory_order_relaxed); }
 
 private:
-	typedef std::map<uint32, ConnectionPtr> ConnectionMap;
+	typedef boost::unordered_map<uint32, ConnectionPtr> ConnectionMap;
+	typedef boost::unordered_map<uint32, ConnectionMap> TypeIndex;
+
+	struct Shard
+	{
+		boost::mutex lock;
+
+		/// ID -> 连接
+		ConnectionMap connections;
+
+		/// 类型 -> (ID -> 连接)
+		TypeIndex types;
+	};
+
+	enum { kShardNum = 32 };
+
+	Shard& shard(uint32 id) { return shards_[id % kShardNum]; }
+
+	/// 从分片中移除连接(调用者持有分片锁)
+	ConnectionPtr remove(Shard& s, uint32 id);
+
 	/// The managed connections.
-	ConnectionMap connections_;
+	Shard shards_[kShardNum];
 
-	boost::mutex connections_lock_;
+	/// 连接总数
+	boost::atomic<size_t> size_;
 };
 
 NAMESPACE_NETASIO_END
@@ -0,0 +1,317 @@
+#include "core_pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <boost/bind.hpp>
+#include "mylogger.h"
+
+static LoggerPtr logger(Logger::getLogger("tinyserver"));
+
+NAMESPACE_NETASIO_BEGIN
+
+namespace {
+
+	typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+
+	/// 当前线程所属的分片
+	__thread CoreShard* s_current_shard = NULL;
+
+	/// 每个SPSC队列的容量，满了之后退化为io_service::post
+	const size_t kInboxCapacity = 4096;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+CoreShard::CoreShard(CorePool& pool, size_t index, size_t cores,
+		ProtobufMsgDispatcher& msgdispatcher)
+			: pool_(pool),
+			  index_(index),
+			  io_service_(1),
+			  work_(io_service_),
+			  notified_(false),
+			  msgdispatcher_(msgdispatcher),
+			  acceptor_(io_service_),
+			  new_connection_()
+{
+	for (size_t i = 0; i < cores; ++ i)
+	{
+		inbox_.push_back(TaskQueuePtr(new TaskQueue(kInboxCapacity)));
+		overflow_.push_back(boost::make_shared<boost::atomic<size_t> >(0));
+	}
+
+	LOG4CXX_INFO(logger, "CoreShard::created - " << index_);
+}
+
+CoreShard::~CoreShard()
+{
+	LOG4CXX_INFO(logger, "CoreShard::destroyed - " << index_);
+}
+
+bool CoreShard::listen(const boost::asio::ip::tcp::endpoint& endpoint)
+{
+	boost::system::error_code ec;
+	acceptor_.open(endpoint.protocol(), ec);
+	if (!ec) acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+	if (!ec) acceptor_.set_option(reuse_port(true), ec);
+	if (!ec) acceptor_.bind(endpoint, ec);
+	if (!ec) acceptor_.listen(boost::asio::socket_base::max_connections, ec);
+
+	if (ec)
+	{
+		LOG4CXX_ERROR(logger, "CoreShard::listen - " << index_ << " : " << ec.message());
+		return false;
+	}
+
+	io_service_.post(boost::bind(&CoreShard::start_accept, this));
+	return true;
+}
+
+void CoreShard::close()
+{
+	close_async().wait();
+}
+
+boost::shared_future<void> CoreShard::close_async()
+{
+	boost::shared_ptr<boost::promise<void> > done = boost::make_shared<boost::promise<void> >();
+	boost::shared_future<void> closed(done->get_future());
+
+	// acceptor和连接只在本分片线程上操作
+	if (CorePool::current() == this || io_service_.stopped())
+		handle_close(done);
+	else
+		io_service_.post(boost::bind(&CoreShard::handle_close, this, done));
+
+	return closed;
+}
+
+void CoreShard::handle_close(boost::shared_ptr<boost::promise<void> > done)
+{
+	boost::system::error_code ec;
+	acceptor_.close(ec);
+	this->stop_all();
+	done->set_value();
+}
+
+void CoreShard::run(bool pin)
+{
+	s_current_shard = this;
+
+	if (pin)
+	{
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(index_ % CPU_SETSIZE, &cpuset);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+			LOG4CXX_ERROR(logger, "CoreShard::run - pin to cpu failed: " << index_);
+	}
+
+	io_service_.run();
+	s_current_shard = NULL;
+}
+
+void CoreShard::fini()
+{
+	io_service_.stop();
+}
+
+bool CoreShard::push(size_t from, const Task& task)
+{
+	if (from >= inbox_.size())
+		return false;
+
+	// 还有经io_service投递的任务未执行时不进队列，否则会越过它们先执行
+	if (overflow_[from]->load(boost::memory_order_acquire) == 0 && inbox_[from]->push(task))
+	{
+		if (!notified_.exchange(true, boost::memory_order_acq_rel))
+			io_service_.post(boost::bind(&CoreShard::drain, this));
+		return true;
+	}
+
+	// 队列中已有的任务由之前投递的drain先执行
+	overflow_[from]->fetch_add(1, boost::memory_order_acq_rel);
+	io_service_.post(boost::bind(&CoreShard::run_overflowed, this, from, task));
+	return true;
+}
+
+void CoreShard::run_overflowed(size_t from, const Task& task)
+{
+	task();
+	overflow_[from]->fetch_sub(1, boost::memory_order_acq_rel);
+}
+
+void CoreShard::drain()
+{
+	notified_.store(false, boost::memory_order_release);
+
+	Task task;
+	for (size_t i = 0; i < inbox_.size(); ++ i)
+	{
+		while (inbox_[i]->pop(task))
+			task();
+	}
+}
+
+void CoreShard::start_accept()
+{
+	// 连接的socket和strand都在本分片的io_service上
+	new_connection_.reset(new Session(io_service_, io_service_,
+		boost::bind(&CoreShard::handle_message, this, _1, _2, _3)));
+
+	new_connection_->set_id(0);
+	new_connection_->set_name("session");
+	new_connection_->set_read_error_callback(boost::bind(&CoreShard::handle_error, this, _1));
+	new_connection_->set_write_error_callback(boost::bind(&CoreShard::handle_error, this, _1));
+
+	acceptor_.async_accept(new_connection_->socket(),
+		boost::bind(&CoreShard::handle_accept, this,
+			boost::asio::placeholders::error));
+
+	new_connection_->set_state(Connection::kState_Connecting);
+}
+
+void CoreShard::handle_accept(const boost::system::error_code& e)
+{
+	if (e == boost::asio::error::operation_aborted)
+		return;
+
+	if (!e)
+	{
+		this->start(new_connection_);
+		new_connection_->set_state(Connection::kState_Connected);
+	}
+	else
+	{
+		LOG4CXX_ERROR(logger, "CoreShard::handle_accept - " << index_ << " : " << e.message());
+	}
+
+	start_accept();
+}
+
+void CoreShard::handle_message(ConnectionPtr conn, const char* msg, size_t msgsize)
+{
+	MessageHeader* mh = (MessageHeader*)msg;
+	if (mh->msgsize() == msgsize)
+	{
+		ProtobufMsgHandler::MessagePtr protomsg = msgdispatcher_.makeMessage(
+			mh->type, (void*)(msg + sizeof(MessageHeader)), mh->size);
+
+		// 连接只在本分片线程上读写，不需要再投递
+		if (protomsg)
+			msgdispatcher_.dispatchMsg1<ConnectionPtr>(mh->type, protomsg, conn);
+	}
+}
+
+void CoreShard::handle_error(ConnectionPtr conn)
+{
+	LOG4CXX_INFO(logger, "CoreShard::handle_error - " << index_);
+
+	if (!conn->isClosed())
+	{
+		conn->set_state(Connection::kState_Closed);
+		this->stop(conn);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+
+CorePool::CorePool(size_t cores, ProtobufMsgDispatcher& msgdispatcher, bool pin)
+	: cores_(cores), pin_(pin), msgdispatcher_(msgdispatcher)
+{
+}
+
+bool CorePool::init()
+{
+	LOG4CXX_INFO(logger, "CorePool::init - " << cores_);
+
+	if (cores_ == 0)
+	{
+		LOG4CXX_ERROR(logger, "CorePool size is 0");
+		return false;
+	}
+
+	for (size_t i = 0; i < cores_; ++ i)
+		shards_.push_back(CoreShardPtr(new CoreShard(*this, i, cores_, msgdispatcher_)));
+
+	for (size_t i = 0; i < shards_.size(); ++ i)
+		threads_.create_thread(boost::bind(&CoreShard::run, shards_[i].get(), pin_));
+
+	return true;
+}
+
+bool CorePool::listen(const std::string& address, const std::string& port)
+{
+	LOG4CXX_INFO(logger, "CorePool::listen - " << address << ":" << port);
+
+	boost::asio::io_service ios;
+	boost::asio::ip::tcp::resolver resolver(ios);
+	boost::asio::ip::tcp::resolver::query query(address, port);
+	boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
+
+	for (size_t i = 0; i < shards_.size(); ++ i)
+	{
+		if (!shards_[i]->listen(endpoint))
+			return false;
+	}
+
+	return true;
+}
+
+void CorePool::close()
+{
+	// 先全部投递，各分片并行关闭
+	std::vector<boost::shared_future<void> > closed;
+	for (size_t i = 0; i < shards_.size(); ++ i)
+		closed.push_back(shards_[i]->close_async());
+
+	for (size_t i = 0; i < closed.size(); ++ i)
+		closed[i].wait();
+}
+
+void CorePool::run()
+{
+	threads_.join_all();
+}
+
+void CorePool::fini()
+{
+	LOG4CXX_INFO(logger, "CorePool::fini - " << cores_);
+
+	for (size_t i = 0; i < shards_.size(); ++ i)
+		shards_[i]->fini();
+}
+
+CoreShard* CorePool::current()
+{
+	return s_current_shard;
+}
+
+void CorePool::post(size_t to, const Task& task)
+{
+	if (to >= shards_.size())
+		return;
+
+	CoreShard* from = current();
+	if (from && &from->pool() == this)
+	{
+		if (from->index() == to)
+		{
+			task();
+			return;
+		}
+
+		if (shards_[to]->push(from->index(), task))
+			return;
+	}
+
+	shards_[to]->post(task);
+}
+
+size_t CorePool::sessionCount()
+{
+	size_t count = 0;
+	for (size_t i = 0; i < shards_.size(); ++ i)
+		count += shards_[i]->size();
+	return count;
+}
+
+NAMESPACE_NETASIO_END
@@ -0,0 +1,218 @@
+#ifndef _NET_ASIO_CORE_POOL_H
+#define _NET_ASIO_CORE_POOL_H
+
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include "net.h"
+#include "session.h"
+#include "connection_manager.h"
+#include "message_dispatcher.h"
+
+NAMESPACE_NETASIO_BEGIN
+
+class CorePool;
+
+/////////////////////////////////////////////////////////////////////
+//
+// 核分片(thread-per-core):
+//   1> 独占一个线程和一个io_service
+//   2> 持有自己的监听socket(SO_REUSEPORT)，由内核在分片间分配新连接
+//   3> 连接的读写和消息处理都在本分片线程上执行，不经过WorkerPool
+//   4> 其他分片投递过来的任务通过SPSC队列接收(每个来源分片一个队列)
+//
+/////////////////////////////////////////////////////////////////////
+class CoreShard : public ConnectionManager
+{
+public:
+	typedef boost::function<void()> Task;
+
+	CoreShard(CorePool& pool, size_t index, size_t cores,
+		ProtobufMsgDispatcher& msgdispatcher);
+
+	~CoreShard();
+
+	/// 绑定端口(SO_REUSEPORT)、开始监听
+	bool listen(const boost::asio::ip::tcp::endpoint& endpoint);
+
+	/// 关闭监听和所有连接: 投递到分片线程上执行，等待完成
+	void close();
+
+	/// 投递关闭到分片线程，返回完成的future(分片线程已退出时直接关闭)
+	boost::shared_future<void> close_async();
+
+	/// 分片线程入口
+	void run(bool pin);
+
+	/// 停止io_service
+	void fini();
+
+	/// 由分片from投递任务到本分片，from无效返回false
+	/// 队列满时经io_service投递，这些任务执行完之前from的后续任务也走io_service，保持投递顺序
+	bool push(size_t from, const Task& task);
+
+	/// 由非分片线程投递任务到本分片
+	void post(const Task& task) { io_service_.post(task); }
+
+	boost::asio::io_service& get_io_service() { return io_service_; }
+	CorePool& pool() { return pool_; }
+	size_t index() const { return index_; }
+
+protected:
+	/// Initiate an asynchronous accept operation.
+	void start_accept();
+
+	/// Handle completion of an asynchronous accept operation.
+	void handle_accept(const boost::system::error_code& e);
+
+	/// 在本线程上直接分发消息
+	void handle_message(ConnectionPtr, const char*, size_t);
+
+	/// Handle R/W error
+	void handle_error(ConnectionPtr);
+
+	/// 执行SPSC队列中的所有任务
+	void drain();
+
+	/// 执行队列满时经io_service投递的任务
+	void run_overflowed(size_t from, const Task& task);
+
+	/// 在分片线程上关闭监听和所有连接
+	void handle_close(boost::shared_ptr<boost::promise<void> > done);
+
+private:
+	typedef boost::lockfree::spsc_queue<Task> TaskQueue;
+	typedef boost::shared_ptr<TaskQueue> TaskQueuePtr;
+
+	CorePool& pool_;
+	size_t index_;
+
+	boost::asio::io_service io_service_;
+	boost::asio::io_service::work work_;
+
+	/// 每个来源分片一个SPSC队列
+	std::vector<TaskQueuePtr> inbox_;
+
+	/// 每个来源分片经io_service投递尚未执行的任务数
+	std::vector<boost::shared_ptr<boost::atomic<size_t> > > overflow_;
+
+	/// 是否已投递drain
+	boost::atomic<bool> notified_;
+
+	ProtobufMsgDispatcher& msgdispatcher_;
+
+	boost::asio::ip::tcp::acceptor acceptor_;
+	ConnectionPtr new_connection_;
+};
+
+typedef boost::shared_ptr<CoreShard> CoreShardPtr;
+
+/////////////////////////////////////////////////////////////////////
+//
+// 核分片池：NetApp的thread-per-core模式
+//
+/////////////////////////////////////////////////////////////////////
+class CorePool : private boost::noncopyable
+{
+public:
+	typedef CoreShard::Task Task;
+
+	CorePool(size_t cores, ProtobufMsgDispatcher& msgdispatcher, bool pin = false);
+
+	/// 创建分片并启动分片线程
+	bool init();
+
+	/// 每个分片各自监听同一个地址
+	bool listen(const std::string& address, const std::string& port);
+
+	/// 关闭所有分片的监听和连接(各自在分片线程上)，等待全部完成
+	void close();
+
+	/// Wait for all shard threads to exit.
+	void run();
+
+	/// Stop all shards.
+	void fini();
+
+	size_t size() const { return shards_.size(); }
+	CoreShard& shard(size_t index) { return *shards_[index]; }
+
+	/// 当前线程所在的分片(非分片线程返回NULL)
+	static CoreShard* current();
+
+	/// 投递任务到分片to: 分片线程之间走SPSC队列(同一来源按投递顺序执行)，其他线程走io_service
+	void post(size_t to, const Task& task);
+
+	/// 所有分片的连接总数
+	size_t sessionCount();
+
+	template <typename ProtoT>
+	void sendTo(uint32 id, const ProtoT& proto)
+	{
+		for (size_t i = 0; i < shards_.size(); ++ i)
+		{
+			ConnectionPtr conn = shards_[i]->get(id);
+			if (conn)
+			{
+				post(i, boost::bind(&CorePool::sendConn<ProtoT>, conn,
+					boost::make_shared<ProtoT>(proto)));
+				return;
+			}
+		}
+	}
+
+	template <typename ProtoT>
+	void broadcastTo(uint32 type, const ProtoT& proto)
+	{
+		boost::shared_ptr<ProtoT> msg = boost::make_shared<ProtoT>(proto);
+		for (size_t i = 0; i < shards_.size(); ++ i)
+			post(i, boost::bind(&CorePool::broadcastShard<ProtoT>,
+				shards_[i].get(), type, msg));
+	}
+
+	template <typename ProtoT>
+	void broadcastToAll(const ProtoT& proto)
+	{
+		boost::shared_ptr<ProtoT> msg = boost::make_shared<ProtoT>(proto);
+		for (size_t i = 0; i < shards_.size(); ++ i)
+			post(i, boost::bind(&CorePool::broadcastShardAll<ProtoT>,
+				shards_[i].get(), msg));
+	}
+
+private:
+	template <typename ProtoT>
+	static void sendConn(ConnectionPtr conn, boost::shared_ptr<ProtoT> msg)
+	{
+		conn->send(*msg);
+	}
+
+	template <typename ProtoT>
+	static void broadcastShard(CoreShard* shard, uint32 type, boost::shared_ptr<ProtoT> msg)
+	{
+		shard->broadcastTo(type, *msg);
+	}
+
+	template <typename ProtoT>
+	static void broadcastShardAll(CoreShard* shard, boost::shared_ptr<ProtoT> msg)
+	{
+		shard->broadcastToAll(*msg);
+	}
+
+	size_t cores_;
+	bool pin_;
+	ProtobufMsgDispatcher& msgdispatcher_;
+
+	std::vector<CoreShardPtr> shards_;
+	boost::thread_group threads_;
+};
+
+NAMESPACE_NETASIO_END
+
+#endif // _NET_ASIO_CORE_POOL_H
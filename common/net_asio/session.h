@@ -10,8 +10,6 @@
 
 NAMESPACE_NETASIO_BEGIN
 
-class SessionManager;
-
 /// Represents a single connection from a client.
 class Session : public Connection 
 {
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <chrono>
 #include <thread>
+#include "tinymetrics.h"
 
 ////////////////////////////////////////////////////////////////
 //
@@ -208,6 +209,7 @@ public:
         conns_max_ = maxconn;
         conns_in_use_ = 0;
         grab_waittime_ = -1;
+        setMetricsName("pool");
     }
 
     virtual ~ConnectionPoolWithLimit() {
@@ -245,6 +247,14 @@ public:
         grab_waittime_ = ms;
     }
 
+    //
+    // <name>.grab_wait_us / <name>.grab_failed
+    //
+    void setMetricsName(const std::string &name) {
+        grab_wait_ = &Metrics::histogram(name + ".grab_wait_us");
+        grab_failed_ = &Metrics::counter(name + ".grab_failed");
+    }
+
     //
     // create all the resource (using this at starting point)
     // once created, will not going to release it, you can aquire it
@@ -260,10 +270,13 @@ public:
 
 public:
     virtual Connection *grab() {
+        MetricsTimer timer(*grab_wait_);
+
         // no wait
         if (grab_waittime_ == 0) {
             if (conns_in_use_ >= conns_max_) {
                 std::cout << "grab failed: not engouh" << std::endl;
+                grab_failed_->inc();
                 return NULL;
             }
         }
@@ -282,8 +295,10 @@ public:
                 std::chrono::milliseconds ms(grab_waittime_);
                 std::this_thread::sleep_for(ms);
 
-                if (++tries > 1000)
+                if (++tries > 1000) {
+                    grab_failed_->inc();
                     return NULL;
+                }
             }
         }
 
@@ -316,6 +331,9 @@ protected:
     unsigned int conns_max_;
     int grab_waittime_;
     std::mutex mutex_;
+
+    HistogramMetric *grab_wait_;
+    CounterMetric *grab_failed_;
 };
 
 template<typename ConnType, typename PoolType>
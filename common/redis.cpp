@@ -81,11 +81,15 @@ void AsyncRedisClient::onConnected(bool success) {
         LOGGER_ERROR("redis", "redis://" << ip_ << ":" << port_
                                          << " async connected failed:" << context_->errstr);
         context_ = NULL;
+        // no disconnect callback after a failed connect, hiredis has dropped them
+        subscriptions_.clear();
     }
 }
 
 void AsyncRedisClient::onDisconnected(bool success) {
     context_ = NULL;
+    // hiredis is done with the callbacks
+    subscriptions_.clear();
     LOGGER_INFO("redis", "redis://" << ip_ << ":" << port_
                                     << " async disconnected");
 }
@@ -178,4 +182,68 @@ bool AsyncRedisClient::submitToServer(uint64_t taskid, const std::vector<std::st
     return true;
 }
 
-} // namespace tiny
\ No newline at end of file
+static void redisPushCallback(redisAsyncContext *ctx, void *r, void *privdata) {
+    AsyncRedisClient::PushCallback *callback = (AsyncRedisClient::PushCallback *) privdata;
+    if (!callback || !r)
+        return;
+
+    RedisReplyView reply((redisReply *) r);
+    (*callback)(reply);
+
+    // the last reply for this callback
+    if (reply[0].str() == "unsubscribe" || reply[0].str() == "punsubscribe") {
+        AsyncRedisClient *redis = (AsyncRedisClient *) ctx->data;
+        if (redis)
+            redis->releaseSubscription(callback);
+    }
+}
+
+bool AsyncRedisClient::subscribe(const std::vector<std::string> &cmd, const PushCallback &callback) {
+    if (cmd.empty() || !checkConnection())
+        return false;
+
+    std::vector<const char *> argv;
+    std::vector<size_t> argvlen;
+    for (auto &s : cmd) {
+        argv.push_back(s.c_str());
+        argvlen.push_back(s.size());
+    }
+
+    auto holder = std::make_shared<PushCallback>(callback);
+    if (redisAsyncCommandArgv(context_, redisPushCallback, holder.get(), argv.size(),
+                              &argv[0], &argvlen[0]) != REDIS_OK) {
+        LOGGER_ERROR("redis", "Could not send \"" << vecToStr(cmd) << "\": " << context_->errstr);
+        return false;
+    }
+
+    subscriptions_.push_back(holder);
+    return true;
+}
+
+bool AsyncRedisClient::unsubscribe(const std::vector<std::string> &cmd) {
+    if (cmd.empty() || !isConnected())
+        return false;
+
+    std::vector<const char *> argv;
+    std::vector<size_t> argvlen;
+    for (auto &s : cmd) {
+        argv.push_back(s.c_str());
+        argvlen.push_back(s.size());
+    }
+
+    // no callback of its own
+    if (redisAsyncCommandArgv(context_, NULL, NULL, argv.size(), &argv[0], &argvlen[0]) != REDIS_OK) {
+        LOGGER_ERROR("redis", "Could not send \"" << vecToStr(cmd) << "\": " << context_->errstr);
+        return false;
+    }
+
+    return true;
+}
+
+void AsyncRedisClient::releaseSubscription(PushCallback *callback) {
+    subscriptions_.remove_if([callback](const std::shared_ptr<PushCallback> &holder) {
+        return holder.get() == callback;
+    });
+}
+
+} // namespace tiny
@@ -62,6 +62,59 @@ public:
         emit(task);
     }
 
+    //
+    // SUBSCRIBE/PSUBSCRIBE one channel/pattern: callback gets every reply
+    // pushed for it, the confirmation and then the messages, until it's
+    // unsubscribed or the connection is closed.
+    //
+    typedef std::function<void(const RedisReplyView &)> PushCallback;
+
+    bool subscribe(const std::vector<std::string> &cmd, const PushCallback &callback);
+
+    // UNSUBSCRIBE/PUNSUBSCRIBE, its reply goes to the subscribe callback
+    bool unsubscribe(const std::vector<std::string> &cmd);
+
+    // hiredis has dropped it, unsubscribed
+    void releaseSubscription(PushCallback *callback);
+
+    //
+    // Lua script: SCRIPT LOAD on the first call, EVALSHA after that, and
+    // loaded again when the server answers NOSCRIPT.
+    //
+    template<class ReplyT>
+    void evalsha(const RedisScriptPtr &script,
+                 const std::vector<std::string> &keys,
+                 const std::vector<std::string> &args = {},
+                 const std::function<void(RedisCommand<ReplyT> &)> &callback = nullptr) {
+        if (!script)
+            return;
+
+        if (!script->loaded()) {
+            loadAndEval<ReplyT>(script, keys, args, callback);
+            return;
+        }
+
+        cmd<ReplyT>(script->evalshaArgs(keys, args),
+                    [this, script, keys, args, callback](RedisCommand<ReplyT> &c) {
+                        if (c.status() == RedisCmdStatus::error && RedisScript::isNoScript(c.lastError())) {
+                            loadAndEval<ReplyT>(script, keys, args, callback);
+                            return;
+                        }
+
+                        if (callback)
+                            callback(c);
+                    });
+    }
+
+    void scriptLoad(const RedisScriptPtr &script, const std::function<void(bool)> &callback = nullptr) {
+        cmd<std::string>(script->loadArgs(), [script, callback](RedisCommand<std::string> &c) {
+            if (c.ok())
+                script->setSha1(c.reply());
+            if (callback)
+                callback(c.ok());
+        });
+    }
+
 public:
     //
     // Connection Related.
@@ -75,9 +128,26 @@ public:
     bool submitToServer(uint64_t taskid, const std::vector<std::string> &cmd);
 
 private:
+    // EVAL if the script can't be loaded, the callback gets its error
+    template<class ReplyT>
+    void loadAndEval(const RedisScriptPtr &script,
+                     const std::vector<std::string> &keys,
+                     const std::vector<std::string> &args,
+                     const std::function<void(RedisCommand<ReplyT> &)> &callback) {
+        scriptLoad(script, [this, script, keys, args, callback](bool loaded) {
+            if (loaded)
+                cmd<ReplyT>(script->evalshaArgs(keys, args), callback);
+            else
+                cmd<ReplyT>(script->evalArgs(keys, args), callback);
+        });
+    }
+
     // Redis Async Context
     redisAsyncContext *context_ = nullptr;
 
+    // Callbacks of subscriptions, privdata of hiredis
+    std::list<std::shared_ptr<PushCallback>> subscriptions_;
+
     // Event Loop (libev)
     EventLoop *evloop_ = nullptr;
 
@@ -85,6 +85,7 @@ void RedisCommand<ReplyT>::processReply(redisReply *r) {
     }
 
     invoke();
+    releaseView(reply_val_);
 }
 
 
@@ -195,6 +196,13 @@ void RedisCommand<redisReply *>::parseReplyObject() {
     reply_val_ = reply_obj_;
 }
 
+template<>
+void RedisCommand<RedisReplyView>::parseReplyObject() {
+    if (!checkErrorReply())
+        reply_status_ = RedisCmdStatus::okay;
+    reply_val_ = RedisReplyView(reply_obj_);
+}
+
 template<>
 void RedisCommand<std::string>::parseReplyObject() {
     if (!isExpectedReply(REDIS_REPLY_STRING, REDIS_REPLY_STATUS))
@@ -299,6 +307,9 @@ void RedisCommand<std::set<std::string>>::parseReplyObject() {
 template
 class RedisCommand<redisReply *>;
 
+template
+class RedisCommand<RedisReplyView>;
+
 template
 class RedisCommand<std::string>;
 
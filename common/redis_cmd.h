@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <list>
 #include <set>
 #include <mutex>
 #include <condition_variable>
@@ -33,6 +34,8 @@
 #include <hiredis/async.h>
 #include "async.h"
 #include "eventloop.h"
+#include "redis_reply_view.h"
+#include "redis_script.h"
 
 namespace tiny {
 
@@ -68,6 +71,7 @@ enum RedisCmdStatus : int {
 //  - StringVector/std::vector<std::string>
 //  - StringSet/std::set<std::string>
 //  - StringHashSet/std::unordered_set<std::string>
+//  - RedisReplyView : no copy, only valid within the callback
 //
 template<typename ReplyT>
 class RedisCommand : public AsyncTask {
@@ -128,6 +132,12 @@ protected:
             callback_(*this);
     }
 
+    // Views die with the redisReply after the callback
+    static void releaseView(RedisReplyView &view) { view = RedisReplyView(); }
+
+    template<typename T>
+    static void releaseView(T &) {}
+
     bool checkErrorReply();
 
     bool checkNilReply();
@@ -293,6 +303,32 @@ HMGET(const std::string &key,
     });
 }
 
+//
+// HGETALL: fields and values as views into the reply
+//
+inline AsyncTaskPtr
+HGETALL(const std::string &key,
+        const RedisReplyView::PairCallback &callback) {
+
+    return RedisCmd<RedisReplyView>({"HGETALL", key}, [callback](RedisCommand<RedisReplyView> &c) {
+        if (c.ok() && callback)
+            c.reply().forEachPair(callback);
+    });
+}
+
+//
+// SMEMBERS: members as views into the reply
+//
+inline AsyncTaskPtr
+SMEMBERS(const std::string &key,
+         const RedisReplyView::ElementCallback &callback) {
+
+    return RedisCmd<RedisReplyView>({"SMEMBERS", key}, [callback](RedisCommand<RedisReplyView> &c) {
+        if (c.ok() && callback)
+            c.reply().forEach(callback);
+    });
+}
+
 //
 // LPUSH
 //
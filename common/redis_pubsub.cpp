@@ -0,0 +1,149 @@
+#include "redis_pubsub.h"
+#include "tinylogger.h"
+
+namespace tiny {
+
+// ARGV: channel, payload, channel, payload ... -> receivers
+static RedisScriptPtr s_publish = RedisScripts::instance().add("pubsub.publish",
+        "local n = 0 "
+        "for i = 1, #ARGV, 2 do n = n + redis.call('PUBLISH', ARGV[i], ARGV[i + 1]) end "
+        "return n");
+
+// messages in one EVALSHA at most
+static const size_t kMaxBatch = 512;
+
+RedisPubSub::RedisPubSub(const std::string &url, EventLoop *loop)
+        : subscriber_(url, loop), publisher_(url, loop) {
+    if (loop) {
+        loop->onTimer(std::bind(&RedisPubSub::tick, this), 0.001);
+        loop->onTimer(std::bind(&RedisPubSub::check, this), 1.0);
+    }
+}
+
+void RedisPubSub::unsubscribe(SubscriptionID id) {
+    auto it = ids_.find(id);
+    if (it == ids_.end())
+        return;
+
+    auto channel = channels_.find(it->second);
+    if (channel != channels_.end()) {
+        for (auto &group : channel->second.groups)
+            group.second->remove(id);
+    }
+
+    ids_.erase(it);
+    dirty_ = true;
+}
+
+void RedisPubSub::publish(const std::string &channel, const std::string &payload) {
+    outbox_.push_back(channel);
+    outbox_.push_back(payload);
+}
+
+void RedisPubSub::sendSubscribe(const ChannelKey &key) {
+    subscriber_.subscribe({key.first ? "PSUBSCRIBE" : "SUBSCRIBE", key.second},
+                          [this, key](const RedisReplyView &reply) {
+                              onMessage(key, reply);
+                          });
+}
+
+void RedisPubSub::onMessage(const ChannelKey &key, const RedisReplyView &reply) {
+    auto it = channels_.find(key);
+    if (it == channels_.end())
+        return;
+
+    Channel &channel = it->second;
+    RedisStringView type = reply[0].str();
+
+    if (type == "message" || type == "pmessage") {
+        // pmessage: pattern, channel, payload
+        const size_t at = (type == "pmessage" ? 2 : 1);
+        RedisStringView from = reply[at].str();
+        RedisStringView payload = reply[at + 1].str();
+
+        for (auto &group : channel.groups)
+            group.second->dispatch(from, payload);
+    } else if (type == "unsubscribe" || type == "punsubscribe") {
+        channel.unsubscribing = false;
+        if (channel.groups.empty())
+            channels_.erase(it);
+        else
+            sendSubscribe(key);
+    }
+}
+
+void RedisPubSub::tick() {
+    if (dirty_)
+        sweep();
+
+    if (!outbox_.empty())
+        flush();
+}
+
+void RedisPubSub::sweep() {
+    dirty_ = false;
+
+    for (auto &it : channels_) {
+        Channel &channel = it.second;
+        if (channel.groups.empty())
+            continue;
+
+        for (auto group = channel.groups.begin(); group != channel.groups.end();) {
+            if (group->second->sweep())
+                group = channel.groups.erase(group);
+            else
+                ++group;
+        }
+
+        // the last one gone, the channel is erased when redis confirms
+        if (channel.groups.empty() && !channel.unsubscribing) {
+            channel.unsubscribing = subscriber_.unsubscribe(
+                    {it.first.first ? "PUNSUBSCRIBE" : "UNSUBSCRIBE", it.first.second});
+        }
+    }
+}
+
+void RedisPubSub::flush() {
+    std::vector<std::string> messages;
+    messages.swap(outbox_);
+
+    for (size_t begin = 0; begin < messages.size(); begin += kMaxBatch * 2) {
+        const size_t end = std::min(messages.size(), begin + kMaxBatch * 2);
+        const size_t count = (end - begin) / 2;
+
+        auto done = [count](RedisCommand<long long int> &c) {
+            if (!c.ok())
+                LOGGER_WARN("redis", "pubsub: " << count << " messages lost: " << c.lastError());
+        };
+
+        if (count == 1) {
+            publisher_.cmd<long long int>({"PUBLISH", messages[begin], messages[begin + 1]}, done);
+        } else {
+            std::vector<std::string> args(std::make_move_iterator(messages.begin() + begin),
+                                          std::make_move_iterator(messages.begin() + end));
+            publisher_.evalsha<long long int>(s_publish, {}, args, done);
+        }
+    }
+}
+
+void RedisPubSub::check() {
+    if (subscriber_.isConnected() || channels_.empty())
+        return;
+
+    LOGGER_INFO("redis", "pubsub: subscribing " << channels_.size() << " channels again");
+
+    for (auto it = channels_.begin(); it != channels_.end();) {
+        Channel &channel = it->second;
+        channel.unsubscribing = false;
+
+        if (channel.groups.empty()) {
+            it = channels_.erase(it);
+            continue;
+        }
+
+        sendSubscribe(it->first);
+        ++it;
+    }
+}
+
+} // namespace tiny
@@ -0,0 +1,209 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_REDIS_PUBSUB_H
+#define TINYWORLD_REDIS_PUBSUB_H
+
+#include <map>
+#include <list>
+#include <memory>
+#include <typeindex>
+
+#include "redis.h"
+
+namespace tiny {
+
+//
+// Pub/Sub bus between servers, on the EventLoop:
+//
+//   RedisPubSub bus("redis://127.0.0.1:6379");
+//
+//   bus.subscribe<Chat>("world.chat", [](const Chat &chat) {...});
+//   bus.psubscribe("guild.*", [](const RedisStringView &channel, const RedisStringView &payload) {...});
+//
+//   bus.publish("world.chat", chat);
+//
+// A message is decoded once for each message type subscribed to its
+// channel, and every handler of that type gets the same object; raw
+// handlers get views of the reply, nothing is copied. The messages
+// published in a tick (1ms) go in one EVALSHA. The subscriber connection
+// is checked every second, reconnected and subscribed again if lost,
+// messages published meanwhile are not received (at most once, as Redis).
+//
+// Loop thread only. Handlers may subscribe and unsubscribe, it takes effect
+// from the next message. Like AsyncRedisClient, it has to outlive the loop.
+//
+class RedisPubSub {
+public:
+    typedef uint64_t SubscriptionID;
+
+    typedef std::function<void(const RedisStringView &channel, const RedisStringView &payload)> RawHandler;
+
+    RedisPubSub(const std::string &url, EventLoop *loop = EventLoop::instance());
+
+    template<typename MsgT, template<typename> class SerializerT = ProtoSerializer>
+    SubscriptionID subscribe(const std::string &channel, const std::function<void(const MsgT &)> &handler) {
+        return add<TypedGroup<MsgT, SerializerT>>(channel, false, handler);
+    }
+
+    template<typename MsgT, template<typename> class SerializerT = ProtoSerializer>
+    SubscriptionID psubscribe(const std::string &pattern, const std::function<void(const MsgT &)> &handler) {
+        return add<TypedGroup<MsgT, SerializerT>>(pattern, true, handler);
+    }
+
+    SubscriptionID subscribe(const std::string &channel, const RawHandler &handler) {
+        return add<RawGroup>(channel, false, handler);
+    }
+
+    SubscriptionID psubscribe(const std::string &pattern, const RawHandler &handler) {
+        return add<RawGroup>(pattern, true, handler);
+    }
+
+    void unsubscribe(SubscriptionID id);
+
+    template<typename MsgT, template<typename> class SerializerT = ProtoSerializer>
+    void publish(const std::string &channel, const MsgT &msg) {
+        publish(channel, serialize<SerializerT>(msg));
+    }
+
+    // queued until the end of the tick
+    void publish(const std::string &channel, const std::string &payload);
+
+    // not a message to serialize
+    void publish(const std::string &channel, const char *payload) {
+        publish(channel, std::string(payload));
+    }
+
+    size_t channels() const { return channels_.size(); }
+
+private:
+    //
+    // Handlers of a channel by message type
+    //
+    struct Group {
+        virtual ~Group() {}
+
+        virtual void dispatch(const RedisStringView &channel, const RedisStringView &payload) = 0;
+
+        // removed handlers are only marked while dispatching
+        virtual void remove(SubscriptionID id) = 0;
+
+        virtual bool sweep() = 0;
+    };
+
+    template<typename HandlerT>
+    struct Handlers : public Group {
+        void remove(SubscriptionID id) override {
+            for (auto &handler : handlers)
+                if (handler.first == id)
+                    handler.second = nullptr;
+        }
+
+        // true if empty
+        bool sweep() override {
+            handlers.remove_if([](const std::pair<SubscriptionID, HandlerT> &handler) {
+                return !handler.second;
+            });
+            return handlers.empty();
+        }
+
+        std::list<std::pair<SubscriptionID, HandlerT>> handlers;
+    };
+
+    template<typename MsgT, template<typename> class SerializerT>
+    struct TypedGroup : public Handlers<std::function<void(const MsgT &)>> {
+        void dispatch(const RedisStringView &channel, const RedisStringView &payload) override {
+            MsgT msg;
+            if (!deserializeFrom<SerializerT>(msg, payload.data, payload.size))
+                return;
+
+            for (auto &handler : this->handlers)
+                if (handler.second)
+                    handler.second(msg);
+        }
+    };
+
+    struct RawGroup : public Handlers<RawHandler> {
+        void dispatch(const RedisStringView &channel, const RedisStringView &payload) override {
+            for (auto &handler : handlers)
+                if (handler.second)
+                    handler.second(channel, payload);
+        }
+    };
+
+    struct Channel {
+        bool unsubscribing = false;     // subscribed again when it's done, if needed
+        std::map<std::type_index, std::unique_ptr<Group>> groups;
+    };
+
+    // (pattern, name): a pattern and a channel of the same name are two subscriptions, as in Redis
+    typedef std::pair<bool, std::string> ChannelKey;
+
+    template<typename GroupT, typename HandlerT>
+    SubscriptionID add(const std::string &name, bool pattern, const HandlerT &handler) {
+        if (!handler)
+            return 0;
+
+        const ChannelKey key(pattern, name);
+        bool subscribed = channels_.count(key) != 0;
+        Channel &channel = channels_[key];
+
+        std::unique_ptr<Group> &group = channel.groups[std::type_index(typeid(GroupT))];
+        if (!group)
+            group.reset(new GroupT);
+
+        SubscriptionID id = ++lastid_;
+        static_cast<GroupT *>(group.get())->handlers.emplace_back(id, handler);
+        ids_[id] = key;
+
+        if (!subscribed)
+            sendSubscribe(key);
+        return id;
+    }
+
+    void sendSubscribe(const ChannelKey &key);
+
+    void onMessage(const ChannelKey &key, const RedisReplyView &reply);
+
+    // the end of a tick: removed handlers, then the queued messages
+    void tick();
+
+    void sweep();
+
+    void flush();
+
+    // subscribe all again if the subscriber was lost
+    void check();
+
+    AsyncRedisClient subscriber_;
+    AsyncRedisClient publisher_;
+
+    std::map<ChannelKey, Channel> channels_;
+    std::map<SubscriptionID, ChannelKey> ids_;
+    SubscriptionID lastid_ = 0;
+    bool dirty_ = false;
+
+    // channel, payload, channel, payload ...
+    std::vector<std::string> outbox_;
+};
+
+} // namespace tiny
+
+#endif //TINYWORLD_REDIS_PUBSUB_H
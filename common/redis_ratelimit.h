@@ -0,0 +1,242 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_REDIS_RATELIMIT_H
+#define TINYWORLD_REDIS_RATELIMIT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <unordered_map>
+#include <unistd.h>
+
+#include "redis_script.h"
+
+//
+// Rate limits and counters shared by servers through Redis, each check is
+// one script run atomically on the server:
+//
+//   - TokenBucket   : bursts up to capacity, refilled by rate per second
+//   - SlidingWindow : at most limit hits in the last window (a sorted set
+//                     of the hits, exact)
+//   - count()       : hits of a fixed window, INCRBY + PEXPIRE
+//
+// A token bucket with batch > 1 takes that many tokens from Redis at once
+// and spends them locally until they run out or the lease expires, so most
+// checks never leave the process. The tokens are taken off the shared bucket
+// when reserved, the limit holds across servers; unused ones are lost when
+// the lease expires. A key Redis refused is refused locally for a while too.
+//
+// Both clients, with the same rules:
+//
+//   static TokenBucket login(5, 1, 1);            // 5 burst, 1/s
+//
+//   RedisRateLimiter limiter(pool);                // myredis_ratelimit.h
+//   if (!limiter.acquire("login:ip:" + ip, login)) reject();
+//
+//   tiny::AsyncRedisRateLimiter limiter(&redis);  // redis_ratelimit_async.h
+//   limiter.acquire("login:ip:" + ip, login, [](bool ok) {...});
+//
+// The time is the client's, servers sharing a key are expected to agree on
+// it (NTP).
+//
+
+struct TokenBucket {
+    TokenBucket(uint32_t capacity_, double rate_, uint32_t batch_ = 1, uint32_t lease_ms_ = 1000)
+            : capacity(capacity_), rate(rate_), batch(batch_ ? batch_ : 1), lease_ms(lease_ms_) {}
+
+    uint32_t capacity;
+    double rate;        // tokens per second, <= 0 never refilled
+    uint32_t batch;     // tokens reserved at once, 1 to ask Redis every time
+    uint32_t lease_ms;  // reserved tokens expire after
+};
+
+struct SlidingWindow {
+    SlidingWindow(uint32_t limit_, uint32_t window_ms_) : limit(limit_), window_ms(window_ms_) {}
+
+    uint32_t limit;
+    uint32_t window_ms;
+};
+
+struct RedisRateLimit {
+    // KEYS: bucket, ARGV: capacity, rate, now(ms), wanted -> tokens granted
+    // rate <= 0: capacity tokens in all, never refilled and the key kept
+    static RedisScriptPtr tokenBucket() {
+        static RedisScriptPtr script = RedisScripts::instance().add("ratelimit.bucket",
+                "local capacity = tonumber(ARGV[1]) "
+                "local rate = tonumber(ARGV[2]) "
+                "local now = tonumber(ARGV[3]) "
+                "local b = redis.call('HMGET', KEYS[1], 'tokens', 'ts') "
+                "local tokens = tonumber(b[1]) or capacity "
+                "local ts = tonumber(b[2]) or now "
+                "if now > ts then "
+                "if rate > 0 then tokens = math.min(capacity, tokens + (now - ts) * rate / 1000) end "
+                "ts = now end "
+                "local granted = math.min(tonumber(ARGV[4]), math.floor(tokens)) "
+                "redis.call('HMSET', KEYS[1], 'tokens', tostring(tokens - granted), 'ts', ts) "
+                "if rate > 0 then redis.call('PEXPIRE', KEYS[1], math.ceil(capacity * 1000 / rate) + 1000) end "
+                "return granted");
+        return script;
+    }
+
+    // KEYS: log, ARGV: limit, window(ms), now(ms), member -> 1 if allowed
+    static RedisScriptPtr slidingWindow() {
+        static RedisScriptPtr script = RedisScripts::instance().add("ratelimit.window",
+                "local now = tonumber(ARGV[3]) "
+                "redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', now - tonumber(ARGV[2])) "
+                "if redis.call('ZCARD', KEYS[1]) >= tonumber(ARGV[1]) then return 0 end "
+                "redis.call('ZADD', KEYS[1], now, ARGV[4]) "
+                "redis.call('PEXPIRE', KEYS[1], ARGV[2]) "
+                "return 1");
+        return script;
+    }
+
+    // KEYS: counter, ARGV: n, window(ms) -> count of the window
+    static RedisScriptPtr counter() {
+        static RedisScriptPtr script = RedisScripts::instance().add("ratelimit.count",
+                "local n = redis.call('INCRBY', KEYS[1], ARGV[1]) "
+                "if n == tonumber(ARGV[1]) then redis.call('PEXPIRE', KEYS[1], ARGV[2]) end "
+                "return n");
+        return script;
+    }
+
+    static std::vector<std::string> bucketArgs(const TokenBucket &bucket, uint32_t wanted, int64_t now) {
+        return {std::to_string(bucket.capacity), std::to_string(bucket.rate),
+                std::to_string(now), std::to_string(wanted)};
+    }
+
+    // random per process, pids repeat across hosts
+    static const std::string &nonce() {
+        static const std::string value = []() {
+            std::random_device rd;
+            char buf[20];
+            snprintf(buf, sizeof(buf), "%08x%08x", (unsigned) rd(), (unsigned) rd());
+            return std::string(buf);
+        }();
+        return value;
+    }
+
+    // the member is unique per hit, hits of the same ms are all logged
+    static std::vector<std::string> windowArgs(const SlidingWindow &window, int64_t now) {
+        static std::atomic<uint64_t> seq(0);
+        return {std::to_string(window.limit), std::to_string(window.window_ms), std::to_string(now),
+                std::to_string(now) + "-" + nonce() + "-" + std::to_string(::getpid()) + "-" + std::to_string(seq++)};
+    }
+
+    static std::vector<std::string> counterArgs(int64_t n, uint32_t window_ms) {
+        return {std::to_string(n), std::to_string(window_ms)};
+    }
+
+    // wall clock, ms
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // refused keys wait for about one token, within the lease
+    static int64_t denyFor(const TokenBucket &bucket) {
+        int64_t ms = bucket.rate > 0 ? static_cast<int64_t>(1000 / bucket.rate) : bucket.lease_ms;
+        return ms < bucket.lease_ms ? ms : bucket.lease_ms;
+    }
+};
+
+//
+// Tokens reserved from Redis, by key
+//
+class RedisTokenCache {
+public:
+    enum Result {
+        kMiss,      // ask Redis
+        kGranted,
+        kDenied,    // refused lately, don't ask again yet
+    };
+
+    RedisTokenCache(size_t maxkeys = 10000) : maxkeys_(maxkeys) {}
+
+    Result take(const std::string &key, int64_t now) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+            return kMiss;
+
+        Entry &entry = it->second;
+        if (now >= entry.expires) {
+            entries_.erase(it);
+            return kMiss;
+        }
+
+        if (entry.denied)
+            return kDenied;
+
+        // the last one, ask Redis next time
+        if (--entry.tokens == 0)
+            entries_.erase(it);
+        return kGranted;
+    }
+
+    // tokens left of a reservation, or none to refuse the key until expires
+    void put(const std::string &key, uint32_t tokens, int64_t expires, int64_t now) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (entries_.size() >= maxkeys_ && !entries_.count(key))
+            sweep(now);
+
+        Entry &entry = entries_[key];
+        entry.tokens = tokens;
+        entry.denied = (tokens == 0);
+        entry.expires = expires;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return entries_.size();
+    }
+
+private:
+    // the expired ones, all if none
+    void sweep(int64_t now) {
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (now >= it->second.expires)
+                it = entries_.erase(it);
+            else
+                ++it;
+        }
+
+        if (entries_.size() >= maxkeys_)
+            entries_.clear();
+    }
+
+    struct Entry {
+        uint32_t tokens = 0;
+        bool denied = false;
+        int64_t expires = 0;
+    };
+
+    const size_t maxkeys_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+#endif //TINYWORLD_REDIS_RATELIMIT_H
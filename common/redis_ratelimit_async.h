@@ -0,0 +1,105 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_REDIS_RATELIMIT_ASYNC_H
+#define TINYWORLD_REDIS_RATELIMIT_ASYNC_H
+
+#include "redis.h"
+#include "redis_ratelimit.h"
+
+namespace tiny {
+
+//
+// Rate limits over the async client, see redis_ratelimit.h. A check served
+// by the local tokens calls back at once, in the caller. Checks are let
+// through when Redis fails, like the sync RedisRateLimiter.
+//
+class AsyncRedisRateLimiter {
+public:
+    typedef std::function<void(bool)> Callback;
+    typedef std::function<void(long long)> CountCallback;
+
+    AsyncRedisRateLimiter(AsyncRedisClient *redis, size_t maxkeys = 10000)
+            : redis_(redis), tokens_(maxkeys) {}
+
+    // one token of the bucket
+    void acquire(const std::string &key, const TokenBucket &bucket, const Callback &callback) {
+        const int64_t now = RedisRateLimit::now();
+        switch (tokens_.take(key, now)) {
+            case RedisTokenCache::kGranted:
+                callback(true);
+                return;
+            case RedisTokenCache::kDenied:
+                callback(false);
+                return;
+            default:
+                break;
+        }
+
+        const uint32_t lease_ms = bucket.lease_ms;
+        const int64_t deny_ms = RedisRateLimit::denyFor(bucket);
+        redis_->evalsha<long long int>(
+                RedisRateLimit::tokenBucket(), {key}, RedisRateLimit::bucketArgs(bucket, bucket.batch, now),
+                [this, key, now, lease_ms, deny_ms, callback](RedisCommand<long long int> &c) {
+                    if (!c.ok()) {
+                        callback(true);
+                        return;
+                    }
+
+                    long long granted = c.reply();
+                    if (granted <= 0) {
+                        tokens_.put(key, 0, now + deny_ms, now);
+                        callback(false);
+                        return;
+                    }
+
+                    if (granted > 1)
+                        tokens_.put(key, granted - 1, now + lease_ms, now);
+                    callback(true);
+                });
+    }
+
+    // one hit of the window
+    void hit(const std::string &key, const SlidingWindow &window, const Callback &callback) {
+        redis_->evalsha<long long int>(
+                RedisRateLimit::slidingWindow(), {key}, RedisRateLimit::windowArgs(window, RedisRateLimit::now()),
+                [callback](RedisCommand<long long int> &c) {
+                    callback(!c.ok() || c.reply() != 0);
+                });
+    }
+
+    // count of the fixed window after adding n, -1 if failed
+    void count(const std::string &key, uint32_t window_ms, long long n, const CountCallback &callback = nullptr) {
+        redis_->evalsha<long long int>(
+                RedisRateLimit::counter(), {key}, RedisRateLimit::counterArgs(n, window_ms),
+                [callback](RedisCommand<long long int> &c) {
+                    if (callback)
+                        callback(c.ok() ? c.reply() : -1);
+                });
+    }
+
+private:
+    AsyncRedisClient *redis_;
+    RedisTokenCache tokens_;
+};
+
+} // namespace tiny
+
+#endif //TINYWORLD_REDIS_RATELIMIT_ASYNC_H
@@ -0,0 +1,147 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_REDIS_REPLY_VIEW_H
+#define TINYWORLD_REDIS_REPLY_VIEW_H
+
+#include <cstring>
+#include <string>
+#include <functional>
+#include <hiredis/hiredis.h>
+
+#include "tinyserializer.h"
+#include "tinyserializer_proto.h"
+
+//
+// Read-only views of a hiredis reply, nothing is copied.
+//
+// A view points into the redisReply and is only valid while the reply is
+// alive, that is during the callback it's handed to. Copy out (str()) or
+// decode what you need to keep:
+//
+//   redis_cli.cmd<RedisReplyView>({"HGETALL", key}, [](RedisCommand<RedisReplyView> &c) {
+//       c.reply().forEachPair([](const RedisStringView &field, const RedisStringView &value) {
+//           ...
+//       });
+//   });
+//
+//   // decode every element straight into one reused object
+//   PlayerProto player;
+//   c.reply().decodeEach(player, [&player]() { ... });
+//
+struct RedisStringView {
+    RedisStringView() {}
+
+    RedisStringView(const char *d, size_t n) : data(d), size(n) {}
+
+    std::string str() const { return data ? std::string(data, size) : std::string(); }
+
+    bool empty() const { return size == 0; }
+
+    bool operator==(const std::string &s) const {
+        return s.size() == size && (size == 0 || std::memcmp(s.data(), data, size) == 0);
+    }
+
+    bool operator!=(const std::string &s) const { return !(*this == s); }
+
+    bool equals(const char *s, size_t n) const {
+        return n == size && (size == 0 || std::memcmp(s, data, size) == 0);
+    }
+
+    // literals, without a temporary std::string
+    template<size_t N>
+    bool operator==(const char (&s)[N]) const { return equals(s, N - 1); }
+
+    template<size_t N>
+    bool operator!=(const char (&s)[N]) const { return !equals(s, N - 1); }
+
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+class RedisReplyView {
+public:
+    typedef std::function<void(const RedisReplyView &)> Callback;
+    typedef std::function<void(const RedisStringView &)> ElementCallback;
+    typedef std::function<void(const RedisStringView &, const RedisStringView &)> PairCallback;
+
+    RedisReplyView(redisReply *reply = nullptr) : reply_(reply) {}
+
+    bool valid() const { return reply_ != nullptr; }
+
+    int type() const { return reply_ ? reply_->type : REDIS_REPLY_NIL; }
+
+    bool isNil() const { return type() == REDIS_REPLY_NIL; }
+
+    bool isError() const { return type() == REDIS_REPLY_ERROR; }
+
+    bool isArray() const { return type() == REDIS_REPLY_ARRAY; }
+
+    long long integer() const { return reply_ ? reply_->integer : 0; }
+
+    // STRING/STATUS/ERROR
+    RedisStringView str() const {
+        if (!reply_ || !reply_->str) return RedisStringView();
+        return RedisStringView(reply_->str, reply_->len);
+    }
+
+    // ARRAY
+    size_t size() const { return isArray() ? reply_->elements : 0; }
+
+    RedisReplyView operator[](size_t i) const {
+        return i < size() ? RedisReplyView(reply_->element[i]) : RedisReplyView();
+    }
+
+    void forEach(const ElementCallback &cb) const {
+        for (size_t i = 0; i < size(); ++i)
+            cb((*this)[i].str());
+    }
+
+    // HGETALL/ZRANGE WITHSCORES: field, value, field, value ...
+    void forEachPair(const PairCallback &cb) const {
+        for (size_t i = 0; i + 1 < size(); i += 2)
+            cb((*this)[i].str(), (*this)[i + 1].str());
+    }
+
+    // decode the element by its serializer, without copying the bytes
+    template<template<typename> class SerializerT = ProtoSerializer, typename ValueT>
+    bool decode(size_t i, ValueT &value) const {
+        RedisStringView bin = (*this)[i].str();
+        return bin.data && deserializeFrom<SerializerT>(value, bin.data, bin.size);
+    }
+
+    // decode every element into the same object, cb() after each one
+    template<template<typename> class SerializerT = ProtoSerializer, typename ValueT>
+    size_t decodeEach(ValueT &value, const std::function<void()> &cb) const {
+        size_t count = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (decode<SerializerT>(i, value)) {
+                cb();
+                count++;
+            }
+        }
+        return count;
+    }
+
+private:
+    redisReply *reply_;
+};
+
+#endif //TINYWORLD_REDIS_REPLY_VIEW_H
@@ -0,0 +1,151 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_REDIS_SCRIPT_H
+#define TINYWORLD_REDIS_SCRIPT_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+//
+// Server-side Lua scripts, called by EVALSHA.
+//
+// Register a script once, then call it by either client. The sha1 comes
+// from SCRIPT LOAD on the first call, and the script is loaded again when
+// a server answers NOSCRIPT (restarted, SCRIPT FLUSH, another shard ...):
+//
+//   static RedisScriptPtr touch = RedisScripts::instance().add("touch",
+//           "redis.call('HSET', KEYS[1], 'touchtime', ARGV[1]) "
+//           "return redis.call('HGET', KEYS[1], 'value')");
+//
+//   // sync
+//   redis.evalsha(reply, *touch, {key}, {now});
+//
+//   // async
+//   redis_cli.evalsha<std::string>(touch, {key}, {now}, [](RedisCommand<std::string> &c) {...});
+//
+class RedisScript {
+public:
+    RedisScript(const std::string &name, const std::string &source)
+            : name_(name), source_(source) {}
+
+    const std::string &name() const { return name_; }
+
+    const std::string &source() const { return source_; }
+
+    // empty until loaded
+    std::string sha1() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return sha1_;
+    }
+
+    void setSha1(const std::string &sha1) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        sha1_ = sha1;
+    }
+
+    bool loaded() const { return !sha1().empty(); }
+
+    // EVALSHA sha1 numkeys key ... arg ...
+    std::vector<std::string> evalshaArgs(const std::vector<std::string> &keys,
+                                         const std::vector<std::string> &args) const {
+        std::vector<std::string> cmd;
+        cmd.reserve(3 + keys.size() + args.size());
+        cmd.push_back("EVALSHA");
+        cmd.push_back(sha1());
+        cmd.push_back(std::to_string(keys.size()));
+        cmd.insert(cmd.end(), keys.begin(), keys.end());
+        cmd.insert(cmd.end(), args.begin(), args.end());
+        return cmd;
+    }
+
+    // EVAL source numkeys key ... arg ...
+    std::vector<std::string> evalArgs(const std::vector<std::string> &keys,
+                                      const std::vector<std::string> &args) const {
+        std::vector<std::string> cmd;
+        cmd.reserve(3 + keys.size() + args.size());
+        cmd.push_back("EVAL");
+        cmd.push_back(source_);
+        cmd.push_back(std::to_string(keys.size()));
+        cmd.insert(cmd.end(), keys.begin(), keys.end());
+        cmd.insert(cmd.end(), args.begin(), args.end());
+        return cmd;
+    }
+
+    std::vector<std::string> loadArgs() const {
+        return {"SCRIPT", "LOAD", source_};
+    }
+
+    // the server doesn't know the sha1
+    static bool isNoScript(const char *error, size_t len) {
+        return error && len >= 8 && std::strncmp(error, "NOSCRIPT", 8) == 0;
+    }
+
+    static bool isNoScript(const std::string &error) {
+        return isNoScript(error.data(), error.size());
+    }
+
+private:
+    const std::string name_;
+    const std::string source_;
+
+    mutable std::mutex mutex_;
+    std::string sha1_;
+};
+
+typedef std::shared_ptr<RedisScript> RedisScriptPtr;
+
+//
+// Scripts by name
+//
+class RedisScripts {
+public:
+    static RedisScripts &instance() {
+        static RedisScripts scripts;
+        return scripts;
+    }
+
+    // the same name is registered only once
+    RedisScriptPtr add(const std::string &name, const std::string &source) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        RedisScriptPtr &script = scripts_[name];
+        if (!script)
+            script = std::make_shared<RedisScript>(name, source);
+        return script;
+    }
+
+    RedisScriptPtr get(const std::string &name) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = scripts_.find(name);
+        if (it != scripts_.end())
+            return it->second;
+        return nullptr;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, RedisScriptPtr> scripts_;
+};
+
+#endif //TINYWORLD_REDIS_SCRIPT_H
@@ -28,6 +28,19 @@
 //       LOGGER_ERROR(logger-name, a << b << ...)
 //       LOGGER_FATAL(logger-name, a << b << ...)
 //
+//  - Deferred formatting, "{}" for each argument:
+//       LOGB_TRACE(logger-name, fmt, a, b, ...)
+//       LOGB_DEBUG(logger-name, fmt, a, b, ...)
+//       ...
+//       LOGB_FATAL(logger-name, fmt, a, b, ...)
+//
+//  - Simple logger in async mode(file, rotate at 64M or daily):
+//       SimpleLogger::instance().set_level(SIMPLE_LOGGER_INFO);
+//       SimpleLogger::instance().start_async("server.log", 64 << 20, 86400);
+//
+//  - Simple logger in binary mode(decode with tools/tinylogdump):
+//       SimpleLogger::instance().start_async("server.blog", 64 << 20, 86400, true);
+//
 /////////////////////////////////////////////////////////
 
 
@@ -37,6 +50,263 @@
 #define     TINYLOGGER_SIMPLE
 #endif
 
+//////////////////////////////////////////////////////////
+//
+// Deferred formatting(LOGB_*):
+//
+//   LOGB_DEBUG("TinyTable", "GET:{}:{}", name, request);
+//
+//   "{}" is replaced by the next argument. In binary mode only the
+//   raw arguments are copied into the log, protobuf messages as
+//   serialized bytes, and tools/tinylogdump renders the text offline.
+//
+//   binary record(native byte order): [uint32 size][uint8 kind]...
+//      str = [uint32 length][bytes]
+//
+/////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#define TINYLOG_RECORD_HEAD     'H'   // [int64 time us] : new file/process, site ids restart
+#define TINYLOG_RECORD_SITE     'S'   // [uint32 id][uint8 level][str name][str fmt][str file][uint32 line]
+#define TINYLOG_RECORD_EVENT    'E'   // [uint32 id][int64 time us][args ...]
+#define TINYLOG_RECORD_TEXT     'T'   // [formatted line]
+
+#define TINYLOG_ARG_INT         'i'   // int64
+#define TINYLOG_ARG_UINT        'u'   // uint64
+#define TINYLOG_ARG_BOOL        'b'   // uint8
+#define TINYLOG_ARG_DOUBLE      'd'   // double
+#define TINYLOG_ARG_STRING      's'   // str
+#define TINYLOG_ARG_PROTO       'p'   // str typename, str serialized
+#define TINYLOG_ARG_TRUNCATED   'x'   // str typename, uint32 size : message too big for a record
+
+#define TINYLOG_RECORD_MAX      (LOG_LENGTH_MAX * 4)
+
+struct TinyLogEncoder
+{
+    TinyLogEncoder(char *buf, size_t cap) : data(buf), size(0), capacity(cap), overflow(false) {}
+
+    char *reserve(size_t n)
+    {
+        if (capacity - size < n)
+        {
+            overflow = true;
+            return NULL;
+        }
+        char *p = data + size;
+        size += n;
+        return p;
+    }
+
+    void put(const void *p, size_t n)
+    {
+        char *dst = reserve(n);
+        if (dst) std::memcpy(dst, p, n);
+    }
+
+    template <typename T>
+    void put_pod(T v) { put(&v, sizeof(v)); }
+
+    void put_str(const char *s, size_t n)
+    {
+        put_pod<uint32_t>(n);
+        put(s, n);
+    }
+
+    size_t left() const { return capacity - size; }
+
+    template <typename T>
+    static void append_pod(std::string &out, T v) { out.append((const char*)&v, sizeof(v)); }
+
+    static void append_str(std::string &out, const std::string &s)
+    {
+        append_pod<uint32_t>(out, s.size());
+        out += s;
+    }
+
+    char *data;
+    size_t size;
+    size_t capacity;
+    bool overflow;
+};
+
+struct TinyLogArgs
+{
+    struct IntArg {};
+    struct UIntArg {};
+    struct BoolArg {};
+    struct DoubleArg {};
+    struct StringArg {};
+    struct ProtoArg {};
+    struct OtherArg {};
+
+    template <typename T, typename = void>
+    struct IsProto : std::false_type {};
+
+    template <typename T>
+    struct IsProto<T, decltype(std::declval<const T&>().ByteSizeLong(),
+                               std::declval<const T&>().GetDescriptor(), void())> : std::true_type {};
+
+    template <typename T>
+    struct Category
+    {
+        typedef typename std::conditional<std::is_same<T, bool>::value, BoolArg,
+                typename std::conditional<std::is_enum<T>::value || (std::is_integral<T>::value && std::is_signed<T>::value), IntArg,
+                typename std::conditional<std::is_integral<T>::value, UIntArg,
+                typename std::conditional<std::is_floating_point<T>::value, DoubleArg,
+                typename std::conditional<std::is_same<T, std::string>::value || std::is_convertible<const T&, const char*>::value, StringArg,
+                typename std::conditional<IsProto<T>::value, ProtoArg, OtherArg
+                >::type>::type>::type>::type>::type>::type type;
+    };
+
+    //
+    // binary
+    //
+    static void encode(TinyLogEncoder &) {}
+
+    template <typename T, typename... Args>
+    static void encode(TinyLogEncoder &enc, const T &v, const Args&... args)
+    {
+        encode_one(enc, v, typename Category<T>::type());
+        encode(enc, args...);
+    }
+
+    //
+    // text
+    //
+    static void format(std::string &out, const char *fmt) { out += fmt; }
+
+    template <typename T, typename... Args>
+    static void format(std::string &out, const char *fmt, const T &v, const Args&... args)
+    {
+        const char *holder = std::strstr(fmt, "{}");
+        if (!holder)
+        {
+            out += fmt;
+            return;
+        }
+
+        out.append(fmt, holder - fmt);
+        text(out, v, typename Category<T>::type());
+        format(out, holder + 2, args...);
+    }
+
+private:
+    static const char* str_data(const std::string &s) { return s.data(); }
+    static size_t str_size(const std::string &s) { return s.size(); }
+    static const char* str_data(const char *s) { return s ? s : ""; }
+    static size_t str_size(const char *s) { return s ? std::strlen(s) : 0; }
+
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, IntArg)
+    {
+        enc.put_pod<uint8_t>(TINYLOG_ARG_INT);
+        enc.put_pod<int64_t>(static_cast<int64_t>(v));
+    }
+
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, UIntArg)
+    {
+        enc.put_pod<uint8_t>(TINYLOG_ARG_UINT);
+        enc.put_pod<uint64_t>(static_cast<uint64_t>(v));
+    }
+
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, BoolArg)
+    {
+        enc.put_pod<uint8_t>(TINYLOG_ARG_BOOL);
+        enc.put_pod<uint8_t>(v ? 1 : 0);
+    }
+
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, DoubleArg)
+    {
+        enc.put_pod<uint8_t>(TINYLOG_ARG_DOUBLE);
+        enc.put_pod<double>(static_cast<double>(v));
+    }
+
+    // long strings are truncated to what is left in the record
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, StringArg)
+    {
+        const char *s = str_data(v);
+        size_t n = str_size(v);
+        size_t head = sizeof(uint8_t) + sizeof(uint32_t);
+        if (enc.left() > head && n > enc.left() - head)
+            n = enc.left() - head;
+
+        enc.put_pod<uint8_t>(TINYLOG_ARG_STRING);
+        enc.put_str(s, n);
+    }
+
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, ProtoArg)
+    {
+        const std::string &name = v.GetDescriptor()->full_name();
+        size_t size = v.ByteSizeLong();
+
+        if (enc.left() < 1 + 4 + name.size() + 4 + size)
+        {
+            enc.put_pod<uint8_t>(TINYLOG_ARG_TRUNCATED);
+            enc.put_str(name.data(), name.size());
+            enc.put_pod<uint32_t>(size);
+            return;
+        }
+
+        enc.put_pod<uint8_t>(TINYLOG_ARG_PROTO);
+        enc.put_str(name.data(), name.size());
+        enc.put_pod<uint32_t>(size);
+        char *bytes = enc.reserve(size);
+        if (bytes)
+            v.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(bytes));
+    }
+
+    // no binary form, formatted now
+    template <typename T>
+    static void encode_one(TinyLogEncoder &enc, const T &v, OtherArg)
+    {
+        std::string s;
+        text(s, v, OtherArg());
+        encode_one(enc, s, StringArg());
+    }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, IntArg) { out += std::to_string(static_cast<long long>(v)); }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, UIntArg) { out += std::to_string(static_cast<unsigned long long>(v)); }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, BoolArg) { out += (v ? "true" : "false"); }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, DoubleArg)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+        out += buf;
+    }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, StringArg) { out.append(str_data(v), str_size(v)); }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, ProtoArg) { out += v.ShortDebugString(); }
+
+    template <typename T>
+    static void text(std::string &out, const T &v, OtherArg)
+    {
+        std::ostringstream oss;
+        oss << v;
+        out += oss.str();
+    }
+};
+
 //////////////////////////////////////////////////////////
 //
 // logger using std::cout/std::cerr
@@ -49,6 +319,15 @@
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
 
 #define SIMPLE_LOGGER_TRACE 1
 #define SIMPLE_LOGGER_DEBUG 2
@@ -57,66 +336,132 @@
 #define SIMPLE_LOGGER_ERROR 5
 #define SIMPLE_LOGGER_FATAL 6
 
+// per-thread ring buffer in async mode (power of 2)
+#define SIMPLE_LOGGER_RING_SIZE (1 << 20)
+
+//
+// level is checked before any formatting
+//
+#define SIMPLE_LOGGER_ENABLED(level) \
+        (SimpleLogger::instance().enabled(level))
+
 //
 // C printf style
 //
-#define LOG_TRACE(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_TRACE, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
+#define SIMPLE_LOG_PRINT(level, loggername, fmt, ...) { \
+        if (SIMPLE_LOGGER_ENABLED(level)) \
+            SimpleLogger::instance().print_log(level, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__); \
+    }
+
+#define LOG_TRACE(loggername, fmt, ...) SIMPLE_LOG_PRINT(SIMPLE_LOGGER_TRACE, loggername, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(loggername, fmt, ...) SIMPLE_LOG_PRINT(SIMPLE_LOGGER_DEBUG, loggername, fmt, ##__VA_ARGS__)
+#define LOG_INFO(loggername, fmt, ...)  SIMPLE_LOG_PRINT(SIMPLE_LOGGER_INFO,  loggername, fmt, ##__VA_ARGS__)
+#define LOG_WARN(loggername, fmt, ...)  SIMPLE_LOG_PRINT(SIMPLE_LOGGER_WARN,  loggername, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(loggername, fmt, ...) SIMPLE_LOG_PRINT(SIMPLE_LOGGER_ERROR, loggername, fmt, ##__VA_ARGS__)
+#define LOG_FATAL(loggername, fmt, ...) SIMPLE_LOG_PRINT(SIMPLE_LOGGER_FATAL, loggername, fmt, ##__VA_ARGS__)
 
-#define LOG_DEBUG(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_DEBUG, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
+//
+// C++ streambuf style
+//
+#define SIMPLE_LOGGER_PRINT(level, loggername, message) { \
+        if (SIMPLE_LOGGER_ENABLED(level)) { \
+            std::ostringstream oss_; \
+            oss_ << message; \
+            SimpleLogger::instance().print_log(level, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, "%s", oss_.str().c_str()); \
+        }}
 
-#define LOG_INFO(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_INFO, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
+#define LOGGER_TRACE(loggername, message) SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_TRACE, loggername, message)
+#define LOGGER_DEBUG(loggername, message) SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_DEBUG, loggername, message)
+#define LOGGER_INFO(loggername, message)  SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_INFO,  loggername, message)
+#define LOGGER_WARN(loggername, message)  SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_WARN,  loggername, message)
+#define LOGGER_ERROR(loggername, message) SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_ERROR, loggername, message)
+#define LOGGER_FATAL(loggername, message) SIMPLE_LOGGER_PRINT(SIMPLE_LOGGER_FATAL, loggername, message)
 
-#define LOG_WARN(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_WARN, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
+//
+// Deferred formatting, loggername and fmt are fixed per call site
+//
+#define SIMPLE_LOGB_PRINT(level, loggername, fmt, ...) { \
+        if (SIMPLE_LOGGER_ENABLED(level)) { \
+            static const SimpleLogSite *site_ = SimpleLogger::instance().register_site(level, loggername, fmt, __FILE__, __LINE__); \
+            SimpleLogger::instance().log_binary(site_, ##__VA_ARGS__); \
+        }}
 
-#define LOG_ERROR(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_ERROR, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
+#define LOGB_TRACE(loggername, fmt, ...) SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_TRACE, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_DEBUG(loggername, fmt, ...) SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_DEBUG, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_INFO(loggername, fmt, ...)  SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_INFO,  loggername, fmt, ##__VA_ARGS__)
+#define LOGB_WARN(loggername, fmt, ...)  SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_WARN,  loggername, fmt, ##__VA_ARGS__)
+#define LOGB_ERROR(loggername, fmt, ...) SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_ERROR, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_FATAL(loggername, fmt, ...) SIMPLE_LOGB_PRINT(SIMPLE_LOGGER_FATAL, loggername, fmt, ##__VA_ARGS__)
 
-#define LOG_FATAL(loggername, fmt, ...) \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_FATAL, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, fmt, ##__VA_ARGS__)
 
 //
-// C++ streambuf style
+// Single producer/single consumer byte ring, one per logging thread.
+// A record is pushed whole or dropped, never blocks the caller.
 //
-#define LOGGER_TRACE(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_TRACE, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
-    }
+struct SimpleLogRing
+{
+    explicit SimpleLogRing(size_t capacity)
+            : buf(capacity), mask(capacity - 1), head(0), tail(0), closed(false), pushing(false) {}
 
-#define LOGGER_DEBUG(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_DEBUG, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
-    }
+    bool push(const char *data, size_t size)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        if (buf.size() - (h - t) < size)
+            return false;
 
-#define LOGGER_INFO(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_INFO, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
+        size_t pos = h & mask;
+        size_t first = std::min(size, buf.size() - pos);
+        std::memcpy(&buf[pos], data, first);
+        std::memcpy(&buf[0], data + first, size - first);
+        head.store(h + size, std::memory_order_release);
+        return true;
     }
 
-#define LOGGER_WARN(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_WARN, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
-    }
+    size_t pop(std::string &out)
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t size = h - t;
+        if (!size)
+            return 0;
 
-#define LOGGER_ERROR(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_ERROR, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
+        size_t pos = t & mask;
+        size_t first = std::min(size, buf.size() - pos);
+        out.append(&buf[pos], first);
+        out.append(&buf[0], size - first);
+        tail.store(h, std::memory_order_release);
+        return size;
     }
 
-#define LOGGER_FATAL(loggername, message) { \
-        std::ostringstream oss_; \
-        oss_ << message; \
-        SimpleLogger::instance().print_log(SIMPLE_LOGGER_FATAL, loggername, __FILE__, __LINE__, __PRETTY_FUNCTION__, oss_.str().c_str()); \
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
     }
 
+    std::vector<char> buf;
+    size_t mask;
+    std::atomic<size_t> head;   // written by the logging thread
+    std::atomic<size_t> tail;   // written by the writer thread
+    std::atomic<bool> closed;   // logging thread exited
+    std::atomic<bool> pushing;  // checking async mode and pushing, stop() waits for it
+};
+
+typedef std::shared_ptr<SimpleLogRing> SimpleLogRingPtr;
+
+//
+// A LOGB_* call site, written once into each binary log file
+//
+struct SimpleLogSite
+{
+    uint32_t id;
+    int level;
+    std::string name;
+    std::string fmt;
+    std::string file;
+    int line;
+};
+
 
 struct SimpleLogger
 {
@@ -126,6 +471,16 @@ struct SimpleLogger
         return logger_instance;
     }
 
+    SimpleLogger() : level_(SIMPLE_LOGGER_TRACE), async_(false), binary_(false), running_(false),
+                     binary_file_(false), sites_written_(0),
+                     file_(NULL), file_bytes_(0), file_opened_(0),
+                     rotate_bytes_(0), rotate_seconds_(0), dropped_(0) {}
+
+    ~SimpleLogger()
+    {
+        stop();
+    }
+
     const char* level_name(int level)
     {
         switch (level)
@@ -140,6 +495,81 @@ struct SimpleLogger
         return "";
     }
 
+    void set_level(int level) { level_.store(level, std::memory_order_relaxed); }
+
+    bool enabled(int level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // records dropped because a ring was full
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    //
+    // Async mode: records go to per-thread rings, a writer thread appends
+    // them to filename in batches and rotates it when it grows over
+    // rotate_bytes or gets older than rotate_seconds(0 = never).
+    // With binary, LOGB_* records keep their raw arguments.
+    //
+    bool start_async(const std::string &filename, size_t rotate_bytes = 0, uint32_t rotate_seconds = 0,
+                     bool binary = false)
+    {
+        std::lock_guard<std::mutex> guard(writer_mutex_);
+        if (running_)
+            return false;
+
+        filename_ = filename;
+        rotate_bytes_ = rotate_bytes;
+        rotate_seconds_ = rotate_seconds;
+        binary_file_ = binary;
+        if (!open_file())
+            return false;
+
+        running_ = true;
+        writer_ = std::thread(&SimpleLogger::write_loop, this);
+        binary_.store(binary, std::memory_order_release);
+        async_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // back to std::cout, remaining records are written out first
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(writer_mutex_);
+            if (!running_)
+                return;
+            // seq_cst, against the pushing flag of the rings
+            async_.store(false);
+            binary_.store(false, std::memory_order_release);
+            running_ = false;
+        }
+        writer_cond_.notify_one();
+
+        // a record that saw async mode on is in its ring once this returns
+        wait_pushes();
+
+        if (writer_.joinable())
+            writer_.join();
+
+        std::string batch;
+        drain(batch);
+        write_file(batch);
+        if (file_)
+            std::fclose(file_);
+        file_ = NULL;
+    }
+
+    // wait until everything logged so far is in the file
+    void flush()
+    {
+        if (!async_.load(std::memory_order_acquire))
+            return;
+
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        uint64_t target = flush_requested_ + 1;
+        flush_requested_ = target;
+        writer_cond_.notify_one();
+        flushed_cond_.wait(lock, [this, target]() { return flush_done_ >= target || !running_; });
+    }
+
     void print_log(int level,
                    const char *loggername,
                    const char *file,
@@ -153,20 +583,340 @@ struct SimpleLogger
         vsnprintf(buf, sizeof(buf), fmt, ap);
         va_end(ap);
 
-        char nowstr[64] = "";
-        std::time_t now = std::time(NULL);
-        std::strftime(nowstr, sizeof(nowstr), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        if (async_.load(std::memory_order_acquire))
+        {
+            // binary: [uint32 size][T][line]
+            const size_t head = sizeof(uint32_t) + sizeof(uint8_t);
+            bool binary = binary_.load(std::memory_order_acquire);
+
+            char record[head + LOG_LENGTH_MAX + 256];
+            char *text = binary ? record + head : record;
+            size_t textmax = sizeof(record) - head;
+            int size = snprintf(text, textmax, "%s %5s: [%s] - %s\n",
+                                now_string(), level_name(level), loggername, buf);
+            if (size < 0)
+                return;
+            if (size >= (int)textmax)
+            {
+                size = textmax - 1;
+                text[size - 1] = '\n';
+            }
+
+            if (binary)
+            {
+                size += head;
+                uint32_t recordsize = size;
+                std::memcpy(record, &recordsize, sizeof(recordsize));
+                record[sizeof(uint32_t)] = TINYLOG_RECORD_TEXT;
+            }
+
+            if (push_record(record, size))
+            {
+                if (level >= SIMPLE_LOGGER_FATAL)
+                    flush();
+                return;
+            }
+            // stopped meanwhile
+        }
 
         std::ostream *output = &std::cout;
 //        if (level >= SIMPLE_LOGGER_WARN)
 //            output = &std::cerr;
 
-        (*output) << nowstr
+        (*output) << now_string()
                   << " " << std::setfill(' ') << std::setw(5) << level_name(level) << ": "
                   << "[" << loggername << "] - " << buf
                   << std::endl;
         output->flush();
     }
+
+    const SimpleLogSite* register_site(int level, const char *loggername, const char *fmt,
+                                       const char *file, int line)
+    {
+        std::lock_guard<std::mutex> guard(sites_mutex_);
+        SimpleLogSite *site = new SimpleLogSite;
+        site->id = sites_.size();
+        site->level = level;
+        site->name = loggername;
+        site->fmt = fmt;
+        site->file = file;
+        site->line = line;
+        sites_.push_back(std::unique_ptr<SimpleLogSite>(site));
+        return site;
+    }
+
+    template <typename... Args>
+    void log_binary(const SimpleLogSite *site, const Args&... args)
+    {
+        if (!binary_.load(std::memory_order_acquire))
+        {
+            std::string text;
+            TinyLogArgs::format(text, site->fmt.c_str(), args...);
+            print_log(site->level, site->name.c_str(), site->file.c_str(), site->line, "", "%s", text.c_str());
+            return;
+        }
+
+        char record[TINYLOG_RECORD_MAX];
+        TinyLogEncoder enc(record, sizeof(record));
+        enc.put_pod<uint32_t>(0);
+        enc.put_pod<uint8_t>(TINYLOG_RECORD_EVENT);
+        enc.put_pod<uint32_t>(site->id);
+        enc.put_pod<int64_t>(now_us());
+        TinyLogArgs::encode(enc, args...);
+
+        uint32_t size = enc.size;
+        std::memcpy(record, &size, sizeof(size));
+
+        if (enc.overflow)
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        else if (!push_record(record, size))
+        {
+            // stopped meanwhile
+            std::string text;
+            TinyLogArgs::format(text, site->fmt.c_str(), args...);
+            print_log(site->level, site->name.c_str(), site->file.c_str(), site->line, "", "%s", text.c_str());
+            return;
+        }
+
+        if (site->level >= SIMPLE_LOGGER_FATAL)
+            flush();
+    }
+
+private:
+    static int64_t now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // formatted once per second per thread
+    static const char* now_string()
+    {
+        static thread_local std::time_t cached = 0;
+        static thread_local char nowstr[64] = "";
+
+        std::time_t now = std::time(NULL);
+        if (now != cached)
+        {
+            struct tm tm;
+            localtime_r(&now, &tm);
+            std::strftime(nowstr, sizeof(nowstr), "%Y-%m-%d %H:%M:%S", &tm);
+            cached = now;
+        }
+        return nowstr;
+    }
+
+    // marks the ring closed when the thread exits, the writer drops it after draining
+    struct RingHolder
+    {
+        SimpleLogRingPtr ring;
+        ~RingHolder() { if (ring) ring->closed.store(true, std::memory_order_release); }
+    };
+
+    SimpleLogRing* thread_ring()
+    {
+        static thread_local RingHolder holder;
+        if (!holder.ring)
+        {
+            holder.ring = std::make_shared<SimpleLogRing>(SIMPLE_LOGGER_RING_SIZE);
+            std::lock_guard<std::mutex> guard(rings_mutex_);
+            rings_.push_back(holder.ring);
+        }
+        return holder.ring.get();
+    }
+
+    // false if async mode is off, not pushed then
+    bool push_record(const char *record, size_t size)
+    {
+        SimpleLogRing *ring = thread_ring();
+        // seq_cst: either stop() sees the flag, or this sees async mode off
+        ring->pushing.store(true);
+        bool async = async_.load();
+        if (async && !ring->push(record, size))
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        ring->pushing.store(false, std::memory_order_release);
+        return async;
+    }
+
+    void wait_pushes()
+    {
+        std::lock_guard<std::mutex> guard(rings_mutex_);
+        for (auto &ring : rings_)
+        {
+            while (ring->pushing.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+    }
+
+    void drain(std::string &batch)
+    {
+        std::lock_guard<std::mutex> guard(rings_mutex_);
+        for (auto it = rings_.begin(); it != rings_.end();)
+        {
+            bool closed = (*it)->closed.load(std::memory_order_acquire);
+            (*it)->pop(batch);
+            if (closed && (*it)->empty())
+                it = rings_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void write_loop()
+    {
+        std::string batch;
+        batch.reserve(SIMPLE_LOGGER_RING_SIZE);
+
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        while (running_)
+        {
+            writer_cond_.wait_for(lock, std::chrono::milliseconds(10));
+            uint64_t flushing = flush_requested_;
+            lock.unlock();
+
+            batch.clear();
+            drain(batch);
+            write_file(batch);
+
+            lock.lock();
+            if (flushing > flush_done_)
+            {
+                flush_done_ = flushing;
+                flushed_cond_.notify_all();
+            }
+        }
+        flushed_cond_.notify_all();
+    }
+
+    // sites registered since the last batch go in front of it
+    void write_sites()
+    {
+        std::string head;
+        {
+            std::lock_guard<std::mutex> guard(sites_mutex_);
+            for (; sites_written_ < sites_.size(); ++sites_written_)
+            {
+                const SimpleLogSite &site = *sites_[sites_written_];
+                size_t start = head.size();
+                TinyLogEncoder::append_pod<uint32_t>(head, 0);
+                TinyLogEncoder::append_pod<uint8_t>(head, TINYLOG_RECORD_SITE);
+                TinyLogEncoder::append_pod<uint32_t>(head, site.id);
+                TinyLogEncoder::append_pod<uint8_t>(head, site.level);
+                TinyLogEncoder::append_str(head, site.name);
+                TinyLogEncoder::append_str(head, site.fmt);
+                TinyLogEncoder::append_str(head, site.file);
+                TinyLogEncoder::append_pod<uint32_t>(head, site.line);
+
+                uint32_t size = head.size() - start;
+                std::memcpy(&head[start], &size, sizeof(size));
+            }
+        }
+
+        if (head.size())
+        {
+            std::fwrite(head.data(), 1, head.size(), file_);
+            file_bytes_ += head.size();
+        }
+    }
+
+    void write_file(const std::string &batch)
+    {
+        if (!file_ || batch.empty())
+            return;
+
+        if (binary_file_)
+            write_sites();
+
+        std::fwrite(batch.data(), 1, batch.size(), file_);
+        std::fflush(file_);
+        file_bytes_ += batch.size();
+
+        if ((rotate_bytes_ && file_bytes_ >= rotate_bytes_)
+            || (rotate_seconds_ && std::time(NULL) - file_opened_ >= rotate_seconds_))
+            rotate_file();
+    }
+
+    bool open_file()
+    {
+        file_ = std::fopen(filename_.c_str(), "a");
+        if (!file_)
+        {
+            std::cerr << "open log file failed: " << filename_ << std::endl;
+            return false;
+        }
+
+        std::fseek(file_, 0, SEEK_END);
+        file_bytes_ = std::ftell(file_);
+        file_opened_ = std::time(NULL);
+
+        // every file starts with its own site table
+        if (binary_file_)
+        {
+            std::string head;
+            TinyLogEncoder::append_pod<uint32_t>(head, sizeof(uint32_t) + sizeof(uint8_t) + sizeof(int64_t));
+            TinyLogEncoder::append_pod<uint8_t>(head, TINYLOG_RECORD_HEAD);
+            TinyLogEncoder::append_pod<int64_t>(head, now_us());
+            std::fwrite(head.data(), 1, head.size(), file_);
+            file_bytes_ += head.size();
+
+            std::lock_guard<std::mutex> guard(sites_mutex_);
+            sites_written_ = 0;
+        }
+        return true;
+    }
+
+    // filename -> filename.YYYYmmdd-HHMMSS[.n]
+    void rotate_file()
+    {
+        std::fclose(file_);
+        file_ = NULL;
+
+        char suffix[64] = "";
+        std::time_t now = std::time(NULL);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        std::strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+
+        // more than one rotation in a second
+        std::string rotated = filename_ + suffix;
+        for (int i = 1; FILE *exist = std::fopen(rotated.c_str(), "r"); ++i)
+        {
+            std::fclose(exist);
+            rotated = filename_ + suffix + "." + std::to_string(i);
+        }
+        std::rename(filename_.c_str(), rotated.c_str());
+
+        open_file();
+    }
+
+    std::atomic<int> level_;
+    std::atomic<bool> async_;
+    std::atomic<bool> binary_;
+
+    std::mutex rings_mutex_;
+    std::vector<SimpleLogRingPtr> rings_;
+
+    std::mutex writer_mutex_;
+    std::condition_variable writer_cond_;
+    std::condition_variable flushed_cond_;
+    std::thread writer_;
+    bool running_;
+    uint64_t flush_requested_ = 0;
+    uint64_t flush_done_ = 0;
+
+    bool binary_file_;
+    std::mutex sites_mutex_;
+    std::vector<std::unique_ptr<SimpleLogSite>> sites_;
+    size_t sites_written_;
+
+    std::string filename_;
+    FILE *file_;
+    size_t file_bytes_;
+    std::time_t file_opened_;
+    size_t rotate_bytes_;
+    uint32_t rotate_seconds_;
+
+    std::atomic<uint64_t> dropped_;
 };
 
 
@@ -301,6 +1051,25 @@ using log4cxx::PropertyConfigurator;
             logger_->forcedLog(::log4cxx::Level::getFatal(), oss_.str(oss_ << message), LOG4CXX_LOCATION); \
         }}
 
+
+//
+// Deferred formatting, formatted when enabled
+//
+#define LOG4CXX_LOGB_PRINT(level, isEnabled, loggername, fmt, ...) { \
+        log4cxx::LoggerPtr logger_(log4cxx::Logger::getLogger(loggername)); \
+        if (LOG4CXX_UNLIKELY(logger_->isEnabled())) {\
+            std::string text_; \
+            TinyLogArgs::format(text_, fmt, ##__VA_ARGS__); \
+            logger_->forcedLog(log4cxx::Level::level(), text_, LOG4CXX_LOCATION); \
+        }}
+
+#define LOGB_TRACE(loggername, fmt, ...) LOG4CXX_LOGB_PRINT(getTrace, isTraceEnabled, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_DEBUG(loggername, fmt, ...) LOG4CXX_LOGB_PRINT(getDebug, isDebugEnabled, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_INFO(loggername, fmt, ...)  LOG4CXX_LOGB_PRINT(getInfo,  isInfoEnabled,  loggername, fmt, ##__VA_ARGS__)
+#define LOGB_WARN(loggername, fmt, ...)  LOG4CXX_LOGB_PRINT(getWarn,  isWarnEnabled,  loggername, fmt, ##__VA_ARGS__)
+#define LOGB_ERROR(loggername, fmt, ...) LOG4CXX_LOGB_PRINT(getError, isErrorEnabled, loggername, fmt, ##__VA_ARGS__)
+#define LOGB_FATAL(loggername, fmt, ...) LOG4CXX_LOGB_PRINT(getFatal, isFatalEnabled, loggername, fmt, ##__VA_ARGS__)
+
 #endif // TINYLOGGER_LOG4CXX
 
 #endif //TINYWORLD_TINYLOGGER_H
@@ -0,0 +1,522 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_TINYMETRICS_H
+#define TINYWORLD_TINYMETRICS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//////////////////////////////////////////////////////////
+//
+// Metrics:
+//
+//   - CounterMetric   : only increases, sharded per thread
+//   - GaugeMetric     : current value
+//   - HistogramMetric : log-linear buckets(8 per power of 2, ~12.5% error),
+//                       sharded per thread
+//
+//   Metrics are looked up once and then updated without locks:
+//
+//      static CounterMetric &sent = Metrics::counter("net.msgs_out");
+//      sent.inc();
+//
+//      static HistogramMetric &latency = Metrics::histogram("rpc.Get.latency_us");
+//      {
+//          MetricsTimer timer(latency);
+//          ...
+//      }
+//
+//   Report:
+//
+//      MetricsReporter::instance().dumpTo("metrics.txt", 10000);
+//      MetricsReporter::instance().serveHttp(9100);    // curl 127.0.0.1:9100
+//
+/////////////////////////////////////////////////////////
+
+#define METRICS_SHARDS              16
+#define METRICS_HISTOGRAM_SHARDS    4
+
+struct MetricsShard {
+    // shard of the current thread
+    static size_t index() {
+        static std::atomic<size_t> next(0);
+        static thread_local size_t shard = next++;
+        return shard;
+    }
+};
+
+class Metric {
+public:
+    enum Type {
+        kCounter,
+        kGauge,
+        kHistogram,
+    };
+
+    Metric(const std::string &name, Type type) : name_(name), type_(type) {}
+
+    virtual ~Metric() {}
+
+    const std::string &name() const { return name_; }
+
+    Type type() const { return type_; }
+
+    virtual void dump(std::ostream &os) = 0;
+
+protected:
+    std::string name_;
+    Type type_;
+};
+
+typedef std::shared_ptr<Metric> MetricPtr;
+
+//
+// Counter
+//
+class CounterMetric : public Metric {
+public:
+    CounterMetric(const std::string &name) : Metric(name, kCounter) {}
+
+    void inc(uint64_t n = 1) {
+        shards_[MetricsShard::index() % METRICS_SHARDS].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t sum = 0;
+        for (auto &shard : shards_)
+            sum += shard.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    void dump(std::ostream &os) override {
+        os << "counter   " << name_ << " " << value() << std::endl;
+    }
+
+private:
+    // one cache line each
+    struct Shard {
+        std::atomic<uint64_t> value{0};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    Shard shards_[METRICS_SHARDS];
+};
+
+//
+// Gauge
+//
+class GaugeMetric : public Metric {
+public:
+    GaugeMetric(const std::string &name) : Metric(name, kGauge) {}
+
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+
+    void add(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+    void sub(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+    void dump(std::ostream &os) override {
+        os << "gauge     " << name_ << " " << value() << std::endl;
+    }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+//
+// Histogram
+//
+class HistogramMetric : public Metric {
+public:
+    // values < 8 have their own bucket, then 8 buckets per power of 2
+    enum {
+        kSubBits = 3,
+        kSubBuckets = 1 << kSubBits,
+        kBuckets = (64 - kSubBits + 1) * kSubBuckets,
+    };
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(kBuckets, 0);
+
+        double mean() const { return count ? (double) sum / count : 0; }
+
+        // upper bound of the bucket holding the p-th(0~1) value
+        uint64_t percentile(double p) const {
+            if (!count) return 0;
+
+            uint64_t rank = (uint64_t) (p * count);
+            if (rank >= count) rank = count - 1;
+
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBuckets; ++i) {
+                seen += buckets[i];
+                if (seen > rank)
+                    return std::min(upper(i), max);
+            }
+            return max;
+        }
+    };
+
+    HistogramMetric(const std::string &name) : Metric(name, kHistogram) {}
+
+    void observe(uint64_t v) {
+        Shard &shard = shards_[MetricsShard::index() % METRICS_HISTOGRAM_SHARDS];
+        shard.buckets[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(v, std::memory_order_relaxed);
+
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (v > max && !shard.max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        for (auto &shard : shards_) {
+            snap.count += shard.count.load(std::memory_order_relaxed);
+            snap.sum += shard.sum.load(std::memory_order_relaxed);
+            snap.max = std::max(snap.max, shard.max.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < kBuckets; ++i)
+                snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        return snap;
+    }
+
+    void dump(std::ostream &os) override {
+        Snapshot snap = snapshot();
+        os << "histogram " << name_
+           << " count=" << snap.count
+           << " mean=" << std::fixed << std::setprecision(1) << snap.mean()
+           << " p50=" << snap.percentile(0.50)
+           << " p90=" << snap.percentile(0.90)
+           << " p99=" << snap.percentile(0.99)
+           << " p999=" << snap.percentile(0.999)
+           << " max=" << snap.max << std::endl;
+    }
+
+    static size_t bucket(uint64_t v) {
+        if (v < kSubBuckets)
+            return v;
+
+        size_t exp = 63 - __builtin_clzll(v);
+        size_t sub = (v >> (exp - kSubBits)) & (kSubBuckets - 1);
+        return (exp - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    static uint64_t upper(size_t bucket) {
+        if (bucket < kSubBuckets)
+            return bucket;
+
+        size_t exp = bucket / kSubBuckets + kSubBits - 1;
+        uint64_t sub = bucket % kSubBuckets;
+        uint64_t low = (kSubBuckets + sub) << (exp - kSubBits);
+        return low + ((uint64_t) 1 << (exp - kSubBits)) - 1;
+    }
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> buckets[kBuckets];
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+        Shard() {
+            for (auto &b : buckets)
+                b.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    Shard shards_[METRICS_HISTOGRAM_SHARDS];
+};
+
+//
+// Observe the scope's duration in microseconds
+//
+class MetricsTimer {
+public:
+    MetricsTimer(HistogramMetric &histogram)
+            : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+    ~MetricsTimer() {
+        histogram_.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_).count());
+    }
+
+private:
+    HistogramMetric &histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+//
+// Registry of all metrics by name
+//
+class Metrics {
+public:
+    static Metrics &instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    static CounterMetric &counter(const std::string &name) {
+        return instance().get<CounterMetric>(name, Metric::kCounter);
+    }
+
+    static GaugeMetric &gauge(const std::string &name) {
+        return instance().get<GaugeMetric>(name, Metric::kGauge);
+    }
+
+    static HistogramMetric &histogram(const std::string &name) {
+        return instance().get<HistogramMetric>(name, Metric::kHistogram);
+    }
+
+    // out of the report, the references to it must not be used any more
+    static void remove(const std::string &name) {
+        Metrics &metrics = instance();
+        std::lock_guard<std::mutex> guard(metrics.mutex_);
+        metrics.metrics_.erase(name);
+    }
+
+    // all metrics, one line each
+    std::string dumpString() {
+        std::vector<MetricPtr> metrics;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (auto &it : metrics_)
+                metrics.push_back(it.second);
+        }
+
+        std::ostringstream oss;
+        for (auto &metric : metrics)
+            metric->dump(oss);
+        return oss.str();
+    }
+
+private:
+    template<typename MetricT>
+    MetricT &get(const std::string &name, Metric::Type type) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = metrics_.find(name);
+        if (it != metrics_.end()) {
+            if (it->second->type() == type)
+                return *static_cast<MetricT *>(it->second.get());
+
+            // same name, another type: keep it working, but out of the report
+            std::cerr << "metric type conflict: " << name << std::endl;
+            orphans_.push_back(std::make_shared<MetricT>(name));
+            return *static_cast<MetricT *>(orphans_.back().get());
+        }
+
+        auto metric = std::make_shared<MetricT>(name);
+        metrics_[name] = metric;
+        return *metric;
+    }
+
+    std::mutex mutex_;
+    std::map<std::string, MetricPtr> metrics_;
+    std::vector<MetricPtr> orphans_;
+};
+
+//
+// Dump metrics to a file periodically and/or serve them on a local HTTP port
+//
+class MetricsReporter {
+public:
+    static MetricsReporter &instance() {
+        static MetricsReporter reporter;
+        return reporter;
+    }
+
+    ~MetricsReporter() {
+        stop();
+    }
+
+    // rewrite filename every interval_ms
+    bool dumpTo(const std::string &filename, uint32_t interval_ms = 10000) {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            filename_ = filename;
+            interval_ms_ = interval_ms ? interval_ms : 1000;
+        }
+        start();
+        return true;
+    }
+
+    // GET http://127.0.0.1:port/ returns the metrics as text
+    bool serveHttp(uint16_t port) {
+        std::unique_lock<std::mutex> guard(mutex_);
+        if (listenfd_ >= 0)
+            return false;
+
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (::bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || ::listen(fd, 16) < 0) {
+            std::cerr << "metrics http listen failed: " << port << std::endl;
+            ::close(fd);
+            return false;
+        }
+
+        listenfd_ = fd;
+        guard.unlock();
+
+        start();
+        return true;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> guard(thread_mutex_);
+        running_ = false;
+        if (thread_.joinable())
+            thread_.join();
+
+        // nobody selects on it any more
+        int fd = listenfd_.exchange(-1);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+private:
+    // not under mutex_, which the thread takes: stop() joins it
+    void start() {
+        std::lock_guard<std::mutex> guard(thread_mutex_);
+        if (running_)
+            return;
+        running_ = true;
+        thread_ = std::thread(&MetricsReporter::run, this);
+    }
+
+    void run() {
+        auto next = std::chrono::steady_clock::now();
+        while (running_) {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (filename_.size() && std::chrono::steady_clock::now() >= next) {
+                    dump();
+                    next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms_);
+                }
+            }
+
+            // only closed by stop(), after joining this thread
+            int fd = listenfd_;
+            if (fd >= 0)
+                serve(fd, 200);
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }
+
+    void dump() {
+        std::string tmp = filename_ + ".tmp";
+        FILE *fp = std::fopen(tmp.c_str(), "w");
+        if (!fp)
+            return;
+
+        std::string text = Metrics::instance().dumpString();
+        std::fwrite(text.data(), 1, text.size(), fp);
+        std::fclose(fp);
+        std::rename(tmp.c_str(), filename_.c_str());
+    }
+
+    void serve(int listenfd, long timeout_ms) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(listenfd, &fds);
+        struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        if (::select(listenfd + 1, &fds, NULL, NULL, &tv) <= 0)
+            return;
+
+        int fd = ::accept(listenfd, NULL, NULL);
+        if (fd < 0)
+            return;
+
+        // the request itself does not matter
+        char request[1024];
+        struct timeval rtv = {1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rtv, sizeof(rtv));
+        if (::recv(fd, request, sizeof(request), 0) < 0) {
+            ::close(fd);
+            return;
+        }
+
+        std::string body = Metrics::instance().dumpString();
+        std::ostringstream oss;
+        oss << "HTTP/1.0 200 OK\r\n"
+            << "Content-Type: text/plain\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "\r\n"
+            << body;
+
+        std::string response = oss.str();
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += n;
+        }
+        ::close(fd);
+    }
+
+    // filename_, interval_ms_
+    std::mutex mutex_;
+
+    // running_ and thread_ between start() and stop()
+    std::mutex thread_mutex_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::string filename_;
+    uint32_t interval_ms_ = 10000;
+    std::atomic<int> listenfd_{-1};
+};
+
+#endif //TINYWORLD_TINYMETRICS_H
@@ -47,6 +47,7 @@ bool MySqlConnection::connectByURL(const std::string &urltext) {
 MySqlConnectionPool::MySqlConnectionPool() {
     wait_timeout_ = 28800; // MySQL default:8hours
     shard_ = -1;
+    setMetricsName("mysql.pool");
 }
 
 void MySqlConnectionPool::setServerAddress(const std::string &urltext) {
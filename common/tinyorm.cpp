@@ -154,6 +154,7 @@ TableDescriptorBase &TableDescriptorBase::field(const std::string &name, FieldTy
                                         const std::string &deflt, size_t size) {
 
     FieldDescriptor::Ptr fd(new FieldDescriptor(name, type, deflt, size));
+    fd->ordinal = fields_ordered_.size();
     fields_[name] = fd;
     fields_ordered_.push_back(fd);
     return *this;
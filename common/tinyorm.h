@@ -26,6 +26,11 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <type_traits>
 #include "tinyreflection.h"
 #include "tinyserializer.h"
 #include "tinyserializer_proto.h"
@@ -81,6 +86,8 @@ public:
     std::string deflt;
     // Field size (some type is valid)
     uint32_t size;
+    // Column ordinal in the table
+    uint32_t ordinal = 0;
 };
 
 using FieldDescriptorList = std::vector<FieldDescriptor::Ptr>;
@@ -136,6 +143,215 @@ public:
 };
 
 
+//
+// Text form of a column value (MySQL text protocol):
+//   - integers/bool/float are parsed in place, strings are assigned directly
+//   - supported = false: the member is stored by its serializer
+//
+template<typename V, typename Enable = void>
+struct FieldText {
+    static const bool supported = false;
+    static const bool quoted = true;
+
+    static bool parse(V &, const char *, size_t) { return false; }
+
+    static void write(std::ostream &, const V &) {}
+};
+
+template<typename V>
+struct FieldText<V, typename std::enable_if<std::is_integral<V>::value && !std::is_same<V, bool>::value>::type> {
+    static const bool supported = true;
+    static const bool quoted = false;
+
+    // decimal, out of V's range or a sign on an unsigned V fails
+    static bool parse(V &v, const char *data, size_t size) {
+        char buf[32];
+        if (size == 0 || size >= sizeof(buf)) return false;
+        memcpy(buf, data, size);
+        buf[size] = '\0';
+
+        // strtoll/strtoull skip blanks and strtoull takes a '-'
+        const bool sign = (buf[0] == '-' || buf[0] == '+');
+        if (!(sign || (buf[0] >= '0' && buf[0] <= '9'))) return false;
+        if (sign && !(buf[1] >= '0' && buf[1] <= '9')) return false;
+
+        char *end = nullptr;
+        errno = 0;
+        if (std::is_signed<V>::value) {
+            long long n = std::strtoll(buf, &end, 10);
+            if (errno == ERANGE || end != buf + size
+                || n < static_cast<long long>(std::numeric_limits<V>::min())
+                || n > static_cast<long long>(std::numeric_limits<V>::max()))
+                return false;
+            v = static_cast<V>(n);
+        } else {
+            if (buf[0] == '-') return false;
+            unsigned long long n = std::strtoull(buf, &end, 10);
+            if (errno == ERANGE || end != buf + size
+                || n > static_cast<unsigned long long>(std::numeric_limits<V>::max()))
+                return false;
+            v = static_cast<V>(n);
+        }
+        return true;
+    }
+
+    static void write(std::ostream &os, const V &v) {
+        // int8/uint8 as number, not char
+        os << static_cast<typename std::conditional<sizeof(V) == 1, int, V>::type>(v);
+    }
+};
+
+template<typename V>
+struct FieldText<V, typename std::enable_if<std::is_floating_point<V>::value>::type> {
+    static const bool supported = true;
+    static const bool quoted = false;
+
+    static bool parse(V &v, const char *data, size_t size) {
+        char buf[64];
+        if (size == 0 || size >= sizeof(buf)) return false;
+        memcpy(buf, data, size);
+        buf[size] = '\0';
+
+        char *end = nullptr;
+        v = static_cast<V>(std::strtod(buf, &end));
+        return end == buf + size;
+    }
+
+    static void write(std::ostream &os, const V &v) { os << v; }
+};
+
+template<>
+struct FieldText<bool> {
+    static const bool supported = true;
+    static const bool quoted = false;
+
+    static bool parse(bool &v, const char *data, size_t size) {
+        int64_t n = 0;
+        if (!FieldText<int64_t>::parse(n, data, size)) return false;
+        v = (n != 0);
+        return true;
+    }
+
+    static void write(std::ostream &os, const bool &v) { os << v; }
+};
+
+template<>
+struct FieldText<std::string> {
+    static const bool supported = true;
+    static const bool quoted = true;
+
+    static bool parse(std::string &v, const char *data, size_t size) {
+        v.assign(data, size);
+        return true;
+    }
+
+    static void write(std::ostream &os, const std::string &v) { os << v; }
+};
+
+//
+// Row Codec: whole-row column codec of T, by column ordinal.
+//   Specialized by generated code(tools/tinyobj.py) with a switch over the
+//   columns, the ORM then skips FieldCodec and the reflection entirely.
+//
+template<typename T>
+struct RowCodec {
+    static const bool generated = false;
+
+    static bool decode(T &, size_t, const char *, size_t) { return false; }
+
+    static bool quoted(size_t) { return true; }
+
+    static void encode(std::ostream &, const T &, size_t) {}
+
+    static const std::string &text(const T &, size_t, std::string &buf) { return buf; }
+};
+
+//
+// Column Codec: compiled once when the field is registered,
+// accessed by column ordinal and reads/writes the member directly
+// (no by-name property lookup, no boost::any)
+//
+template<typename T>
+class FieldCodec {
+public:
+    using Ptr = std::shared_ptr<FieldCodec<T>>;
+
+    virtual ~FieldCodec() {}
+
+    // column text -> member
+    virtual bool decode(T &obj, const char *data, size_t size) const = 0;
+
+    // need quote/escape (string, bytes, object)
+    virtual bool quoted() const = 0;
+
+    // member -> stream (not quoted)
+    virtual void encode(std::ostream &os, const T &obj) const = 0;
+
+    // member -> text (quoted), the member itself or serialized into buf
+    virtual const std::string &text(const T &obj, std::string &buf) const = 0;
+};
+
+template<typename T, typename PropType>
+class FieldCodec_T : public FieldCodec<T> {
+public:
+    FieldCodec_T(PropType T::* prop) : prop_(prop) {}
+
+    bool decode(T &obj, const char *data, size_t size) const final {
+        return FieldText<PropType>::parse(obj.*prop_, data, size);
+    }
+
+    bool quoted() const final { return FieldText<PropType>::quoted; }
+
+    void encode(std::ostream &os, const T &obj) const final {
+        FieldText<PropType>::write(os, obj.*prop_);
+    }
+
+    const std::string &text(const T &obj, std::string &buf) const final {
+        return textOf(obj.*prop_, buf);
+    }
+
+private:
+    static const std::string &textOf(const std::string &v, std::string &) { return v; }
+
+    template<typename V>
+    static const std::string &textOf(const V &v, std::string &buf) {
+        std::ostringstream oss;
+        FieldText<V>::write(oss, v);
+        buf = oss.str();
+        return buf;
+    }
+
+    PropType T::* prop_;
+};
+
+template<typename T, typename PropType, typename SerializerT>
+class ObjectFieldCodec_T : public FieldCodec<T> {
+public:
+    ObjectFieldCodec_T(PropType T::* prop) : prop_(prop) {}
+
+    bool decode(T &obj, const char *data, size_t size) const final {
+        if (size == 0) return true;
+        SerializerT serializer;
+        return serializer.deserialize(obj.*prop_, std::string(data, size));
+    }
+
+    bool quoted() const final { return true; }
+
+    void encode(std::ostream &os, const T &obj) const final {
+        std::string buf;
+        os << text(obj, buf);
+    }
+
+    const std::string &text(const T &obj, std::string &buf) const final {
+        SerializerT serializer;
+        buf = serializer.serialize(obj.*prop_);
+        return buf;
+    }
+
+private:
+    PropType T::* prop_;
+};
+
 template<typename T>
 class TableDescriptor : public TableDescriptorBase {
 public:
@@ -150,10 +366,27 @@ public:
                               size_t size = 0) {
         reflection.template property<SerializerT>(name, prop);
         TableDescriptorBase::field(name, type, deflt, size);
+
+        typename FieldCodec<T>::Ptr codec;
+        if (type == FieldType::OBJECT || !FieldText<PropType>::supported)
+            codec = std::make_shared<ObjectFieldCodec_T<T, PropType, SerializerT<PropType>>>(prop);
+        else
+            codec = std::make_shared<FieldCodec_T<T, PropType>>(prop);
+
+        codecs_.resize(fields().size());
+        codecs_.back() = codec;
         return *this;
     }
 
+    // codec of the column (nullptr: registered without member)
+    FieldCodec<T> *codec(size_t ordinal) {
+        return ordinal < codecs_.size() ? codecs_[ordinal].get() : nullptr;
+    }
+
     Struct<T> reflection;
+
+private:
+    std::vector<typename FieldCodec<T>::Ptr> codecs_;
 };
 
 class TableFactory {
@@ -170,7 +403,7 @@ public:
         TableDescriptor<T> *td = new TableDescriptor<T>(name);
         TableDescriptorBase::Ptr ptr(td);
         tables_byname_[name] = ptr;
-        tables_bytype_[typeid(T).name()] = ptr;
+        tables_bytype_.set<T>(ptr);
         return *td;
     }
 
@@ -183,17 +416,14 @@ public:
 
     template<typename T>
     TableDescriptor<T> *tableByType() {
-        auto it = tables_bytype_.find(typeid(T).name());
-        if (it != tables_bytype_.end())
-            return static_cast<TableDescriptor<T> *>(it->second.get());
-        return nullptr;
+        return static_cast<TableDescriptor<T> *>(tables_bytype_.get<T>());
     }
 
     Tables &tables() { return tables_byname_; }
 
 private:
     Tables tables_byname_;
-    Tables tables_bytype_;
+    TypeSlots<TableDescriptorBase::Ptr> tables_bytype_;
 };
 
 
@@ -28,6 +28,7 @@
 #include "tinyorm.h"
 #include "tinymysql.h"
 #include "tinylogger.h"
+#include "tinymetrics.h"
 
 class TinyMySqlORM {
 public:
@@ -110,6 +111,9 @@ public:
     template<typename T>
     using Records = std::vector<std::shared_ptr<T>>;
 
+    // 字段等值条件(field, value), 字段必须是表的字段, 值会被转义
+    using FieldFilters = std::vector<std::pair<std::string, std::string>>;
+
     template<typename T>
     bool loadFromDB(Records<T> &records, const char *clause, ...);
 
@@ -125,6 +129,29 @@ public:
     template<typename T>
     bool vloadFromDB(const std::function<void(std::shared_ptr<T>)> &callback, const char *clause, va_list ap);
 
+    //
+    // 按主键顺序分页加载(keyset): WHERE (filters) AND (keys) > (after),
+    // after非空时只加载主键大于after的记录, 最多limit条
+    //
+    template<typename T>
+    bool loadPage(const std::function<void(std::shared_ptr<T>)> &callback, const T *after, size_t limit,
+                  const FieldFilters &filters = FieldFilters());
+
+    //
+    // 多个对象的批量操作(一条SQL完成):
+    //   selectMany  - SELECT ... WHERE (keys) IN (...)，找到的记录通过callback返回
+    //   replaceMany - REPLACE INTO ... VALUES (...),(...),...
+    //   delMany     - DELETE FROM ... WHERE (keys) IN (...)
+    //
+    template<typename T>
+    bool selectMany(const Records<T> &objs, const std::function<void(std::shared_ptr<T>)> &callback);
+
+    template<typename T>
+    bool replaceMany(const Records<T> &objs);
+
+    template<typename T>
+    bool delMany(const Records<T> &objs);
+
     //
     // 数据库批量删除
     //
@@ -175,12 +202,29 @@ protected:
                           const std::string &seperator = ",");
 
 
+    //
+    // `key` or (`key1`,`key2`,...)
+    //
+    template<typename T>
+    void makeKeyNameList(mysqlpp::Query &query, TableDescriptor<T> *td);
+
+    //
+    // key IN (v1,v2,...) or (key1,key2) IN ((v11,v12),(v21,v22),...)
+    //
+    template<typename T>
+    void makeKeyInList(mysqlpp::Query &query, const Records<T> &objs, TableDescriptor<T> *td);
+
     template<typename T>
     bool fieldToQuery(mysqlpp::Query &query, T &obj, TableDescriptor<T> *td, FieldDescriptor::Ptr fd);
 
     template<typename T>
     bool recordToObject(mysqlpp::Row &record, T &obj, TableDescriptor<T> *td);
 
+    //
+    // orm.<table>.query_us
+    //
+    template<typename T>
+    static HistogramMetric &queryTime(TableDescriptor<T> *td);
 
 private:
     mysqlpp::Connection *mysql_ = nullptr;
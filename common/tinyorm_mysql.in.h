@@ -242,6 +242,7 @@ inline bool TinyMySqlORM::select(T &obj) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         makeSelectQuery(query, obj, td);
         query << " LIMIT 1";
@@ -273,6 +274,7 @@ inline bool TinyMySqlORM::insert(T &obj) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         makeInsertQuery(query, obj, td);
         LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
@@ -300,6 +302,7 @@ inline bool TinyMySqlORM::replace(T &obj) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         makeReplaceQuery(query, obj, td);
         LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
@@ -326,6 +329,7 @@ inline bool TinyMySqlORM::update(T &obj) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         makeUpdateQuery(query, obj, td);
         LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
@@ -351,6 +355,7 @@ inline bool TinyMySqlORM::del(T &obj) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         makeDeleteQuery(query, obj, td);
         LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
@@ -382,6 +387,7 @@ TinyMySqlORM::vloadFromDB(const std::function<void(std::shared_ptr<T>)> &callbac
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         query << "SELECT " << td->sql_fieldlist();
         query << " FROM `" << td->table << "` ";
@@ -409,6 +415,75 @@ TinyMySqlORM::vloadFromDB(const std::function<void(std::shared_ptr<T>)> &callbac
     return false;
 }
 
+template<typename T>
+inline bool TinyMySqlORM::loadPage(const std::function<void(std::shared_ptr<T>)> &callback, const T *after,
+                                   size_t limit, const FieldFilters &filters) {
+    auto td = TableFactory::instance().tableByType<T>();
+    if (!td) {
+        LOG_ERROR("TinyMySqlORM", "%s: Table descriptor is not exist", __PRETTY_FUNCTION__);
+        return false;
+    }
+
+    for (auto &filter : filters) {
+        if (!td->getFieldDescriptor(filter.first)) {
+            LOG_ERROR("TinyMySqlORM", "%s: Field is not exist: %s", __PRETTY_FUNCTION__, filter.first.c_str());
+            return false;
+        }
+    }
+
+    try {
+        MetricsTimer timer(queryTime(td));
+        mysqlpp::Query query = mysql_->query();
+        query << "SELECT " << td->sql_fieldlist();
+        query << " FROM `" << td->table << "` ";
+
+        // the conditions are grouped, the keyset bound applies to all of them
+        if (filters.size()) {
+            query << " WHERE (";
+            for (size_t i = 0; i < filters.size(); ++i) {
+                if (i > 0) query << " AND ";
+                query << "`" << filters[i].first << "`=" << mysqlpp::quote << filters[i].second;
+            }
+            query << ")";
+        }
+
+        if (after) {
+            query << (filters.empty() ? " WHERE " : " AND ");
+            makeKeyNameList(query, td);
+            query << " > (";
+            makeValueList(query, const_cast<T &>(*after), td, td->keys());
+            query << ")";
+        }
+
+        query << " ORDER BY ";
+        for (size_t i = 0; i < td->keys().size(); ++i) {
+            if (i > 0) query << ",";
+            query << "`" << td->keys()[i]->name << "`";
+        }
+        query << " LIMIT " << limit;
+
+        LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
+        mysqlpp::StoreQueryResult res = query.store();
+        if (res) {
+            for (size_t i = 0; i < res.num_rows(); ++i) {
+                std::shared_ptr<T> obj = std::make_shared<T>();
+                if (recordToObject(res[i], *obj.get(), td)) {
+                    callback(obj);
+                } else {
+                    LOG_ERROR("TinyMySqlORM", "%s: recordToObject FAILED", __PRETTY_FUNCTION__);
+                }
+            }
+            return true;
+        }
+    }
+    catch (std::exception &err) {
+        LOG_ERROR("TinyMySqlORM", "%s: %s", __PRETTY_FUNCTION__, err.what());
+        return false;
+    }
+
+    return false;
+}
+
 template<typename T>
 inline bool TinyMySqlORM::loadFromDB(const std::function<void(std::shared_ptr<T>)> &callback, const char *clause, ...) {
     va_list ap;
@@ -460,6 +535,117 @@ inline bool TinyMySqlORM::loadFromDB2MultiIndexSet(TMultiIndexSet &records, cons
 };
 
 
+template<typename T>
+inline bool
+TinyMySqlORM::selectMany(const Records<T> &objs, const std::function<void(std::shared_ptr<T>)> &callback) {
+    if (objs.empty())
+        return true;
+
+    auto td = TableFactory::instance().tableByType<T>();
+    if (!td) {
+        LOG_ERROR("TinyMySqlORM", "%s: Table descriptor is not exist", __PRETTY_FUNCTION__);
+        return false;
+    }
+
+    try {
+        MetricsTimer timer(queryTime(td));
+        mysqlpp::Query query = mysql_->query();
+        query << "SELECT " << td->sql_fieldlist();
+        query << " FROM `" << td->table << "` WHERE ";
+        makeKeyInList(query, objs, td);
+
+        LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
+        mysqlpp::StoreQueryResult res = query.store();
+        if (res) {
+            for (size_t i = 0; i < res.num_rows(); ++i) {
+                std::shared_ptr<T> obj = std::make_shared<T>();
+                if (recordToObject(res[i], *obj.get(), td)) {
+                    callback(obj);
+                } else {
+                    LOG_ERROR("TinyMySqlORM", "%s: recordToObject FAILED", __PRETTY_FUNCTION__);
+                }
+            }
+            return true;
+        }
+    }
+    catch (std::exception &err) {
+        LOG_ERROR("TinyMySqlORM", "%s: %s", __PRETTY_FUNCTION__, err.what());
+        return false;
+    }
+
+    return false;
+}
+
+template<typename T>
+inline bool TinyMySqlORM::replaceMany(const Records<T> &objs) {
+    if (objs.empty())
+        return true;
+
+    auto td = TableFactory::instance().tableByType<T>();
+    if (!td) {
+        LOG_ERROR("TinyMySqlORM", "%s: Table descriptor is not exist", __PRETTY_FUNCTION__);
+        return false;
+    }
+
+    try {
+        MetricsTimer timer(queryTime(td));
+        mysqlpp::Query query = mysql_->query();
+        query << "REPLACE INTO `" << td->table
+              << "`(" << td->sql_fieldlist() << ")"
+              << " VALUES ";
+
+        for (size_t i = 0; i < objs.size(); ++i) {
+            if (i > 0) query << ",";
+            query << "(";
+            makeValueList(query, *objs[i].get(), td, td->fields());
+            query << ")";
+        }
+
+        LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
+        mysqlpp::SimpleResult res = query.execute();
+        if (res) {
+            return true;
+        }
+    }
+    catch (std::exception &err) {
+        LOG_ERROR("TinyMySqlORM", "%s: %s", __PRETTY_FUNCTION__, err.what());
+        return false;
+    }
+
+    return false;
+}
+
+template<typename T>
+inline bool TinyMySqlORM::delMany(const Records<T> &objs) {
+    if (objs.empty())
+        return true;
+
+    auto td = TableFactory::instance().tableByType<T>();
+    if (!td) {
+        LOG_ERROR("TinyMySqlORM", "%s: Table descriptor is not exist", __PRETTY_FUNCTION__);
+        return false;
+    }
+
+    try {
+        MetricsTimer timer(queryTime(td));
+        mysqlpp::Query query = mysql_->query();
+        query << "DELETE FROM `" << td->table << "` WHERE ";
+        makeKeyInList(query, objs, td);
+
+        LOG_TRACE("TinyMySqlORM", "%s", query.str().c_str());
+        mysqlpp::SimpleResult res = query.execute();
+        if (res) {
+            return true;
+        }
+    }
+    catch (std::exception &err) {
+        LOG_ERROR("TinyMySqlORM", "%s: %s", __PRETTY_FUNCTION__, err.what());
+        return false;
+    }
+
+    return false;
+}
+
 template<typename T>
 inline bool TinyMySqlORM::deleteFromDB(const char *where, ...) {
     auto td = TableFactory::instance().tableByType<T>();
@@ -477,6 +663,7 @@ inline bool TinyMySqlORM::deleteFromDB(const char *where, ...) {
     }
 
     try {
+        MetricsTimer timer(queryTime(td));
         mysqlpp::Query query = mysql_->query();
         query << "DELETE FROM `" << td->table << "` ";
         query << statement;
@@ -530,99 +717,71 @@ TinyMySqlORM::makeKeyValueList(mysqlpp::Query &query, T &obj, TableDescriptor<T>
 
 
 template<typename T>
-inline bool TinyMySqlORM::fieldToQuery(mysqlpp::Query &query, T &obj, TableDescriptor<T> *td, FieldDescriptor::Ptr fd) {
-    if (!td || !fd) return false;
+inline void TinyMySqlORM::makeKeyNameList(mysqlpp::Query &query, TableDescriptor<T> *td) {
+    const FieldDescriptorList &keys = td->keys();
+    bool multikeys = keys.size() > 1;
 
-    switch (fd->type) {
+    if (multikeys) query << "(";
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i > 0) query << ",";
+        query << "`" << keys[i]->name << "`";
+    }
+    if (multikeys) query << ")";
+}
 
-        case FieldType::INT8   : {
-            query << (int) td->reflection.template get<int8_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::INT16  : {
-            query << td->reflection.template get<int16_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::INT32  : {
-            query << td->reflection.template get<int32_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::INT64  : {
-            query << td->reflection.template get<int64_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::UINT8   : {
-            query << (int) td->reflection.template get<uint8_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::UINT16  : {
-            query << td->reflection.template get<uint16_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::UINT32  : {
-            query << td->reflection.template get<uint32_t>(obj, fd->name);
-            return true;
-        }
-        case FieldType::UINT64  : {
-            query << td->reflection.template get<uint64_t>(obj, fd->name);
-            return true;
-        }
+template<typename T>
+inline void TinyMySqlORM::makeKeyInList(mysqlpp::Query &query, const Records<T> &objs, TableDescriptor<T> *td) {
+    const FieldDescriptorList &keys = td->keys();
+    bool multikeys = keys.size() > 1;
 
-        case FieldType::BOOL   : {
-            query << td->reflection.template get<bool>(obj, fd->name);
-            return true;
-        }
+    makeKeyNameList(query, td);
 
-        case FieldType::FLOAT  : {
-            query << td->reflection.template get<float>(obj, fd->name);
-            return true;
-        }
-        case FieldType::DOUBLE : {
-            query << td->reflection.template get<double>(obj, fd->name);
-            return true;
-        }
+    query << " IN (";
+    for (size_t i = 0; i < objs.size(); ++i) {
+        if (i > 0) query << ",";
+        if (multikeys) query << "(";
+        makeValueList(query, *objs[i].get(), td, keys);
+        if (multikeys) query << ")";
+    }
+    query << ")";
+}
 
-        case FieldType::STRING : {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
-        case FieldType::VCHAR  : {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
+template<typename T>
+inline bool TinyMySqlORM::fieldToQuery(mysqlpp::Query &query, T &obj, TableDescriptor<T> *td, FieldDescriptor::Ptr fd) {
+    if (!td || !fd) return false;
 
-        case FieldType::BYTES: {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
-        case FieldType::BYTES_TINY: {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
-        case FieldType::BYTES_MEDIUM: {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
-        case FieldType::BYTES_LONG: {
-            query << mysqlpp::quote << td->reflection.template get<std::string>(obj, fd->name);
-            return true;
-        }
-        case FieldType::OBJECT: {
-            auto pd = td->reflection.propertyByName(fd->name);
-            if (pd) {
-                std::string bin = pd->serialize(obj);
-                query << mysqlpp::quote << bin;
-                return bin.size() > 0;
-            } else {
-                query << mysqlpp::quote << "";
-                return false;
-            }
+    if (RowCodec<T>::generated) {
+        if (RowCodec<T>::quoted(fd->ordinal)) {
+            std::string buf;
+            query << mysqlpp::quote << RowCodec<T>::text(obj, fd->ordinal, buf);
+        } else {
+            RowCodec<T>::encode(query, obj, fd->ordinal);
         }
+        return true;
+    }
+
+    FieldCodec<T> *codec = td->codec(fd->ordinal);
+    if (!codec) {
+        query << mysqlpp::quote << "";
+        return false;
+    }
+
+    if (codec->quoted()) {
+        std::string buf;
+        query << mysqlpp::quote << codec->text(obj, buf);
+    } else {
+        codec->encode(query, obj);
     }
 
     return true;
 }
 
+template<typename T>
+inline HistogramMetric &TinyMySqlORM::queryTime(TableDescriptor<T> *td) {
+    static HistogramMetric &histogram = Metrics::histogram("orm." + td->table + ".query_us");
+    return histogram;
+}
+
 template<typename T>
 inline bool TinyMySqlORM::recordToObject(mysqlpp::Row &record, T &obj, TableDescriptor<T> *td) {
     if (!td || record.size() < td->fields().size())
@@ -630,118 +789,34 @@ inline bool TinyMySqlORM::recordToObject(mysqlpp::Row &record, T &obj, TableDesc
 
     bool ret = true;
 
+    // decode by column ordinal, straight into the members
     for (size_t i = 0; i < td->fields().size(); ++i) {
-        auto fd = td->fields().at(i);
-
-        switch (fd->type) {
-
-            case FieldType::INT8   : {
-                td->reflection.template set<int8_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::INT16  : {
-                td->reflection.template set<int16_t>(obj, fd->name, record[i]);
-                break;
+        if (RowCodec<T>::generated) {
+            const mysqlpp::String &column = record[i];
+            if (!column.is_null() && !RowCodec<T>::decode(obj, i, column.data(), column.size())) {
+                ret = false;
+                LOG_ERROR("TinyMySqlORM", "%s.%s Field decode failed", td->table.c_str(),
+                          td->fields()[i]->name.c_str());
             }
-            case FieldType::INT32  : {
-                td->reflection.template set<int32_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::INT64  : {
-                td->reflection.template set<int64_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::UINT8   : {
-                td->reflection.template set<uint8_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::UINT16  : {
-                td->reflection.template set<uint16_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::UINT32  : {
-                td->reflection.template set<uint32_t>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::UINT64  : {
-                td->reflection.template set<uint64_t>(obj, fd->name, record[i]);
-                break;
-            }
-
-            case FieldType::BOOL   : {
-                td->reflection.template set<bool>(obj, fd->name, record[i]);
-                break;
-            }
-
-            case FieldType::FLOAT  : {
-                td->reflection.template set<float>(obj, fd->name, record[i]);
-                break;
-            }
-            case FieldType::DOUBLE : {
-                td->reflection.template set<double>(obj, fd->name, record[i]);
-                break;
-            }
-
-            case FieldType::STRING : {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-            case FieldType::VCHAR  : {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-
-            case FieldType::BYTES: {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-            case FieldType::BYTES_TINY: {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-            case FieldType::BYTES_MEDIUM: {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-            case FieldType::BYTES_LONG: {
-                td->reflection.template set<std::string>(
-                        obj, fd->name, std::string(record[i].data(), record[i].size()));
-                break;
-            }
-            case FieldType::OBJECT: {
-                auto prop = td->reflection.propertyByName(fd->name);
-                if (!prop) {
-                    ret = false;
-                    LOG_ERROR("TinyMySqlORM", "%s.%s Property Reflection is not exist", td->table.c_str(),
-                              fd->name.c_str());
-                    break;
-                }
+            continue;
+        }
 
-                if(record[i].is_null())
-                {
-                    ret = true;
-                    LOG_WARN("TinyMySqlORM", "%s.%s Property is NULL", td->table.c_str(), fd->name.c_str());
-                    break;
-                }
+        FieldCodec<T> *codec = td->codec(i);
+        if (!codec) {
+            ret = false;
+            LOG_ERROR("TinyMySqlORM", "%s.%s Field codec is not exist", td->table.c_str(),
+                      td->fields()[i]->name.c_str());
+            continue;
+        }
 
-                if(record[i].empty())
-                {
-                    ret = true;
-                    LOG_WARN("TinyMySqlORM", "%s.%s Property is empty", td->table.c_str(), fd->name.c_str());
-                    break;
-                }
+        const mysqlpp::String &column = record[i];
+        if (column.is_null())
+            continue;
 
-                if (!prop->deserialize(obj, std::string(record[i].data(), record[i].size()))) {
-                    ret = false;
-                    LOG_ERROR("TinyMySqlORM", "%s.%s Property deserialize failed", td->table.c_str(), fd->name.c_str());
-                    break;
-                }
-            }
+        if (!codec->decode(obj, column.data(), column.size())) {
+            ret = false;
+            LOG_ERROR("TinyMySqlORM", "%s.%s Field decode failed", td->table.c_str(),
+                      td->fields()[i]->name.c_str());
         }
     }
 
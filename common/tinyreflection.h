@@ -24,6 +24,7 @@
 #include "tinyworld.h"
 
 #include <iostream>
+#include <cstring>
 #include <functional>
 #include <vector>
 #include <memory>
@@ -45,6 +46,50 @@ struct DummySerializer {
     bool deserialize(T &object, const std::string &bin) const { return false; }
 };
 
+//
+// Compact binary of a property value: arithmetic types as their bytes,
+// strings as they are, the others by the property's serializer.
+//
+template<typename V, typename SerializerT, typename Enable = void>
+struct BinaryField {
+    static void encode(const V &v, std::string &out) {
+        SerializerT serializer;
+        out = serializer.serialize(v);
+    }
+
+    static bool decode(V &v, const char *data, size_t size) {
+        SerializerT serializer;
+        return serializer.deserialize(v, std::string(data, size));
+    }
+};
+
+template<typename V, typename SerializerT>
+struct BinaryField<V, SerializerT,
+        typename std::enable_if<std::is_arithmetic<V>::value || std::is_enum<V>::value>::type> {
+    static void encode(const V &v, std::string &out) {
+        out.assign(reinterpret_cast<const char *>(&v), sizeof(V));
+    }
+
+    static bool decode(V &v, const char *data, size_t size) {
+        if (size != sizeof(V))
+            return false;
+        std::memcpy(&v, data, sizeof(V));
+        return true;
+    }
+};
+
+template<typename SerializerT>
+struct BinaryField<std::string, SerializerT> {
+    static void encode(const std::string &v, std::string &out) {
+        out = v;
+    }
+
+    static bool decode(std::string &v, const char *data, size_t size) {
+        v.assign(data, size);
+        return true;
+    }
+};
+
 //
 // Base Property Reflection Class
 //
@@ -77,6 +122,13 @@ public:
 
     virtual bool deserialize(T &object, const std::string &bin) = 0;
 
+    //
+    // Compact binary (BinaryField)
+    //
+    virtual void encode(const T &, std::string &out) = 0;
+
+    virtual bool decode(T &object, const char *data, size_t size) = 0;
+
 protected:
     std::string name_;
     uint16_t number_;
@@ -118,6 +170,14 @@ public:
         return serializer.deserialize(fn_(obj), data);
     }
 
+    void encode(const T &obj, std::string &out) final {
+        BinaryField<PropType, SerializerT>::encode(fn_(obj), out);
+    }
+
+    bool decode(T &obj, const char *data, size_t size) final {
+        return BinaryField<PropType, SerializerT>::decode(fn_(obj), data, size);
+    }
+
 protected:
     MemFn fn_;
 };
@@ -236,18 +296,14 @@ struct StructFactory {
             struct_name = type_name;
 
         auto desc = std::make_shared<Struct<T>>(struct_name);
-        structs_by_typeid_[type_name] = desc;
+        structs_by_type_.set<T>(desc);
         structs_by_name_[struct_name] = desc;
         return *desc;
     }
 
     template<typename T>
     Struct<T> *structByType() {
-        std::string type_name = typeid(T).name();
-        auto it = structs_by_typeid_.find(type_name);
-        if (it != structs_by_typeid_.end())
-            return static_cast<Struct<T> *>(it->second.get());
-        return NULL;
+        return static_cast<Struct<T> *>(structs_by_type_.get<T>());
     }
 
     template<typename T>
@@ -261,7 +317,7 @@ struct StructFactory {
 protected:
     typedef std::unordered_map<std::string, std::shared_ptr<StructBase>> Structs;
 
-    Structs structs_by_typeid_;
+    TypeSlots<std::shared_ptr<StructBase>> structs_by_type_;
     Structs structs_by_name_;
 };
 
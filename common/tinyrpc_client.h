@@ -31,6 +31,8 @@
 #include "tinyserializer.h"
 #include "tinyserializer_proto.h"
 #include "message_dispatcher.h"
+#include "tinymetrics.h"
+#include "tinytrace.h"
 
 TINY_NAMESPACE_BEGIN
 
@@ -45,6 +47,11 @@ public:
             : emitter_(emitter) {
         id_ = ++total_id_;
         createtime_ = std::chrono::high_resolution_clock::now();
+
+        // child of the running span, or a new sampled root
+        trace_ = Tracer::child();
+        if (trace_.sampled)
+            trace_start_us_ = Tracer::now_us();
     }
 
     long elapsed_ms() {
@@ -69,6 +76,36 @@ public:
 
     virtual bool pack(rpc::Request &request) = 0;
 
+protected:
+    void packTrace(rpc::Request &request) {
+        if (trace_.sampled) {
+            rpc::TraceContext *trace = request.mutable_trace();
+            trace->set_trace_id(trace_.trace_id);
+            trace->set_span_id(trace_.span_id);
+            trace->set_sampled(true);
+            trace->set_send_us(Tracer::now_us());
+        }
+    }
+
+    // client side span: emit -> replied/timeouted
+    void recordTrace(const std::string &name) {
+        if (trace_.sampled)
+            Tracer::instance().record(trace_, name, trace_start_us_, Tracer::now_us() - trace_start_us_);
+    }
+
+    // replied -> received: transport and client queues, after the server span
+    void recordReplyTrace(const rpc::Reply &reply) {
+        if (!trace_.sampled || !reply.has_trace() || !reply.trace().send_us())
+            return;
+
+        TraceContext queue;
+        queue.trace_id = trace_.trace_id;
+        queue.parent_id = reply.trace().span_id();
+        queue.span_id = Tracer::newId();
+        queue.sampled = true;
+        Tracer::instance().record(queue, "rpc.reply", reply.trace().send_us(), Tracer::now_us() - reply.trace().send_us());
+    }
+
 public:
     static uint64_t total_id_;
 
@@ -82,6 +119,9 @@ public:
     long timeout_ms_;
     // emitter
     RPCEmitter *emitter_ = NULL;
+    // trace context of this call
+    TraceContext trace_;
+    int64_t trace_start_us_ = 0;
 };
 
 typedef std::shared_ptr<RPCHolderBase> RPCHolderPtr;
@@ -116,19 +156,30 @@ public:
     }
 
     bool pack(rpc::Request &req) final {
-        std::string body = serialize(request_);
-        if (body.size()) {
+        TraceScope scope(trace_);
+        TraceSpan span("rpc.pack");
+
+        // encoded straight into the body
+        if (serializeTo(*req.mutable_body(), request_)) {
             req.set_id(id_);
             req.set_request(MessageName<Request>::value());
             req.set_reply(MessageName<Reply>::value());
-            req.set_body(body);
+            packTrace(req);
             return true;
         }
         return false;
     };
 
     void replied(const rpc::Reply &rpc_reply) final {
+        metrics().latency.observe(elpased_ns() / 1000);
+
+        // callbacks run as children of this call
+        TraceScope scope(trace_);
+        recordReplyTrace(rpc_reply);
+        recordTrace("rpc.client:" + MessageName<Request>::value());
+
         if (rpc_reply.errcode() != rpc::NOERROR) {
+            metrics().errors.inc();
             if (cb_error_) cb_error_(request_, rpc_reply.errcode());
             return;
         }
@@ -139,23 +190,50 @@ public:
             return;
         }
 
-        Reply reply;
-        if (!deserialize(reply, rpc_reply.body())) {
+        ProtoArenaScope arena;
+        ProtoArenaObject<Reply> reply(arena.arena());
+        bool parsed = false;
+        {
+            TraceSpan span("rpc.unpack");
+            parsed = deserializeFrom(reply.get(), rpc_reply.body().data(), rpc_reply.body().size());
+        }
+
+        if (!parsed) {
             if (cb_error_) cb_error_(request_, rpc::REPLY_PARSE_ERROR);
             return;
         }
 
         if (cb_done_) {
-            cb_done_(reply);
+            cb_done_(reply.get());
         }
     }
 
     void timeouted() final {
+        metrics().timeouts.inc();
+        recordTrace("rpc.client:" + MessageName<Request>::value() + ":timeout");
+
+        TraceScope scope(trace_);
         if (cb_timeout_)
             cb_timeout_(request_);
     }
 
 private:
+    // rpc.<Request>.latency_us/errors/timeouts
+    struct RPCMetrics {
+        HistogramMetric &latency;
+        CounterMetric &errors;
+        CounterMetric &timeouts;
+    };
+
+    static RPCMetrics &metrics() {
+        static RPCMetrics metrics = {
+                Metrics::histogram("rpc." + MessageName<Request>::value() + ".latency_us"),
+                Metrics::counter("rpc." + MessageName<Request>::value() + ".errors"),
+                Metrics::counter("rpc." + MessageName<Request>::value() + ".timeouts"),
+        };
+        return metrics;
+    }
+
     Request request_;
     Callback cb_done_;
     TimeoutCallback cb_timeout_;
@@ -174,6 +252,7 @@ public:
         auto *holder = new RPCHolder<Request, Reply>(request, this);
         RPCHolderPtr ptr(holder);
         rpc_holders_[ptr->id_] = ptr;
+        pending().add();
         return *holder;
     }
 
@@ -184,6 +263,7 @@ public:
             it->second->replied(reply);
             rpc_timeout_holders_.erase(it->first);
             rpc_holders_.erase(it);
+            pending().sub();
         }
     }
 
@@ -199,6 +279,7 @@ public:
                 tmp->second->timeouted();
                 rpc_holders_.erase(tmp->first);
                 rpc_timeout_holders_.erase(tmp);
+                pending().sub();
 
                 count++;
             }
@@ -209,6 +290,12 @@ public:
 
 
 private:
+    // calls waiting for reply, all emitters
+    static GaugeMetric &pending() {
+        static GaugeMetric &gauge = Metrics::gauge("rpc.pending");
+        return gauge;
+    }
+
     typedef std::unordered_map<uint64_t, RPCHolderPtr> RPCHolderMap;
 
     RPCHolderMap rpc_holders_;
@@ -232,9 +319,10 @@ public:
     RPCHolder<Request, Reply> &emit(const Request &request) {
         auto &holder = rpc_emitter_.emit<Request, Reply>(request);
 
-        rpc::Request rpc_req;
-        holder.pack(rpc_req);
-        this->send(rpc_req);
+        ProtoArenaScope arena;
+        rpc::Request *rpc_req = google::protobuf::Arena::CreateMessage<rpc::Request>(arena.arena());
+        holder.pack(*rpc_req);
+        this->send(*rpc_req);
         return holder;
     }
 
@@ -28,6 +28,8 @@
 
 #include "tinyworld.h"
 #include "tinyrpc.pb.h"
+#include "tinyserializer_proto.h"
+#include "tinytrace.h"
 
 
 TINY_NAMESPACE_BEGIN
@@ -65,12 +67,28 @@ public:
 
         if (rpc_request.request() == MessageName<Request>::value() &&
             rpc_request.reply() == MessageName<Reply>::value()) {
-            Request request;
-            if (deserialize(request, rpc_request.body())) {
-                Reply reply = callback_(request);
-                std::string body = serialize(reply);
-                if (body.size()) {
-                    rpc_reply.set_body(body);
+            ProtoArenaScope arena;
+            ProtoArenaObject<Request> request(arena.arena());
+            bool parsed = false;
+            {
+                TraceSpan span("rpc.parse");
+                parsed = deserializeFrom(request.get(), rpc_request.body().data(), rpc_request.body().size());
+            }
+
+            if (parsed) {
+                Reply reply;
+                {
+                    TraceSpan span("rpc.handler");
+                    reply = callback_(request.get());
+                }
+
+                bool packed = false;
+                {
+                    TraceSpan span("rpc.serialize");
+                    packed = serializeTo(*rpc_reply.mutable_body(), reply);
+                }
+
+                if (packed) {
                     rpc_reply.set_errcode(rpc::NOERROR);
                 } else {
                     rpc_reply.set_errcode(rpc::REPLY_PACK_ERROR);
@@ -112,7 +130,34 @@ public:
             return reply;
         }
 
-        return it->second->requested(request);
+        if (!request.has_trace() || !request.trace().sampled())
+            return it->second->requested(request);
+
+        // span of the caller
+        TraceContext remote;
+        remote.trace_id = request.trace().trace_id();
+        remote.span_id = request.trace().span_id();
+        remote.sampled = true;
+
+        // sent -> dispatched: transport and worker queues
+        int64_t now = Tracer::now_us();
+        if (request.trace().send_us()) {
+            TraceContext queue = remote;
+            queue.parent_id = remote.span_id;
+            queue.span_id = Tracer::newId();
+            Tracer::instance().record(queue, "rpc.queue", request.trace().send_us(), now - request.trace().send_us());
+        }
+
+        TraceScope scope(remote);
+        TraceSpan span("rpc.server:" + request.request());
+        rpc::Reply reply = it->second->requested(request);
+
+        rpc::TraceContext *trace = reply.mutable_trace();
+        trace->set_trace_id(span.context().trace_id);
+        trace->set_span_id(span.context().span_id);
+        trace->set_sampled(true);
+        trace->set_send_us(Tracer::now_us());
+        return reply;
     }
 
 private:
@@ -139,6 +184,8 @@ public:
         return rpc_dispatcher.on<Request, Reply>(callback);
     }
 
+    RPCDispatcher &rpcDispatcher() { return rpc_dispatcher; }
+
     void doMsgRequest(const rpc::Request &msg) {
         rpc::Reply rpc_rep = rpc_dispatcher.requested(msg);
         this->send(rpc_rep);
@@ -168,6 +215,8 @@ public:
         return rpc_dispatcher.on<Request, Reply>(callback);
     }
 
+    RPCDispatcher &rpcDispatcher() { return rpc_dispatcher; }
+
     void doMsgRequest(const rpc::Request &msg, const std::string &client) {
         rpc::Reply rpc_rep = rpc_dispatcher.requested(msg);
         this->send(client, rpc_rep);
@@ -34,6 +34,8 @@
 #include <unordered_set>
 #include <unordered_map>
 
+#include <google/protobuf/arena.h>
+
 #include "tinyworld.h"
 #include "archive.pb.h"
 
@@ -470,4 +472,130 @@ public:
     }
 };
 
+
+//
+// Serialize into / parse from a buffer in place:
+//   protobuf messages by ProtoSerializer are encoded straight into the
+//   destination and parsed from the source bytes, the others go through
+//   a temporary string.
+//
+template<template<typename> class SerializerT, typename T,
+        bool InPlace = std::is_same<SerializerT<T>, ProtoSerializer<T> >::value
+                       && ProtoCase<T>::value == kProtoType_Proto>
+struct ProtoInPlace {
+    static bool append(std::string &buf, const T &object) {
+        std::string data = serialize<SerializerT>(object);
+        buf.append(data);
+        return !data.empty();
+    }
+
+    static bool parse(T &object, const char *data, size_t size) {
+        return deserialize<SerializerT>(object, std::string(data, size));
+    }
+};
+
+template<template<typename> class SerializerT, typename T>
+struct ProtoInPlace<SerializerT, T, true> {
+    static bool append(std::string &buf, const T &object) {
+        size_t size = object.ByteSizeLong();
+        if (!size) return false;
+
+        size_t offset = buf.size();
+        buf.resize(offset + size);
+        object.SerializeWithCachedSizesToArray((uint8_t *) &buf[offset]);
+        return true;
+    }
+
+    static bool parse(T &object, const char *data, size_t size) {
+        return object.ParseFromArray(data, static_cast<int>(size));
+    }
+};
+
+// append the serialized object to buf
+template<template<typename> class SerializerT = ProtoSerializer, typename T>
+inline bool serializeTo(std::string &buf, const T &object) {
+    return ProtoInPlace<SerializerT, T>::append(buf, object);
+}
+
+template<template<typename> class SerializerT = ProtoSerializer, typename T>
+inline bool deserializeFrom(T &object, const char *data, size_t size) {
+    return ProtoInPlace<SerializerT, T>::parse(object, data, size);
+}
+
+
+//
+// Arena of the current thread for the messages living within one request.
+// The memory is reused across requests: the arena is reset when the
+// outermost scope on the thread exits, and small requests stay in the
+// initial block without touching the heap.
+//
+//   ProtoArenaScope scope;
+//   ProtoArenaObject<LoginRequest> request(scope.arena());
+//   deserializeFrom(request.get(), data, size);
+//
+#define PROTO_ARENA_BLOCK_SIZE (64 * 1024)
+
+class ProtoArenaScope {
+public:
+    ProtoArenaScope() : state_(state()) {
+        state_.depth++;
+    }
+
+    ~ProtoArenaScope() {
+        if (--state_.depth == 0)
+            state_.arena.Reset();
+    }
+
+    google::protobuf::Arena *arena() { return &state_.arena; }
+
+private:
+    struct State {
+        State() : arena(options(block)) {}
+
+        static google::protobuf::ArenaOptions options(char *block) {
+            google::protobuf::ArenaOptions opts;
+            opts.initial_block = block;
+            opts.initial_block_size = PROTO_ARENA_BLOCK_SIZE;
+            return opts;
+        }
+
+        char block[PROTO_ARENA_BLOCK_SIZE];
+        google::protobuf::Arena arena;
+        int depth = 0;
+    };
+
+    static State &state() {
+        static thread_local State state_;
+        return state_;
+    }
+
+    State &state_;
+};
+
+//
+// T on the arena if it's a protobuf message, otherwise a plain member
+//
+template<typename T, bool OnArena = ProtoCase<T>::value == kProtoType_Proto>
+class ProtoArenaObject {
+public:
+    ProtoArenaObject(google::protobuf::Arena *) {}
+
+    T &get() { return object_; }
+
+private:
+    T object_;
+};
+
+template<typename T>
+class ProtoArenaObject<T, true> {
+public:
+    ProtoArenaObject(google::protobuf::Arena *arena)
+            : object_(google::protobuf::Arena::CreateMessage<T>(arena)) {}
+
+    T &get() { return *object_; }
+
+private:
+    T *object_;
+};
+
 #endif //TINYWORLD_TINYSERIALIZER_PROTO_H
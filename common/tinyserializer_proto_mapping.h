@@ -214,10 +214,7 @@ public:
     //
     template<typename T>
     ProtoMapping<T> *mappingByType() {
-        auto it = mappings_by_typeid_.find(typeid(T).name());
-        if (it != mappings_by_typeid_.end())
-            return static_cast<ProtoMapping<T> *>(it->second.get());
-        return NULL;
+        return static_cast<ProtoMapping<T> *>(mappings_by_type_.get<T>());
     }
 
     ProtoMappingBase *mappingByName(const std::string &name) {
@@ -284,8 +281,8 @@ protected:
             std::cerr << "[ProtoMapping] mappingByName exist: " << cpp_name << " : " << __PRETTY_FUNCTION__
                       << std::endl;
 
-        mappings_by_typeid_[typeid(T).name()] = mapping;
-        mappings_by_typeid_[cpp_name] = mapping;
+        mappings_by_type_.set<T>(mapping);
+        mappings_by_name_[cpp_name] = mapping;
         mappings_by_order_.push_back(mapping);
 
         return *mapping;
@@ -295,7 +292,7 @@ protected:
 protected:
     typedef std::unordered_map<std::string, std::shared_ptr<ProtoMappingBase>> ProtoMappings;
 
-    ProtoMappings mappings_by_typeid_;
+    TypeSlots<std::shared_ptr<ProtoMappingBase>> mappings_by_type_;
     ProtoMappings mappings_by_name_;
     std::vector<std::shared_ptr<ProtoMappingBase>> mappings_by_order_;
 
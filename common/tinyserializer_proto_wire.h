@@ -0,0 +1,172 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+// Protobuf wire format of scalar members, used by generated codecs
+// (tools/tinyobj.py) to encode/decode a struct without building the
+// message object:
+//
+//   signed integer  -> sint32/sint64
+//   unsigned, bool  -> uint32/uint64
+//   float/double    -> float/double
+//   std::string     -> bytes
+//
+
+#ifndef TINYWORLD_TINYSERIALIZER_PROTO_WIRE_H
+#define TINYWORLD_TINYSERIALIZER_PROTO_WIRE_H
+
+#include <string>
+#include <type_traits>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include "tinyworld.h"
+
+TINY_NAMESPACE_BEGIN
+
+struct ProtoWire {
+    typedef google::protobuf::io::CodedOutputStream Output;
+    typedef google::protobuf::io::CodedInputStream Input;
+    typedef google::protobuf::internal::WireFormatLite WFL;
+
+    //
+    // Write: tag + value
+    //
+    template<typename V>
+    static typename std::enable_if<std::is_integral<V>::value && std::is_signed<V>::value>::type
+    write(Output &os, int num, V v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_VARINT));
+        if (sizeof(V) <= 4)
+            os.WriteVarint32(WFL::ZigZagEncode32(static_cast<int32_t>(v)));
+        else
+            os.WriteVarint64(WFL::ZigZagEncode64(static_cast<int64_t>(v)));
+    }
+
+    template<typename V>
+    static typename std::enable_if<std::is_integral<V>::value && std::is_unsigned<V>::value>::type
+    write(Output &os, int num, V v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_VARINT));
+        if (sizeof(V) <= 4)
+            os.WriteVarint32(static_cast<uint32_t>(v));
+        else
+            os.WriteVarint64(static_cast<uint64_t>(v));
+    }
+
+    static void write(Output &os, int num, bool v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_VARINT));
+        os.WriteVarint32(v ? 1 : 0);
+    }
+
+    static void write(Output &os, int num, float v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_FIXED32));
+        os.WriteLittleEndian32(WFL::EncodeFloat(v));
+    }
+
+    static void write(Output &os, int num, double v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_FIXED64));
+        os.WriteLittleEndian64(WFL::EncodeDouble(v));
+    }
+
+    static void write(Output &os, int num, const std::string &v) {
+        os.WriteTag(WFL::MakeTag(num, WFL::WIRETYPE_LENGTH_DELIMITED));
+        os.WriteVarint32(static_cast<uint32_t>(v.size()));
+        os.WriteRaw(v.data(), static_cast<int>(v.size()));
+    }
+
+    //
+    // Read: value of the tag already read, false if the wire type mismatched
+    //
+    template<typename V>
+    static typename std::enable_if<std::is_integral<V>::value && std::is_signed<V>::value, bool>::type
+    read(Input &is, uint32_t tag, V &v) {
+        if (WFL::GetTagWireType(tag) != WFL::WIRETYPE_VARINT)
+            return false;
+
+        uint64_t n = 0;
+        if (!is.ReadVarint64(&n))
+            return false;
+
+        if (sizeof(V) <= 4)
+            v = static_cast<V>(WFL::ZigZagDecode32(static_cast<uint32_t>(n)));
+        else
+            v = static_cast<V>(WFL::ZigZagDecode64(n));
+        return true;
+    }
+
+    template<typename V>
+    static typename std::enable_if<std::is_integral<V>::value && std::is_unsigned<V>::value, bool>::type
+    read(Input &is, uint32_t tag, V &v) {
+        if (WFL::GetTagWireType(tag) != WFL::WIRETYPE_VARINT)
+            return false;
+
+        uint64_t n = 0;
+        if (!is.ReadVarint64(&n))
+            return false;
+
+        v = static_cast<V>(n);
+        return true;
+    }
+
+    static bool read(Input &is, uint32_t tag, bool &v) {
+        uint64_t n = 0;
+        if (!read(is, tag, n))
+            return false;
+
+        v = (n != 0);
+        return true;
+    }
+
+    static bool read(Input &is, uint32_t tag, float &v) {
+        uint32_t n = 0;
+        if (WFL::GetTagWireType(tag) != WFL::WIRETYPE_FIXED32 || !is.ReadLittleEndian32(&n))
+            return false;
+
+        v = WFL::DecodeFloat(n);
+        return true;
+    }
+
+    static bool read(Input &is, uint32_t tag, double &v) {
+        uint64_t n = 0;
+        if (WFL::GetTagWireType(tag) != WFL::WIRETYPE_FIXED64 || !is.ReadLittleEndian64(&n))
+            return false;
+
+        v = WFL::DecodeDouble(n);
+        return true;
+    }
+
+    static bool read(Input &is, uint32_t tag, std::string &v) {
+        uint32_t size = 0;
+        if (WFL::GetTagWireType(tag) != WFL::WIRETYPE_LENGTH_DELIMITED || !is.ReadVarint32(&size))
+            return false;
+
+        return is.ReadString(&v, static_cast<int>(size));
+    }
+
+    // unknown field
+    static bool skip(Input &is, uint32_t tag) {
+        return WFL::SkipField(&is, tag);
+    }
+};
+
+TINY_NAMESPACE_END
+
+#endif //TINYWORLD_TINYSERIALIZER_PROTO_WIRE_H
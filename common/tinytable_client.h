@@ -169,7 +169,126 @@ private:
 
 
 //
-// Load data from database/cache
+// MGet Request Handler: one callback with the found values and the nonexist keys
+//
+template<typename T>
+class TableMGetHandler : public TableRequestHandlerBase {
+public:
+    friend class TableClient;
+
+    typedef typename TableMeta<T>::KeyType KeyT;
+    typedef std::function<void(const std::vector<T> &values, const std::vector<KeyT> &nonexist)> DoneCallback;
+    typedef std::function<void(const std::vector<KeyT> &)> ErrorCallback;
+
+    TableMGetHandler(TableClient *client, uint64_t id, uint32_t timeout, const std::vector<KeyT> &keys)
+            : TableRequestHandlerBase(client, id, timeout), keys_(keys) {}
+
+    virtual ~TableMGetHandler() {}
+
+    TableMGetHandler &done(const DoneCallback &callback);
+
+    TableMGetHandler &timeout(const ErrorCallback &callback) {
+        cb_timeout_ = callback;
+        return *this;
+    }
+
+protected:
+    void rpc_done(const tt::MGetReply &reply);
+
+    void rpc_timeout(const tt::MGet &request);
+
+    void rpc_error(const tt::MGet &, rpc::ErrorCode errorCode);
+
+private:
+    std::vector<KeyT> keys_;
+    DoneCallback cb_done_;
+    ErrorCallback cb_timeout_;
+};
+
+
+//
+// MSet Request Handler: one callback with the saved and failed values
+//
+template<typename T>
+class TableMSetHandler : public TableRequestHandlerBase {
+public:
+    friend class TableClient;
+
+    typedef typename TableMeta<T>::KeyType KeyT;
+    typedef std::function<void(const std::vector<T> &saved, const std::vector<T> &failed)> DoneCallback;
+    typedef std::function<void(const std::vector<T> &)> ErrorCallback;
+
+    TableMSetHandler(TableClient *client, uint64_t id, uint32_t timeout, const std::vector<T> &values)
+            : TableRequestHandlerBase(client, id, timeout), values_(values) {}
+
+    virtual ~TableMSetHandler() {}
+
+    TableMSetHandler &done(const DoneCallback &callback);
+
+    TableMSetHandler &timeout(const ErrorCallback &callback) {
+        cb_timeout_ = callback;
+        return *this;
+    }
+
+protected:
+    void rpc_done(const tt::MSetReply &reply);
+
+    void rpc_timeout(const tt::MSet &request);
+
+    void rpc_error(const tt::MSet &request, rpc::ErrorCode errorCode);
+
+private:
+    std::vector<T> values_;
+    DoneCallback cb_done_;
+    ErrorCallback cb_timeout_;
+};
+
+
+//
+// MDel Request Handler: one callback with the deleted and failed keys
+//
+template<typename T>
+class TableMDelHandler : public TableRequestHandlerBase {
+public:
+    friend class TableClient;
+
+    typedef typename TableMeta<T>::KeyType KeyT;
+    typedef std::function<void(const std::vector<KeyT> &deleted, const std::vector<KeyT> &failed)> DoneCallback;
+    typedef std::function<void(const std::vector<KeyT> &)> ErrorCallback;
+
+    TableMDelHandler(TableClient *client, uint64_t id, uint32_t timeout, const std::vector<KeyT> &keys)
+            : TableRequestHandlerBase(client, id, timeout), keys_(keys) {}
+
+    virtual ~TableMDelHandler() {}
+
+    TableMDelHandler &done(const DoneCallback &callback);
+
+    TableMDelHandler &timeout(const ErrorCallback &callback) {
+        cb_timeout_ = callback;
+        return *this;
+    }
+
+protected:
+    void rpc_done(const tt::MDelReply &reply);
+
+    void rpc_timeout(const tt::MDel &request);
+
+    void rpc_error(const tt::MDel &, rpc::ErrorCode errorCode);
+
+private:
+    std::vector<KeyT> keys_;
+    DoneCallback cb_done_;
+    ErrorCallback cb_timeout_;
+};
+
+
+//
+// Load data from database/cache, page by page:
+//   - the next page is requested after the current one is handled,
+//     pause()/resume() holds the stream back while the consumer is busy
+//   - with page(), each page goes to the page callback and done() gets nothing,
+//     otherwise all items are collected and passed to done()
+//   - where(field, value) keeps the items with field = value, before done()
 //
 template<typename T>
 class TableLoadHandler : public TableRequestHandlerBase {
@@ -177,15 +296,30 @@ public:
     friend class TableClient;
 
     typedef std::function<void(const std::vector<T> &value)> DoneCallback;
+    typedef std::function<void(const std::vector<T> &values)> PageCallback;
     typedef std::function<void()> ErrorCallback;
 
-    TableLoadHandler(TableClient *client, uint64_t id, uint32_t timeout, bool direct = true,
-                     const std::string &where = "", bool cache = false)
-            : TableRequestHandlerBase(client, id, timeout), direct_from_db_(direct), where_(where),
-              cache_flag_(cache) {}
+    TableLoadHandler(TableClient *client, uint64_t id, uint32_t timeout, bool direct = true, bool cache = false)
+            : TableRequestHandlerBase(client, id, timeout), direct_from_db_(direct), cache_flag_(cache) {}
 
     virtual ~TableLoadHandler() {}
 
+    TableLoadHandler &page(const PageCallback &callback, uint32_t page_size = 0) {
+        cb_page_ = callback;
+        page_size_ = page_size;
+        return *this;
+    }
+
+    TableLoadHandler &where(const std::string &field, const std::string &value) {
+        filters_.emplace_back(field, value);
+        return *this;
+    }
+
+    template<typename V, typename = typename std::enable_if<std::is_arithmetic<V>::value>::type>
+    TableLoadHandler &where(const std::string &field, V value) {
+        return where(field, std::to_string(value));
+    }
+
     TableLoadHandler &done(const DoneCallback &callback);
 
     TableLoadHandler &timeout(const ErrorCallback &callback) {
@@ -198,7 +332,16 @@ public:
         return *this;
     }
 
+    //
+    // flow control
+    //
+    void pause() { paused_ = true; }
+
+    void resume();
+
 protected:
+    void request();
+
     void rpc_done(const tt::LoadReply &reply);
 
     void rpc_timeout(const tt::LoadRequest &request);
@@ -207,9 +350,19 @@ protected:
 
 private:
     bool direct_from_db_;
-    std::string where_;
     bool cache_flag_;
+    std::vector<std::pair<std::string, std::string>> filters_;
+    uint32_t page_size_ = 0;
+
+    // continuation token of the next page
+    std::string cursor_;
+    bool paused_ = false;
+    bool requesting_ = false;
+
+    std::vector<T> values_;
+
     DoneCallback cb_done_;
+    PageCallback cb_page_;
     ErrorCallback cb_timeout_;
     ErrorCallback cb_error_;
 };
@@ -244,6 +397,32 @@ public:
         return *handler.get();
     }
 
+    //
+    // mget / mset / mdel : many items of one table in one round trip
+    //
+    template<typename T>
+    TableMGetHandler<T> &
+    mget(const std::vector<typename TableMeta<T>::KeyType> &keys, uint32_t timeout_ms) {
+        auto handler = std::make_shared<TableMGetHandler<T>>(this, ++total_id_, timeout_ms, keys);
+        handlers_[handler->id()] = handler;
+        return *handler.get();
+    }
+
+    template<typename T>
+    TableMSetHandler<T> &
+    mset(const std::vector<T> &values, uint32_t timeout_ms) {
+        auto handler = std::make_shared<TableMSetHandler<T>>(this, ++total_id_, timeout_ms, values);
+        handlers_[handler->id()] = handler;
+        return *handler.get();
+    }
+
+    template<typename T>
+    TableMDelHandler<T> &
+    mdel(const std::vector<typename TableMeta<T>::KeyType> &keys, uint32_t timeout_ms) {
+        auto handler = std::make_shared<TableMDelHandler<T>>(this, ++total_id_, timeout_ms, keys);
+        handlers_[handler->id()] = handler;
+        return *handler.get();
+    }
 
     //
     // load data from cache
@@ -252,13 +431,13 @@ public:
     TableLoadHandler<T> &load(uint32_t timeout_ms);
 
     //
-    // load data from database
+    // load data from database, filtered by where() of the handler
     //
     template<typename T>
-    TableLoadHandler<T> &loadFromDB(const char *clause, ...);
+    TableLoadHandler<T> &loadFromDB(uint32_t timeout_ms = 1000);
 
     template<typename T>
-    TableLoadHandler<T> &loadFromDBAndCache(const char *clause, ...);
+    TableLoadHandler<T> &loadFromDBAndCache(uint32_t timeout_ms = 1000);
 
 
 public:
@@ -267,7 +446,7 @@ public:
     }
 
     template<typename T>
-    TableLoadHandler<T> &vLoad(uint32_t timeout_ms, bool direct, bool cacheit, const char *clause, va_list ap);
+    TableLoadHandler<T> &newLoad(uint32_t timeout_ms, bool direct, bool cacheit);
 
 private:
     typedef std::unordered_map<uint64_t, TableRequestHandlerPtr> TableRequestHandlerMap;
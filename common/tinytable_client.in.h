@@ -160,30 +160,229 @@ void TableDelHandler<T>::rpc_error(const tt::Del &, rpc::ErrorCode errorCode) {
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+template<typename T>
+TableMGetHandler<T> &TableMGetHandler<T>::done(const DoneCallback &callback) {
+    cb_done_ = callback;
+
+    tt::MGet request;
+    request.set_type(TableMeta<T>::name());
+    for (auto &key : keys_)
+        request.add_keys(serialize(key));
+    client_->template emit<tt::MGet, tt::MGetReply>(request)
+            .done(std::bind(&TableMGetHandler::rpc_done, this, std::placeholders::_1))
+            .timeout(std::bind(&TableMGetHandler::rpc_timeout, this, std::placeholders::_1), timeout_ms_)
+            .error(std::bind(&TableMGetHandler::rpc_error, this, std::placeholders::_1, std::placeholders::_2));
+
+    return *this;
+}
+
+template<typename T>
+void TableMGetHandler<T>::rpc_done(const tt::MGetReply &reply) {
+    if (cb_done_) {
+        std::vector<T> values;
+        std::vector<KeyT> nonexist;
+        for (int i = 0; i < reply.items_size(); ++i) {
+            const tt::GetReply &item = reply.items(i);
+
+            T value;
+            if (item.retcode() == 0 && deserialize(value, item.value())) {
+                values.push_back(value);
+            } else {
+                KeyT key;
+                if (deserialize(key, item.key()))
+                    nonexist.push_back(key);
+            }
+        }
+        cb_done_(values, nonexist);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMGetHandler<T>::rpc_timeout(const tt::MGet &request) {
+    if (cb_timeout_) {
+        cb_timeout_(keys_);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMGetHandler<T>::rpc_error(const tt::MGet &, rpc::ErrorCode errorCode) {
+    std::cout << rpc::ErrorCode_Name(errorCode) << std::endl;
+    client_->removeHandler(this->id());
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+TableMSetHandler<T> &TableMSetHandler<T>::done(const DoneCallback &callback) {
+    cb_done_ = callback;
+
+    tt::MSet request;
+    request.set_type(TableMeta<T>::name());
+    for (auto &value : values_) {
+        request.add_keys(serialize(TableMeta<T>::tableKey(value)));
+        request.add_values(serialize(value));
+    }
+    client_->template emit<tt::MSet, tt::MSetReply>(request)
+            .done(std::bind(&TableMSetHandler::rpc_done, this, std::placeholders::_1))
+            .timeout(std::bind(&TableMSetHandler::rpc_timeout, this, std::placeholders::_1), timeout_ms_)
+            .error(std::bind(&TableMSetHandler::rpc_error, this, std::placeholders::_1, std::placeholders::_2));
+
+    return *this;
+}
+
+template<typename T>
+void TableMSetHandler<T>::rpc_done(const tt::MSetReply &reply) {
+    if (cb_done_) {
+        std::vector<T> saved;
+        std::vector<T> failed;
+        for (size_t i = 0; i < values_.size(); ++i) {
+            if (i < (size_t) reply.retcodes_size() && reply.retcodes(i) == 0)
+                saved.push_back(values_[i]);
+            else
+                failed.push_back(values_[i]);
+        }
+        cb_done_(saved, failed);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMSetHandler<T>::rpc_timeout(const tt::MSet &request) {
+    if (cb_timeout_) {
+        cb_timeout_(values_);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMSetHandler<T>::rpc_error(const tt::MSet &request, rpc::ErrorCode errorCode) {
+    std::cout << rpc::ErrorCode_Name(errorCode) << std::endl;
+    client_->removeHandler(this->id());
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+TableMDelHandler<T> &TableMDelHandler<T>::done(const DoneCallback &callback) {
+    cb_done_ = callback;
+
+    tt::MDel request;
+    request.set_type(TableMeta<T>::name());
+    for (auto &key : keys_)
+        request.add_keys(serialize(key));
+    client_->template emit<tt::MDel, tt::MDelReply>(request)
+            .done(std::bind(&TableMDelHandler::rpc_done, this, std::placeholders::_1))
+            .timeout(std::bind(&TableMDelHandler::rpc_timeout, this, std::placeholders::_1), timeout_ms_)
+            .error(std::bind(&TableMDelHandler::rpc_error, this, std::placeholders::_1, std::placeholders::_2));
+
+    return *this;
+}
+
+template<typename T>
+void TableMDelHandler<T>::rpc_done(const tt::MDelReply &reply) {
+    if (cb_done_) {
+        std::vector<KeyT> deleted;
+        std::vector<KeyT> failed;
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (i < (size_t) reply.retcodes_size() && reply.retcodes(i) == 0)
+                deleted.push_back(keys_[i]);
+            else
+                failed.push_back(keys_[i]);
+        }
+        cb_done_(deleted, failed);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMDelHandler<T>::rpc_timeout(const tt::MDel &request) {
+    if (cb_timeout_) {
+        cb_timeout_(keys_);
+    }
+    client_->removeHandler(this->id());
+}
+
+template<typename T>
+void TableMDelHandler<T>::rpc_error(const tt::MDel &, rpc::ErrorCode errorCode) {
+    std::cout << rpc::ErrorCode_Name(errorCode) << std::endl;
+    client_->removeHandler(this->id());
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
 
 template<typename T>
 TableLoadHandler<T> &TableLoadHandler<T>::done(const DoneCallback &callback) {
     cb_done_ = callback;
+    request();
+    return *this;
+}
+
+template<typename T>
+void TableLoadHandler<T>::resume() {
+    paused_ = false;
+    if (!requesting_)
+        request();
+}
+
+template<typename T>
+void TableLoadHandler<T>::request() {
     tt::LoadRequest request;
     request.set_type(TableMeta<T>::name());
     request.set_direct(direct_from_db_);
     request.set_cacheit(cache_flag_);
-    if (where_.size()) request.set_where(where_);
+    for (auto &filter : filters_) {
+        tt::LoadFilter *f = request.add_filters();
+        f->set_field(filter.first);
+        f->set_value(filter.second);
+    }
+    if (cursor_.size()) request.set_cursor(cursor_);
+    if (page_size_) request.set_page_size(page_size_);
+
+    requesting_ = true;
     client_->template emit<tt::LoadRequest, tt::LoadReply>(request)
             .done(std::bind(&TableLoadHandler::rpc_done, this, std::placeholders::_1))
             .timeout(std::bind(&TableLoadHandler::rpc_timeout, this, std::placeholders::_1), timeout_ms_)
             .error(std::bind(&TableLoadHandler::rpc_error, this, std::placeholders::_1, std::placeholders::_2));
-    return *this;
 }
 
 template<typename T>
 void TableLoadHandler<T>::rpc_done(const tt::LoadReply &reply) {
+    requesting_ = false;
+
+    if (reply.retcode() != 0) {
+        if (cb_error_)
+            cb_error_();
+        client_->removeHandler(this->id());
+        return;
+    }
+
     std::vector<T> values;
-    if (deserialize(values, reply.values())) {
-        cb_done_(values);
+    values.reserve(reply.values_size());
+    for (int i = 0; i < reply.values_size(); ++i) {
+        T value;
+        if (deserialize(value, reply.values(i)))
+            values.push_back(value);
     }
 
-    client_->removeHandler(this->id());
+    if (cb_page_)
+        cb_page_(values);
+    else
+        values_.insert(values_.end(), values.begin(), values.end());
+
+    // no cursor means no more pages
+    if (reply.finished() || reply.cursor().empty()) {
+        if (cb_done_)
+            cb_done_(values_);
+        client_->removeHandler(this->id());
+        return;
+    }
+
+    cursor_ = reply.cursor();
+    if (!paused_)
+        request();
 }
 
 template<typename T>
@@ -203,41 +402,25 @@ void TableLoadHandler<T>::rpc_error(const tt::LoadRequest &request, rpc::ErrorCo
 ///////////////////////////////////////////////////////////////////////////////////
 
 template<typename T>
-TableLoadHandler<T> &
-TableClient::vLoad(uint32_t timeout_ms, bool direct, bool cacheit, const char *clause, va_list ap) {
-    char statement[1024] = "";
-    if (clause) {
-        vsnprintf(statement, sizeof(statement), clause, ap);
-    }
-
-    auto handler = std::make_shared<TableLoadHandler<T>>(this, ++total_id_, timeout_ms, direct, statement, cacheit);
+TableLoadHandler<T> &TableClient::newLoad(uint32_t timeout_ms, bool direct, bool cacheit) {
+    auto handler = std::make_shared<TableLoadHandler<T>>(this, ++total_id_, timeout_ms, direct, cacheit);
     handlers_[handler->id()] = handler;
     return *handler.get();
 }
 
 template<typename T>
 TableLoadHandler<T> &TableClient::load(uint32_t timeout_ms) {
-    auto handler = std::make_shared<TableLoadHandler<T>>(this, ++total_id_, timeout_ms, false, "", false);
-    handlers_[handler->id()] = handler;
-    return *handler.get();
+    return newLoad<T>(timeout_ms, false, false);
 }
 
 template<typename T>
-TableLoadHandler<T> &TableClient::loadFromDB(const char *clause, ...) {
-    va_list ap;
-    va_start(ap, clause);
-    TableLoadHandler<T> &ret = vLoad<T>(1000, false, false, clause, ap);
-    va_end(ap);
-    return ret;
+TableLoadHandler<T> &TableClient::loadFromDB(uint32_t timeout_ms) {
+    return newLoad<T>(timeout_ms, true, false);
 }
 
 template<typename T>
-TableLoadHandler<T> &TableClient::loadFromDBAndCache(const char *clause, ...) {
-    va_list ap;
-    va_start(ap, clause);
-    TableLoadHandler<T> &ret = vLoad<T>(1000, false, true, clause, ap);
-    va_end(ap);
-    return ret;
+TableLoadHandler<T> &TableClient::loadFromDBAndCache(uint32_t timeout_ms) {
+    return newLoad<T>(timeout_ms, true, true);
 }
 
 #endif //TINYWORLD_TINYTABLE_IN_H
@@ -22,7 +22,15 @@
 #define TINYWORLD_TINYTABLE_SERVER_H
 
 #include <unordered_map>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <condition_variable>
 #include "tinylogger.h"
 #include "tinytable.h"
 #include "tinytable.pb.h"
@@ -31,6 +39,13 @@
 #include "tinyrpc_server.h"
 #include "zmq_server.h"
 
+// page size of LoadRequest
+#define TINYTABLE_LOAD_PAGE_DEFAULT 200
+#define TINYTABLE_LOAD_PAGE_MAX     1000
+
+// idle snapshot of a paged load is dropped after (ms)
+#define TINYTABLE_LOAD_SESSION_TIMEOUT 60000
+
 TINY_NAMESPACE_BEGIN
 
 class TinyTableFactory;
@@ -46,6 +61,17 @@ public:
 
     virtual bool proceeDel(const tt::Del &request, tt::DelReply &reply) = 0;
 
+    virtual bool processMGet(const tt::MGet &request, tt::MGetReply &reply) = 0;
+
+    virtual bool proceeMSet(const tt::MSet &request, tt::MSetReply &reply) = 0;
+
+    virtual bool proceeMDel(const tt::MDel &request, tt::MDelReply &reply) = 0;
+
+    virtual bool processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) = 0;
+
+    // table statistics, empty if none
+    virtual std::string statString() { return ""; }
+
     const std::string &name() { return name_; }
 
     MySqlConnectionPool *dbpool() { return db_pool_; }
@@ -60,6 +86,61 @@ public:
         return TableMeta<T>::tableKey(*object.get());
     }
 
+    // page size of the LoadRequest, limited by TINYTABLE_LOAD_PAGE_MAX
+    static uint32_t pageSize(const tt::LoadRequest &request) {
+        if (request.page_size() == 0)
+            return TINYTABLE_LOAD_PAGE_DEFAULT;
+        return std::min<uint32_t>(request.page_size(), TINYTABLE_LOAD_PAGE_MAX);
+    }
+
+    //
+    // Conditions of a LoadRequest, checked against the table: the values are
+    // parsed by the column codec, kept as the column text for the query and
+    // compared to the items of memory tables
+    //
+    template<typename T>
+    struct LoadFilters {
+        TinyORM::FieldFilters fields;
+        std::vector<FieldCodec<T> *> codecs;
+
+        bool match(const T &obj) const {
+            std::string buf;
+            for (size_t i = 0; i < codecs.size(); ++i) {
+                if (codecs[i]->text(obj, buf) != fields[i].second)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // false for raw where or unknown fields/invalid values (retcode 12)
+    template<typename T>
+    static bool loadFilters(const tt::LoadRequest &request, LoadFilters<T> &filters);
+
+protected:
+    //
+    // Batch helpers shared by all tables
+    //
+
+    // load the objects of keys with one query, indexed by serialized key
+    template<typename T>
+    static bool selectMany(MySqlConnectionPool *pool, const std::vector<typename TableMeta<T>::KeyType> &keys,
+                           std::unordered_map<std::string, std::shared_ptr<T>> &objects);
+
+    // MSet: one multi-row REPLACE, updated is called with the decoded objects before writing db
+    template<typename T>
+    static bool replaceMany(MySqlConnectionPool *pool, const tt::MSet &request, tt::MSetReply &reply,
+                            const std::function<void(const TinyORM::Records<T> &)> &updated = nullptr);
+
+    // MDel: one DELETE ... WHERE key IN (...)
+    template<typename T>
+    static bool delMany(MySqlConnectionPool *pool, const tt::MDel &request, tt::MDelReply &reply);
+
+    // Load: one page from db ordered by key, cursor is the last key of the page
+    template<typename T>
+    static bool loadPage(MySqlConnectionPool *pool, const tt::LoadRequest &request, tt::LoadReply &reply,
+                         const LoadFilters<T> &filters, TinyORM::Records<T> *loaded = nullptr);
+
 protected:
     std::string name_;
     MySqlConnectionPool *db_pool_;
@@ -67,6 +148,35 @@ protected:
 
 typedef std::shared_ptr<TinyTableBase> TinyTablePtr;
 
+//
+// Paged loading of memory tables:
+//   the first page takes a snapshot of the items, following pages
+//   are served from it by the cursor("id:pos")
+//
+template<typename T>
+class TableLoadSessions {
+public:
+    typedef std::shared_ptr<T> ObjectPtr;
+    typedef std::vector<ObjectPtr> Snapshot;
+    typedef std::function<void(Snapshot &)> SnapshotCallback;
+
+    bool nextPage(const tt::LoadRequest &request, tt::LoadReply &reply, const SnapshotCallback &snapshot);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Session {
+        std::shared_ptr<Snapshot> objects;
+        Clock::time_point active;
+    };
+
+    void expire(Clock::time_point now);
+
+    std::mutex mutex_;
+    uint64_t lastid_ = 0;
+    std::unordered_map<uint64_t, Session> sessions_;
+};
+
 
 template<typename T>
 class TinyDBTable : public TinyTableBase {
@@ -82,6 +192,14 @@ public:
     bool proceeSet(const tt::Set &request, tt::SetReply &reply) final;
 
     bool proceeDel(const tt::Del &request, tt::DelReply &reply) final;
+
+    bool processMGet(const tt::MGet &request, tt::MGetReply &reply) final;
+
+    bool proceeMSet(const tt::MSet &request, tt::MSetReply &reply) final;
+
+    bool proceeMDel(const tt::MDel &request, tt::MDelReply &reply) final;
+
+    bool processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) final;
 };
 
 
@@ -95,6 +213,7 @@ public:
             : TinyTableBase(name, pool) {}
 
     ObjectPtr getObjectInMemory(const KeyType &key) {
+        std::lock_guard<std::mutex> guard(mutex_);
         auto it = items_.find(key);
         if (it != items_.end())
             return it->second;
@@ -107,18 +226,57 @@ public:
 
     bool proceeDel(const tt::Del &request, tt::DelReply &reply) final;
 
+    bool processMGet(const tt::MGet &request, tt::MGetReply &reply) final;
+
+    bool proceeMSet(const tt::MSet &request, tt::MSetReply &reply) final;
+
+    bool proceeMDel(const tt::MDel &request, tt::MDelReply &reply) final;
+
+    bool processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) final;
+
 private:
+    // items_ may be accessed by several ThreadedTableServer workers
+    std::mutex mutex_;
     std::unordered_map<KeyType, ObjectPtr> items_;
+
+    TableLoadSessions<T> loads_;
+};
+
+//
+// Statistics of TinyCacheTable
+//
+struct TableCacheStat {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    // hits of the keys not exist in db
+    std::atomic<uint64_t> negative_hits{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> expired{0};
+    // cached items and their serialized size(plus a fixed cost per item)
+    std::atomic<uint64_t> items{0};
+    std::atomic<uint64_t> bytes{0};
 };
 
+//
+// Cache Table:
+//   - items expire after expired_ms (-1: never)
+//   - bytes budget(0: unlimited), expired items swept then approximate LRU by sampling when over budget
+//   - keys not exist in db are cached negatively for negative_ms
+//   - concurrent misses of the same key query the db only once (single-flight)
+//   - a write of a key during its query keeps the query result out of the cache and from the waiters
+//
 template<typename T>
 class TinyCacheTable : public TinyTableBase {
 public:
     typedef typename TableMeta<T>::KeyType KeyType;
     typedef std::shared_ptr<T> ObjectPtr;
 
-    TinyCacheTable(const std::string &name, MySqlConnectionPool *pool)
-            : TinyTableBase(name, pool) {}
+    TinyCacheTable(const std::string &name, MySqlConnectionPool *pool,
+                   uint32_t expired_ms = static_cast<uint32_t>(-1),
+                   size_t max_bytes = 0,
+                   uint32_t negative_ms = 1000)
+            : TinyTableBase(name, pool),
+              expired_ms_(expired_ms), max_bytes_(max_bytes), negative_ms_(negative_ms) {}
 
     bool processGet(const tt::Get &request, tt::GetReply &reply) final;
 
@@ -126,12 +284,21 @@ public:
 
     bool proceeDel(const tt::Del &request, tt::DelReply &reply) final;
 
+    bool processMGet(const tt::MGet &request, tt::MGetReply &reply) final;
+
+    bool proceeMSet(const tt::MSet &request, tt::MSetReply &reply) final;
+
+    bool proceeMDel(const tt::MDel &request, tt::MDelReply &reply) final;
+
+    bool processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) final;
+
+    std::string statString() final;
+
 public:
     ObjectPtr getObjectInMemory(const KeyType &key) {
-        auto it = items_.find(key);
-        if (it != items_.end())
-            return it->second;
-        return nullptr;
+        std::lock_guard<std::mutex> guard(mutex_);
+        bool negative = false;
+        return lookup(key, negative);
     }
 
     void setKey(ObjectPtr object, const KeyType &key) {
@@ -142,13 +309,87 @@ public:
         return TableMeta<T>::tableKey(*object.get());
     }
 
+    const TableCacheStat &stats() const { return stats_; }
+
 private:
-    std::unordered_map<KeyType, ObjectPtr> items_;
+    struct Entry {
+        // nullptr: not exist in db
+        ObjectPtr object;
+        // steady clock(ms), 0: never expire
+        int64_t expire = 0;
+        // access tick, for LRU
+        uint64_t access = 0;
+        size_t bytes = 0;
+    };
+
+    // single-flight of the db query for a missing key
+    struct Flight {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool done = false;
+        ObjectPtr object;
+        std::string value;
+        // the key was written during the query(mutex_ of the table)
+        bool stale = false;
+        // the followers query again(mutex of the flight)
+        bool retry = false;
+    };
+
+    typedef std::unordered_map<KeyType, Entry> EntryMap;
+
+    // charged for each entry besides its serialized size
+    static const size_t kEntryBytes = sizeof(Entry) + sizeof(KeyType) + 32;
+    // full sweeps of the expired entries when over budget, at most once per interval
+    static const int64_t kSweepIntervalMs = 1000;
+
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // following xxx(...) must be called with mutex_ locked
+    ObjectPtr lookup(const KeyType &key, bool &negative);
+
+    void insert(const KeyType &key, ObjectPtr object, size_t bytes);
+
+    void update(const KeyType &key, ObjectPtr object, size_t bytes);
+
+    void erase(typename EntryMap::iterator it);
+
+    void evict();
+
+    // a write of the key: its flight is detached, and the cached entry dropped unless it holds keep
+    void invalidate(const KeyType &key, ObjectPtr keep);
+
+    // load from db (single-flight) and cache it
+    ObjectPtr load(const KeyType &key, std::string &value);
+
+private:
+    uint32_t expired_ms_;
+    size_t max_bytes_;
+    uint32_t negative_ms_;
+
+    // items_ may be accessed by several ThreadedTableServer workers
+    std::mutex mutex_;
+    EntryMap items_;
+    uint64_t tick_ = 0;
+    int64_t last_sweep_ = 0;
+    std::minstd_rand random_;
+
+    std::unordered_map<KeyType, std::shared_ptr<Flight>> flights_;
+    // bumped by every invalidate(), MGet caches its misses only if unchanged over the query
+    uint64_t generation_ = 0;
+
+    TableCacheStat stats_;
+
+    TableLoadSessions<T> loads_;
 };
 
 
 class TinyTableFactory {
 public:
+    typedef std::unordered_map<std::string, TinyTablePtr> TinyTableMap;
+
     static TinyTableFactory &instance() {
         static TinyTableFactory factory;
         return factory;
@@ -175,9 +416,11 @@ public:
     }
 
     template<typename T>
-    TinyTableFactory &cacheTable(uint32_t expired_ms = static_cast<uint32_t >(-1)) {
+    TinyTableFactory &cacheTable(uint32_t expired_ms = static_cast<uint32_t >(-1),
+                                 size_t max_bytes = 0,
+                                 uint32_t negative_ms = 1000) {
         std::string name = TableMeta<T>::name();
-        TinyTablePtr ptr = std::make_shared<TinyCacheTable<T>>(name, &mysql_);
+        TinyTablePtr ptr = std::make_shared<TinyCacheTable<T>>(name, &mysql_, expired_ms, max_bytes, negative_ms);
         tables_.insert(std::make_pair(name, ptr));
         return *this;
     }
@@ -204,6 +447,46 @@ public:
         return false;
     }
 
+    bool processMGet(const tt::MGet &request, tt::MGetReply &reply) {
+        auto table = getTableByName(request.type());
+        if (table)
+            return table->processMGet(request, reply);
+        return false;
+    }
+
+    bool proceeMSet(const tt::MSet &request, tt::MSetReply &reply) {
+        auto table = getTableByName(request.type());
+        if (table)
+            return table->proceeMSet(request, reply);
+        return false;
+    }
+
+    bool proceeMDel(const tt::MDel &request, tt::MDelReply &reply) {
+        auto table = getTableByName(request.type());
+        if (table)
+            return table->proceeMDel(request, reply);
+        return false;
+    }
+
+    bool processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) {
+        auto table = getTableByName(request.type());
+        if (table)
+            return table->processLoad(request, reply);
+        reply.set_retcode(1);
+        return false;
+    }
+
+    // name:stats ... of all tables
+    std::string statString() {
+        std::ostringstream oss;
+        for (auto &table : tables_) {
+            std::string stat = table.second->statString();
+            if (stat.size())
+                oss << table.first << ":" << stat << " ";
+        }
+        return oss.str();
+    }
+
     TinyTablePtr getTableByName(const std::string &name) {
         auto it = tables_.find(name);
         if (it != tables_.end())
@@ -211,45 +494,241 @@ public:
         return nullptr;
     }
 
+    const TinyTableMap &tables() const { return tables_; }
+
 private:
-    typedef std::unordered_map<std::string, TinyTablePtr> TinyTableMap;
     TinyTableMap tables_;
 
     MySqlConnectionPool mysql_;
 };
 
+//
+// Bind tinytable's get/set/del, mget/mset/mdel and load to the rpc dispatcher
+//
+inline void bindTableRPC(RPCDispatcher &dispatcher, TinyTableFactory *factory) {
+    dispatcher.on<tt::Get, tt::GetReply>([factory](const tt::Get &request) {
+        tt::GetReply reply;
+        reply.set_type(request.type());
+        reply.set_key(request.key());
+        factory->processGet(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::Set, tt::SetReply>([factory](const tt::Set &request) {
+        tt::SetReply reply;
+        reply.set_type(request.type());
+        factory->proceeSet(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::Del, tt::DelReply>([factory](const tt::Del &request) {
+        tt::DelReply reply;
+        reply.set_type(request.type());
+        factory->proceeDel(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::MGet, tt::MGetReply>([factory](const tt::MGet &request) {
+        tt::MGetReply reply;
+        reply.set_type(request.type());
+        factory->processMGet(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::MSet, tt::MSetReply>([factory](const tt::MSet &request) {
+        tt::MSetReply reply;
+        reply.set_type(request.type());
+        factory->proceeMSet(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::MDel, tt::MDelReply>([factory](const tt::MDel &request) {
+        tt::MDelReply reply;
+        reply.set_type(request.type());
+        factory->proceeMDel(request, reply);
+        return reply;
+    });
+
+    dispatcher.on<tt::LoadRequest, tt::LoadReply>([factory](const tt::LoadRequest &request) {
+        tt::LoadReply reply;
+        reply.set_type(request.type());
+        factory->processLoad(request, reply);
+        return reply;
+    });
+}
+
+//
+// Single-threaded TableServer: requests are processed on the poll thread
+//
 class TableServer : public AsyncRPCServer<ZMQAsyncServer> {
 public:
     TableServer(TinyTableFactory *factory = &TinyTableFactory::instance())
             : factory_(factory) {
-
-        on<tt::Get, tt::GetReply>([this](const tt::Get &request) {
-            tt::GetReply reply;
-            reply.set_type(request.type());
-            reply.set_key(request.key());
-            this->factory_->processGet(request, reply);
-            return reply;
-        });
-
-        on<tt::Set, tt::SetReply>([this](const tt::Set &request) {
-            tt::SetReply reply;
-            reply.set_type(request.type());
-            this->factory_->proceeSet(request, reply);
-            return reply;
-        });
-
-        on<tt::Del, tt::DelReply>([this](const tt::Del &request) {
-            tt::DelReply reply;
-            reply.set_type(request.type());
-            this->factory_->proceeDel(request, reply);
-            return reply;
-        });
+        bindTableRPC(rpcDispatcher(), factory_);
     }
 
 private:
     TinyTableFactory *factory_ = nullptr;
 };
 
+//
+// Per-table queue depth of ThreadedTableServer
+//
+struct TableQueueStat {
+    // requests queued or in processing
+    std::atomic<uint32_t> pending{0};
+    // high-water mark of pending
+    std::atomic<uint32_t> max_pending{0};
+    // requests processed
+    std::atomic<uint64_t> processed{0};
+};
+
+typedef std::shared_ptr<TableQueueStat> TableQueueStatPtr;
+typedef std::unordered_map<std::string, TableQueueStatPtr> TableQueueStatMap;
+
+//
+// Worker thread of ThreadedTableServer:
+//   PULL(inproc) [client][table][request] -> process -> PUSH(inproc) [client][reply]
+//
+class TableWorker {
+public:
+    TableWorker(zmq::context_t &context, size_t index, TinyTableFactory *factory, TableQueueStatMap &stats);
+
+    void run(const std::atomic<bool> &running);
+
+    static std::string address(size_t index) {
+        return "inproc://tinytable.worker." + std::to_string(index);
+    }
+
+    static std::string replyAddress() {
+        return "inproc://tinytable.reply";
+    }
+
+protected:
+    void doMsgRequest(const rpc::Request &request, const std::string &client);
+
+private:
+    zmq::context_t &context_;
+    size_t index_;
+    TableQueueStatMap &stats_;
+
+    std::shared_ptr<zmq::socket_t> reply_socket_;
+
+    RPCDispatcher rpc_dispatcher_;
+    MessageNameDispatcher<const std::string &> msg_dispatcher_;
+};
+
+//
+// Multi-threaded TableServer:
+//
+//   clients <-> ROUTER(poll thread) --PUSH(inproc)--> TableWorker[hash(table, key) % N]
+//                                   <--PULL(inproc)-- TableWorker[...]
+//
+//  - requests of the same (table, key) always go to the same worker, so per-key order is kept
+//  - mget/mset/mdel are split by the worker of each key, the parts' replies are merged
+//    back in the order of the keys (on the poll thread) before the client gets one reply
+//  - replies are routed back to the client by the ROUTER identity
+//  - a slow table(eg. blocking MySQL) only stalls the requests hashed to the same worker
+//
+class ThreadedTableServer {
+public:
+    ThreadedTableServer(size_t workernum = 4, TinyTableFactory *factory = &TinyTableFactory::instance());
+
+    ~ThreadedTableServer();
+
+    bool bind(const std::string &address);
+
+    bool poll(long timeout = -1);
+
+    void stop();
+
+    void setPollBudget(size_t budget) { budget_ = budget ? budget : 1; }
+
+    // a split request whose parts are not all back by then is dropped
+    void setSplitTimeout(int64_t ms) { split_timeout_ms_ = ms; }
+
+    // queued/processing requests of the table
+    uint32_t queueDepth(const std::string &table);
+
+    // table:pending/max/processed ...
+    std::string statString();
+
+protected:
+    // pick the worker by (table, key), rpc_request is the parsed request if any
+    size_t route(zmq::message_t &request, std::string &table, rpc::Request &rpc_request);
+
+    size_t workerOf(const std::string &table, const std::string &key) {
+        std::hash<std::string> hasher;
+        return (hasher(table) * 31 + hasher(key)) % workernum_;
+    }
+
+    void dispatchRequests();
+
+    void forwardReplies();
+
+    void sendToWorker(size_t worker, zmq::message_t &idmsg, const std::string &table, zmq::message_t &request);
+
+    //
+    // A multi-key request over several workers: each part goes to the
+    // worker of its keys tagged with the split, the reply is sent once all
+    // parts are back
+    //
+    struct Split {
+        std::string client;
+        rpc::Request request;   // id and names of the reply
+        std::string table;
+        size_t total = 0;       // keys of the request
+        std::vector<std::vector<int>> positions;    // of the keys of each part
+        std::vector<rpc::Reply> parts;
+        size_t waiting = 0;
+        int64_t started = 0;    // steady clock(ms)
+    };
+
+    typedef std::unordered_map<uint64_t, Split> SplitMap;
+
+    // false if all keys belong to one worker, sent as is
+    bool split(const rpc::Request &rpc_request, const std::string &table);
+
+    template<typename MultiT>
+    bool splitKeys(const rpc::Request &rpc_request, const std::string &table);
+
+    // reply of a part, true if it was one
+    bool splitReplied(zmq::message_t &idmsg, zmq::message_t &reply);
+
+    void mergeReplies(Split &split, rpc::Reply &merged);
+
+    // all parts are back, the merged reply to the client
+    void replySplit(SplitMap::iterator it);
+
+    // the splits of a worker that never answered, swept at most once a second
+    void expireSplits();
+
+private:
+    size_t workernum_;
+    TinyTableFactory *factory_;
+    size_t budget_;
+
+    std::atomic<bool> running_;
+
+    zmq::context_t context_;
+    std::shared_ptr<zmq::socket_t> frontend_;
+    std::shared_ptr<zmq::socket_t> replies_;
+    std::vector<std::shared_ptr<zmq::socket_t>> workers_;
+    std::vector<std::thread> threads_;
+
+    TableQueueStatMap stats_;
+    std::string rpc_request_name_;
+
+    zmq::message_t idmsg_;
+    zmq::message_t empty_;
+    zmq::message_t request_;
+
+    SplitMap splits_;
+    uint64_t lastsplit_ = 0;
+    int64_t split_timeout_ms_ = 30000;
+    int64_t last_expire_ = 0;
+};
+
 #include "tinytable_server.in.h"
 
 TINY_NAMESPACE_END
@@ -21,10 +21,235 @@
 #ifndef TINYWORLD_TINYTABLE_SERVER_IN_H
 #define TINYWORLD_TINYTABLE_SERVER_IN_H
 
+template<typename T>
+bool TinyTableBase::selectMany(MySqlConnectionPool *pool, const std::vector<typename TableMeta<T>::KeyType> &keys,
+                               std::unordered_map<std::string, std::shared_ptr<T>> &objects) {
+    if (keys.empty())
+        return true;
+
+    TinyORM::Records<T> objs;
+    objs.reserve(keys.size());
+    for (auto &key : keys) {
+        auto obj = std::make_shared<T>();
+        setObjectKey(obj, key);
+        objs.push_back(obj);
+    }
+
+    TinyORM db(pool);
+    return db.selectMany<T>(objs, [&objects](std::shared_ptr<T> obj) {
+        objects[serialize(getObjectKey(obj))] = obj;
+    });
+}
+
+template<typename T>
+bool TinyTableBase::replaceMany(MySqlConnectionPool *pool, const tt::MSet &request, tt::MSetReply &reply,
+                                const std::function<void(const TinyORM::Records<T> &)> &updated) {
+    TinyORM::Records<T> objs;
+    std::vector<int> index;
+
+    for (int i = 0; i < request.values_size(); ++i) {
+        reply.add_keys(i < request.keys_size() ? request.keys(i) : "");
+
+        auto obj = std::make_shared<T>();
+        if (!deserialize(*obj.get(), request.values(i))) {
+            reply.add_retcodes(11);
+            continue;
+        }
+
+        reply.add_retcodes(1);
+        objs.push_back(obj);
+        index.push_back(i);
+    }
+
+    if (updated)
+        updated(objs);
+
+    TinyORM db(pool);
+    bool ret = db.replaceMany<T>(objs);
+    for (auto i : index)
+        reply.set_retcodes(i, ret ? 0 : 1);
+    return ret;
+}
+
+template<typename T>
+bool TinyTableBase::delMany(MySqlConnectionPool *pool, const tt::MDel &request, tt::MDelReply &reply) {
+    TinyORM::Records<T> objs;
+    std::vector<int> index;
+
+    for (int i = 0; i < request.keys_size(); ++i) {
+        reply.add_keys(request.keys(i));
+
+        typename TableMeta<T>::KeyType key;
+        if (!deserialize(key, request.keys(i))) {
+            reply.add_retcodes(11);
+            continue;
+        }
+
+        auto obj = std::make_shared<T>();
+        setObjectKey(obj, key);
+
+        reply.add_retcodes(1);
+        objs.push_back(obj);
+        index.push_back(i);
+    }
+
+    TinyORM db(pool);
+    bool ret = db.delMany<T>(objs);
+    for (auto i : index)
+        reply.set_retcodes(i, ret ? 0 : 1);
+    return ret;
+}
+
+template<typename T>
+bool TinyTableBase::loadFilters(const tt::LoadRequest &request, LoadFilters<T> &filters) {
+    if (request.where().size())
+        return false;
+
+    auto td = TableFactory::instance().tableByType<T>();
+    if (!td)
+        return false;
+
+    for (int i = 0; i < request.filters_size(); ++i) {
+        const tt::LoadFilter &filter = request.filters(i);
+        FieldDescriptor::Ptr fd = td->getFieldDescriptor(filter.field());
+        FieldCodec<T> *codec = fd ? td->codec(fd->ordinal) : nullptr;
+        if (!codec)
+            return false;
+
+        T scratch;
+        std::string buf;
+        if (!codec->decode(scratch, filter.value().data(), filter.value().size()))
+            return false;
+
+        filters.fields.emplace_back(fd->name, codec->text(scratch, buf));
+        filters.codecs.push_back(codec);
+    }
+    return true;
+}
+
+template<typename T>
+bool TinyTableBase::loadPage(MySqlConnectionPool *pool, const tt::LoadRequest &request, tt::LoadReply &reply,
+                             const LoadFilters<T> &filters, TinyORM::Records<T> *loaded) {
+    uint32_t pagesize = pageSize(request);
+
+    std::shared_ptr<T> after;
+    if (request.cursor().size()) {
+        typename TableMeta<T>::KeyType key;
+        if (!deserialize(key, request.cursor())) {
+            reply.set_retcode(11);
+            return false;
+        }
+
+        after = std::make_shared<T>();
+        setObjectKey(after, key);
+    }
+
+    std::shared_ptr<T> last;
+    TinyORM db(pool);
+    bool ret = db.loadPage<T>([&](std::shared_ptr<T> obj) {
+        reply.add_values(serialize(*obj.get()));
+        if (loaded) loaded->push_back(obj);
+        last = obj;
+    }, after.get(), pagesize, filters.fields);
+
+    if (!ret) {
+        reply.set_retcode(1);
+        return false;
+    }
+
+    if (last)
+        reply.set_cursor(serialize(getObjectKey(last)));
+    reply.set_finished(reply.values_size() < (int) pagesize);
+    reply.set_retcode(0);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool TableLoadSessions<T>::nextPage(const tt::LoadRequest &request, tt::LoadReply &reply,
+                                    const SnapshotCallback &snapshot) {
+    uint32_t pagesize = TinyTableBase::pageSize(request);
+
+    uint64_t id = 0;
+    size_t pos = 0;
+    std::shared_ptr<Snapshot> objects;
+    Snapshot page;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        Clock::time_point now = Clock::now();
+        expire(now);
+
+        if (request.cursor().empty()) {
+            objects = std::make_shared<Snapshot>();
+            id = ++lastid_;
+        } else {
+            const std::string &cursor = request.cursor();
+            size_t colon = cursor.find(':');
+            if (colon == std::string::npos) {
+                reply.set_retcode(11);
+                return false;
+            }
+
+            id = std::strtoull(cursor.c_str(), nullptr, 10);
+            pos = std::strtoull(cursor.c_str() + colon + 1, nullptr, 10);
+
+            auto it = sessions_.find(id);
+            if (it == sessions_.end()) {  // expired
+                reply.set_retcode(2);
+                return false;
+            }
+
+            it->second.active = now;
+            objects = it->second.objects;
+        }
+    }
+
+    // take the snapshot outside of the sessions lock
+    if (request.cursor().empty())
+        snapshot(*objects);
+
+    for (size_t i = pos; i < objects->size() && page.size() < pagesize; ++i)
+        page.push_back(objects->at(i));
+
+    pos += page.size();
+    bool finished = pos >= objects->size();
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (finished)
+            sessions_.erase(id);
+        else
+            sessions_[id] = Session{objects, Clock::now()};
+    }
+
+    for (auto &obj : page)
+        reply.add_values(serialize(*obj.get()));
+
+    if (!finished)
+        reply.set_cursor(std::to_string(id) + ":" + std::to_string(pos));
+    reply.set_finished(finished);
+    reply.set_retcode(0);
+    return true;
+}
+
+template<typename T>
+void TableLoadSessions<T>::expire(Clock::time_point now) {
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        if (now - it->second.active > std::chrono::milliseconds(TINYTABLE_LOAD_SESSION_TIMEOUT))
+            it = sessions_.erase(it);
+        else
+            ++it;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
 
 template<typename T>
 bool TinyDBTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "GET:" << this->name() << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "GET:{}:{}", this->name(), request);
 
     KeyType key;
     if (!deserialize(key, request.key())) {
@@ -48,7 +273,7 @@ bool TinyDBTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
 
 template<typename T>
 bool TinyDBTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "SET:" << this->name() << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "SET:{}:{}", this->name(), request);
 
     ObjectPtr newobj = std::make_shared<T>();
     if (!deserialize(*newobj.get(), request.value())) {
@@ -69,7 +294,7 @@ bool TinyDBTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
 template<typename T>
 bool TinyDBTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
 
-    LOGGER_DEBUG("TinyTable", "DEL:" << this->name() << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "DEL:{}:{}", this->name(), request);
 
     KeyType key;
     if (!deserialize(key, request.key())) {
@@ -90,13 +315,71 @@ bool TinyDBTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
     }
 }
 
+template<typename T>
+bool TinyDBTable<T>::processMGet(const tt::MGet &request, tt::MGetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MGET:{}:{}", this->name(), request.keys_size());
+
+    std::vector<KeyType> keys;
+    for (int i = 0; i < request.keys_size(); ++i) {
+        tt::GetReply *item = reply.add_items();
+        item->set_type(request.type());
+        item->set_key(request.keys(i));
+
+        KeyType key;
+        if (!deserialize(key, request.keys(i))) {
+            item->set_retcode(11);
+            continue;
+        }
+
+        item->set_retcode(1);
+        keys.push_back(key);
+    }
+
+    std::unordered_map<std::string, ObjectPtr> objects;
+    if (!TinyTableBase::selectMany<T>(this->dbpool(), keys, objects))
+        return false;
+
+    for (auto &item : *reply.mutable_items()) {
+        auto it = objects.find(item.key());
+        if (it != objects.end()) {
+            item.set_value(serialize(*it->second.get()));
+            item.set_retcode(0);
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool TinyDBTable<T>::proceeMSet(const tt::MSet &request, tt::MSetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MSET:{}:{}", this->name(), request.values_size());
+    return TinyTableBase::replaceMany<T>(this->dbpool(), request, reply);
+}
+
+template<typename T>
+bool TinyDBTable<T>::proceeMDel(const tt::MDel &request, tt::MDelReply &reply) {
+    LOGB_DEBUG("TinyTable", "MDEL:{}:{}", this->name(), request.keys_size());
+    return TinyTableBase::delMany<T>(this->dbpool(), request, reply);
+}
+
+template<typename T>
+bool TinyDBTable<T>::processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) {
+    LOGB_DEBUG("TinyTable", "LOAD:{}:{}", this->name(), request);
+
+    TinyTableBase::LoadFilters<T> filters;
+    if (!TinyTableBase::loadFilters(request, filters)) {
+        reply.set_retcode(12);
+        return false;
+    }
+    return TinyTableBase::loadPage<T>(this->dbpool(), request, reply, filters);
+}
+
 
 /////////////////////////////////////////////////////////////////////////
 
 
 template<typename T>
 bool TinyMemTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "GET:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "GET:{}:{}", name_, request);
 
     KeyType key;
     if (!deserialize(key, request.key())) {
@@ -107,7 +390,7 @@ bool TinyMemTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
     auto memobj = getObjectInMemory(key);
 
     if (memobj) {  // hit
-        LOGGER_DEBUG("TinyTable", "GET:" << name_ << ":" << "HIT!!");
+        LOGB_DEBUG("TinyTable", "GET:{}:HIT!!", name_);
 
         reply.set_value(serialize(*memobj.get()));
         reply.set_retcode(0);
@@ -120,7 +403,7 @@ bool TinyMemTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
 
 template<typename T>
 bool TinyMemTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "SET:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "SET:{}:{}", name_, request);
 
     reply.set_type(request.type());
 
@@ -134,10 +417,11 @@ bool TinyMemTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
         LOGGER_ERROR("TinyTable", e.what());
     }
 
-    auto memobj = getObjectInMemory(TinyTableBase::getObjectKey(newobj));
-    if (memobj) {
-        items_.erase(TinyTableBase::getObjectKey(memobj));
-        items_.insert(std::make_pair(TinyTableBase::getObjectKey(newobj), newobj));
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = items_.find(TinyTableBase::getObjectKey(newobj));
+        if (it != items_.end())
+            it->second = newobj;
     }
 
     TinyORM db(db_pool_);
@@ -153,7 +437,7 @@ bool TinyMemTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
 template<typename T>
 bool TinyMemTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
 
-    LOGGER_DEBUG("TinyTable", "DEL:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "DEL:{}:{}", name_, request);
 
     reply.set_type(request.type());
     reply.set_key(request.key());
@@ -183,14 +467,314 @@ bool TinyMemTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
     }
 }
 
+template<typename T>
+bool TinyMemTable<T>::processMGet(const tt::MGet &request, tt::MGetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MGET:{}:{}", name_, request.keys_size());
+
+    std::vector<ObjectPtr> hits(request.keys_size());
+
+    // one lookup pass under the lock, serialize outside
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (int i = 0; i < request.keys_size(); ++i) {
+            tt::GetReply *item = reply.add_items();
+            item->set_type(request.type());
+            item->set_key(request.keys(i));
+            item->set_retcode(1);
+
+            KeyType key;
+            if (!deserialize(key, request.keys(i))) {
+                item->set_retcode(11);
+                continue;
+            }
+
+            auto it = items_.find(key);
+            if (it != items_.end())
+                hits[i] = it->second;
+        }
+    }
+
+    for (int i = 0; i < reply.items_size(); ++i) {
+        if (hits[i]) {
+            reply.mutable_items(i)->set_value(serialize(*hits[i].get()));
+            reply.mutable_items(i)->set_retcode(0);
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool TinyMemTable<T>::proceeMSet(const tt::MSet &request, tt::MSetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MSET:{}:{}", name_, request.values_size());
+
+    return TinyTableBase::replaceMany<T>(db_pool_, request, reply, [this](const TinyORM::Records<T> &objs) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto &obj : objs) {
+            auto it = items_.find(TinyTableBase::getObjectKey(obj));
+            if (it != items_.end())
+                it->second = obj;
+        }
+    });
+}
+
+template<typename T>
+bool TinyMemTable<T>::proceeMDel(const tt::MDel &request, tt::MDelReply &reply) {
+    LOGB_DEBUG("TinyTable", "MDEL:{}:{}", name_, request.keys_size());
+    return TinyTableBase::delMany<T>(db_pool_, request, reply);
+}
+
+template<typename T>
+bool TinyMemTable<T>::processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) {
+    LOGB_DEBUG("TinyTable", "LOAD:{}:{}", name_, request);
+
+    TinyTableBase::LoadFilters<T> filters;
+    if (!TinyTableBase::loadFilters(request, filters)) {
+        reply.set_retcode(12);
+        return false;
+    }
+
+    if (request.direct()) {
+        TinyORM::Records<T> loaded;
+        if (!TinyTableBase::loadPage<T>(db_pool_, request, reply, filters, &loaded))
+            return false;
+
+        if (request.cacheit() && loaded.size()) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (auto &obj : loaded)
+                items_[TinyTableBase::getObjectKey(obj)] = obj;
+        }
+        return true;
+    }
+
+    return loads_.nextPage(request, reply, [this, &filters](typename TableLoadSessions<T>::Snapshot &objects) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        objects.reserve(items_.size());
+        for (auto &item : items_) {
+            if (filters.match(*item.second))
+                objects.push_back(item.second);
+        }
+    });
+}
+
 
 
 /////////////////////////////////////////////////////////////////////////
 
 
+template<typename T>
+typename TinyCacheTable<T>::ObjectPtr TinyCacheTable<T>::lookup(const KeyType &key, bool &negative) {
+    negative = false;
+
+    auto it = items_.find(key);
+    if (it == items_.end())
+        return nullptr;
+
+    if (it->second.expire && it->second.expire <= now_ms()) {
+        stats_.expired++;
+        erase(it);
+        return nullptr;
+    }
+
+    it->second.access = ++tick_;
+    negative = !it->second.object;
+    return it->second.object;
+}
+
+template<typename T>
+void TinyCacheTable<T>::insert(const KeyType &key, ObjectPtr object, size_t bytes) {
+    uint32_t ttl = object ? expired_ms_ : std::min(expired_ms_, negative_ms_);
+
+    auto ret = items_.insert(std::make_pair(key, Entry()));
+    if (ret.second)
+        stats_.items++;
+
+    Entry &entry = ret.first->second;
+
+    // the entry itself is charged too, or the negative ones would be free
+    bytes += kEntryBytes;
+
+    stats_.bytes -= entry.bytes;
+    entry.object = object;
+    entry.bytes = bytes;
+    entry.access = ++tick_;
+    entry.expire = (ttl == static_cast<uint32_t>(-1) ? 0 : now_ms() + ttl);
+    stats_.bytes += bytes;
+
+    evict();
+}
+
+template<typename T>
+void TinyCacheTable<T>::update(const KeyType &key, ObjectPtr object, size_t bytes) {
+    auto it = items_.find(key);
+    if (it != items_.end())
+        insert(key, object, bytes);
+}
+
+template<typename T>
+void TinyCacheTable<T>::erase(typename EntryMap::iterator it) {
+    stats_.bytes -= it->second.bytes;
+    stats_.items--;
+    items_.erase(it);
+}
+
+template<typename T>
+void TinyCacheTable<T>::evict() {
+    const size_t kSamples = 5;
+
+    if (!max_bytes_ || stats_.bytes <= max_bytes_)
+        return;
+
+    // the expired ones go first, they are only found by lookup or sampling otherwise
+    int64_t now = now_ms();
+    if (now - last_sweep_ >= kSweepIntervalMs) {
+        last_sweep_ = now;
+        for (auto it = items_.begin(); it != items_.end();) {
+            auto next = std::next(it);
+            if (it->second.expire && it->second.expire <= now) {
+                stats_.expired++;
+                erase(it);
+            }
+            it = next;
+        }
+    }
+
+    while (max_bytes_ && stats_.bytes > max_bytes_ && items_.size() > 1) {
+        // sample from a random bucket, drop the least recently used(or expired) one
+        size_t bucket = random_() % items_.bucket_count();
+        auto victim = items_.end();
+
+        for (size_t n = 0, i = 0; n < kSamples && i < items_.bucket_count(); ++i) {
+            size_t b = (bucket + i) % items_.bucket_count();
+            for (auto lit = items_.begin(b); lit != items_.end(b) && n < kSamples; ++lit, ++n) {
+                if (lit->second.expire && lit->second.expire <= now) {
+                    victim = items_.find(lit->first);
+                    n = kSamples;
+                    break;
+                }
+
+                if (victim == items_.end() || lit->second.access < victim->second.access)
+                    victim = items_.find(lit->first);
+            }
+        }
+
+        if (victim == items_.end())
+            break;
+
+        stats_.evictions++;
+        erase(victim);
+    }
+}
+
+template<typename T>
+void TinyCacheTable<T>::invalidate(const KeyType &key, ObjectPtr keep) {
+    generation_++;
+
+    auto fit = flights_.find(key);
+    if (fit != flights_.end()) {
+        fit->second->stale = true;
+        flights_.erase(fit);
+    }
+
+    auto it = items_.find(key);
+    if (it != items_.end() && it->second.object != keep)
+        erase(it);
+}
+
+template<typename T>
+typename TinyCacheTable<T>::ObjectPtr TinyCacheTable<T>::load(const KeyType &key, std::string &value) {
+    std::shared_ptr<Flight> flight;
+    for (;;) {
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            auto it = flights_.find(key);
+            if (it != flights_.end()) {
+                flight = it->second;
+            } else {
+                flight = std::make_shared<Flight>();
+                flights_.insert(std::make_pair(key, flight));
+                leader = true;
+            }
+        }
+
+        if (leader)
+            break;
+
+        // someone is querying the same key
+        std::unique_lock<std::mutex> lock(flight->mutex);
+        flight->cond.wait(lock, [&flight]() { return flight->done; });
+        if (!flight->retry) {
+            value = flight->value;
+            return flight->object;
+        }
+        // written meanwhile, the result may be older than the write
+    }
+
+    // the followers are released however the query ends
+    auto land = [this, &key, &flight](ObjectPtr object, const std::string &value, bool retry) {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            // detached by a write, it may be another flight of the key now
+            auto it = flights_.find(key);
+            if (it != flights_.end() && it->second == flight)
+                flights_.erase(it);
+        }
+        {
+            std::lock_guard<std::mutex> guard(flight->mutex);
+            flight->object = object;
+            flight->value = value;
+            flight->retry = retry;
+            flight->done = true;
+        }
+        flight->cond.notify_all();
+    };
+
+    ObjectPtr newobj = std::make_shared<T>();
+    setKey(newobj, key);
+
+    try {
+        TinyORM db(db_pool_);
+        if (db.select(*newobj.get())) {
+            value = serialize(*newobj.get());
+        } else {
+            newobj = nullptr;
+            value.clear();
+        }
+    } catch (...) {
+        // not cached, the next miss tries again
+        land(nullptr, std::string(), true);
+        throw;
+    }
+
+    // a write during the query is not overwritten by what it read
+    bool stale = false;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stale = flight->stale;
+        if (!stale)
+            insert(key, newobj, value.size());
+    }
+
+    land(newobj, value, stale);
+    return newobj;
+}
+
+template<typename T>
+std::string TinyCacheTable<T>::statString() {
+    std::ostringstream oss;
+    oss << "hits=" << stats_.hits
+        << ",misses=" << stats_.misses
+        << ",negative_hits=" << stats_.negative_hits
+        << ",evictions=" << stats_.evictions
+        << ",expired=" << stats_.expired
+        << ",items=" << stats_.items
+        << ",bytes=" << stats_.bytes;
+    return oss.str();
+}
+
 template<typename T>
 bool TinyCacheTable<T>::processGet(const tt::Get &request, tt::GetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "GET:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "GET:{}:{}", name_, request);
 
     KeyType key;
     if (!deserialize(key, request.key())) {
@@ -198,36 +782,46 @@ bool TinyCacheTable<T>::processGet(const tt::Get &request, tt::GetReply &reply)
         return false;
     }
 
-    auto memobj = getObjectInMemory(key);
+    bool negative = false;
+    ObjectPtr memobj;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        memobj = lookup(key, negative);
+    }
 
     if (memobj) {  // hit
-        LOGGER_DEBUG("TinyTable", "GET:" << name_ << ":" << "HIT!!");
+        LOGB_DEBUG("TinyTable", "GET:{}:HIT!!", name_);
+        stats_.hits++;
 
         reply.set_value(serialize(*memobj.get()));
         reply.set_retcode(0);
         return true;
-    } else { // miss
-        LOGGER_DEBUG("TinyTable", "GET:" << name_ << ":" << "MISS!!");
+    }
 
-        ObjectPtr newobj = std::make_shared<T>();
-        setKey(newobj, key);
+    if (negative) { // not exist in db
+        stats_.negative_hits++;
+        reply.set_retcode(1);
+        return false;
+    }
 
-        TinyORM db(db_pool_);
-        if (db.select(*newobj.get())) {
-            reply.set_value(serialize(*newobj.get()));
-            reply.set_retcode(0);
-            items_.insert(std::make_pair(getKey(newobj), newobj));
-            return true;
-        } else {
-            reply.set_retcode(1);
-            return false;
-        }
+    // miss
+    LOGB_DEBUG("TinyTable", "GET:{}:MISS!!", name_);
+    stats_.misses++;
+
+    std::string value;
+    if (load(key, value)) {
+        reply.set_value(value);
+        reply.set_retcode(0);
+        return true;
+    } else {
+        reply.set_retcode(1);
+        return false;
     }
 }
 
 template<typename T>
 bool TinyCacheTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
-    LOGGER_DEBUG("TinyTable", "SET:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "SET:{}:{}", name_, request);
 
     reply.set_type(request.type());
 
@@ -241,26 +835,30 @@ bool TinyCacheTable<T>::proceeSet(const tt::Set &request, tt::SetReply &reply) {
         LOGGER_ERROR("TinyTable", e.what());
     }
 
-    auto memobj = getObjectInMemory(getKey(newobj));
-    if (memobj) {
-        items_.erase(getKey(memobj));
-        items_.insert(std::make_pair(getKey(newobj), newobj));
+    KeyType key = getKey(newobj);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        update(key, newobj, request.value().size());
+        invalidate(key, newobj);
     }
 
     TinyORM db(db_pool_);
-    if (db.replace(*newobj.get())) {
-        reply.set_retcode(0);
-        return true;
-    } else {
-        reply.set_retcode(1);
-        return false;
+    bool ok = db.replace(*newobj.get());
+
+    // loads started before the row was written
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        invalidate(key, newobj);
     }
+
+    reply.set_retcode(ok ? 0 : 1);
+    return ok;
 }
 
 template<typename T>
 bool TinyCacheTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
 
-    LOGGER_DEBUG("TinyTable", "DEL:" << name_ << ":" << request.ShortDebugString());
+    LOGB_DEBUG("TinyTable", "DEL:{}:{}", name_, request);
 
     reply.set_type(request.type());
     reply.set_key(request.key());
@@ -271,23 +869,667 @@ bool TinyCacheTable<T>::proceeDel(const tt::Del &request, tt::DelReply &reply) {
         return false;
     }
 
-    ObjectPtr obj = nullptr;
-    ObjectPtr memobj = getObjectInMemory(key);
-    if (memobj) {
-        obj = memobj;
-    } else {
-        obj = std::make_shared<T>();
-        setKey(obj, key);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        invalidate(key, nullptr);
     }
 
+    ObjectPtr obj = std::make_shared<T>();
+    setKey(obj, key);
+
     TinyORM db(db_pool_);
-    if (db.del(*obj.get())) {
-        reply.set_retcode(0);
+    bool ok = db.del(*obj.get());
+
+    // loads started before the row was deleted
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        invalidate(key, nullptr);
+    }
+
+    reply.set_retcode(ok ? 0 : 1);
+    return ok;
+}
+
+template<typename T>
+bool TinyCacheTable<T>::processMGet(const tt::MGet &request, tt::MGetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MGET:{}:{}", name_, request.keys_size());
+
+    std::vector<ObjectPtr> hits(request.keys_size());
+    std::vector<KeyType> misses;
+    std::vector<int> missindex;
+    uint64_t generation = 0;
+
+    // one lookup pass under the lock, serialize outside
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        generation = generation_;
+        for (int i = 0; i < request.keys_size(); ++i) {
+            tt::GetReply *item = reply.add_items();
+            item->set_type(request.type());
+            item->set_key(request.keys(i));
+            item->set_retcode(1);
+
+            KeyType key;
+            if (!deserialize(key, request.keys(i))) {
+                item->set_retcode(11);
+                continue;
+            }
+
+            bool negative = false;
+            hits[i] = lookup(key, negative);
+            if (hits[i]) {
+                stats_.hits++;
+            } else if (negative) {
+                stats_.negative_hits++;
+            } else {
+                stats_.misses++;
+                misses.push_back(key);
+                missindex.push_back(i);
+            }
+        }
+    }
+
+    // misses: one query, then cache them(positive and negative)
+    if (misses.size()) {
+        std::unordered_map<std::string, ObjectPtr> objects;
+        if (TinyTableBase::selectMany<T>(db_pool_, misses, objects)) {
+            for (size_t n = 0; n < misses.size(); ++n) {
+                int i = missindex[n];
+                auto it = objects.find(reply.items(i).key());
+                if (it != objects.end())
+                    hits[i] = it->second;
+            }
+
+            // not cached if anything was written during the query, it may be one of them
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (size_t n = 0; n < misses.size() && generation == generation_; ++n) {
+                int i = missindex[n];
+                if (hits[i]) {
+                    reply.mutable_items(i)->set_value(serialize(*hits[i].get()));
+                    insert(misses[n], hits[i], reply.items(i).value().size());
+                } else {
+                    insert(misses[n], nullptr, 0);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < reply.items_size(); ++i) {
+        if (hits[i]) {
+            if (!reply.items(i).has_value())
+                reply.mutable_items(i)->set_value(serialize(*hits[i].get()));
+            reply.mutable_items(i)->set_retcode(0);
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool TinyCacheTable<T>::proceeMSet(const tt::MSet &request, tt::MSetReply &reply) {
+    LOGB_DEBUG("TinyTable", "MSET:{}:{}", name_, request.values_size());
+
+    TinyORM::Records<T> written;
+    bool ok = TinyTableBase::replaceMany<T>(db_pool_, request, reply, [this, &written](const TinyORM::Records<T> &objs) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto &obj : objs) {
+            auto it = items_.find(getKey(obj));
+            if (it != items_.end())
+                insert(it->first, obj, serialize(*obj.get()).size());
+            invalidate(getKey(obj), obj);
+        }
+        written = objs;
+    });
+
+    // loads started before the rows were written
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto &obj : written)
+        invalidate(getKey(obj), obj);
+    return ok;
+}
+
+template<typename T>
+bool TinyCacheTable<T>::proceeMDel(const tt::MDel &request, tt::MDelReply &reply) {
+    LOGB_DEBUG("TinyTable", "MDEL:{}:{}", name_, request.keys_size());
+
+    std::vector<KeyType> keys;
+    keys.reserve(request.keys_size());
+    for (int i = 0; i < request.keys_size(); ++i) {
+        KeyType key;
+        if (deserialize(key, request.keys(i)))
+            keys.push_back(key);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto &key : keys)
+            invalidate(key, nullptr);
+    }
+
+    bool ok = TinyTableBase::delMany<T>(db_pool_, request, reply);
+
+    // loads started before the rows were deleted
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto &key : keys)
+        invalidate(key, nullptr);
+    return ok;
+}
+
+template<typename T>
+bool TinyCacheTable<T>::processLoad(const tt::LoadRequest &request, tt::LoadReply &reply) {
+    LOGB_DEBUG("TinyTable", "LOAD:{}:{}", name_, request);
+
+    TinyTableBase::LoadFilters<T> filters;
+    if (!TinyTableBase::loadFilters(request, filters)) {
+        reply.set_retcode(12);
+        return false;
+    }
+
+    if (request.direct()) {
+        TinyORM::Records<T> loaded;
+        if (!TinyTableBase::loadPage<T>(db_pool_, request, reply, filters, &loaded))
+            return false;
+
+        if (request.cacheit() && loaded.size()) {
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (size_t i = 0; i < loaded.size(); ++i)
+                insert(getKey(loaded[i]), loaded[i], reply.values(i).size());
+        }
         return true;
-    } else {
-        reply.set_retcode(1);
+    }
+
+    return loads_.nextPage(request, reply, [this, &filters](typename TableLoadSessions<T>::Snapshot &objects) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        int64_t now = now_ms();
+        objects.reserve(items_.size());
+        for (auto &item : items_) {
+            if (item.second.object && (!item.second.expire || item.second.expire > now)
+                && filters.match(*item.second.object))
+                objects.push_back(item.second.object);
+        }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+inline TableWorker::TableWorker(zmq::context_t &context, size_t index, TinyTableFactory *factory,
+                                TableQueueStatMap &stats)
+        : context_(context), index_(index), stats_(stats) {
+    bindTableRPC(rpc_dispatcher_, factory);
+    msg_dispatcher_.on<rpc::Request>(std::bind(&TableWorker::doMsgRequest, this,
+                                               std::placeholders::_1, std::placeholders::_2));
+}
+
+inline void TableWorker::run(const std::atomic<bool> &running) {
+    zmq::socket_t requests(context_, ZMQ_PULL);
+    requests.connect(address(index_));
+
+    reply_socket_ = std::make_shared<zmq::socket_t>(context_, ZMQ_PUSH);
+    reply_socket_->connect(replyAddress());
+
+    zmq::message_t idmsg;
+    zmq::message_t table;
+    zmq::message_t request;
+    std::string client;
+    std::string tablename;
+
+    while (running) {
+        zmq::pollitem_t items[] = {{(void *) requests, 0, ZMQ_POLLIN, 0}};
+        if (zmq_poll(&items[0], 1, 100) <= 0)
+            continue;
+
+        for (size_t i = 0; i < ZMQ_POLL_BUDGET; ++i) {
+            if (!requests.recv(&idmsg, ZMQ_DONTWAIT))
+                break;
+            requests.recv(&table);
+            requests.recv(&request);
+
+            client.assign((char *) idmsg.data(), idmsg.size());
+            tablename.assign((char *) table.data(), table.size());
+
+            try {
+                msg_dispatcher_.dispatch((const char *) request.data(), request.size(), client);
+            }
+            catch (std::exception &err) {
+                LOG_ERROR("TinyTable", "worker %zu: %s", index_, err.what());
+            }
+
+            auto it = stats_.find(tablename);
+            if (it != stats_.end()) {
+                it->second->pending--;
+                it->second->processed++;
+            }
+        }
+    }
+
+    reply_socket_.reset();
+}
+
+inline void TableWorker::doMsgRequest(const rpc::Request &request, const std::string &client) {
+    rpc::Reply reply = rpc_dispatcher_.requested(request);
+
+    auto buffer = std::make_shared<MessageBuffer>();
+    if (!MessageNameDispatcher<>::write2Buffer(*buffer, reply))
+        return;
+
+    zmq::message_t idmsg(client.data(), client.size());
+    zmq::message_t replymsg;
+    zmqZeroCopyMsg(replymsg, buffer);
+    reply_socket_->send(idmsg, ZMQ_SNDMORE);
+    reply_socket_->send(replymsg);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+inline ThreadedTableServer::ThreadedTableServer(size_t workernum, TinyTableFactory *factory)
+        : workernum_(workernum ? workernum : 1),
+          factory_(factory),
+          budget_(ZMQ_POLL_BUDGET),
+          running_(false),
+          context_(1),
+          rpc_request_name_(MessageName<rpc::Request>::value()) {
+}
+
+inline ThreadedTableServer::~ThreadedTableServer() {
+    stop();
+}
+
+inline bool ThreadedTableServer::bind(const std::string &address) {
+    LOG_TRACE("TinyTable", "ThreadedTableServer listening : %s, workers=%zu", address.c_str(), workernum_);
+
+    // stats are created before workers start, then only read concurrently
+    for (auto &table : factory_->tables())
+        stats_[table.first] = std::make_shared<TableQueueStat>();
+
+    frontend_ = std::make_shared<zmq::socket_t>(context_, ZMQ_ROUTER);
+    frontend_->bind(address);
+
+    // inproc: bind before workers connect
+    replies_ = std::make_shared<zmq::socket_t>(context_, ZMQ_PULL);
+    replies_->bind(TableWorker::replyAddress());
+
+    for (size_t i = 0; i < workernum_; ++i) {
+        auto socket = std::make_shared<zmq::socket_t>(context_, ZMQ_PUSH);
+        socket->bind(TableWorker::address(i));
+        workers_.push_back(socket);
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < workernum_; ++i) {
+        threads_.emplace_back([this, i]() {
+            TableWorker worker(context_, i, factory_, stats_);
+            worker.run(running_);
+        });
+    }
+
+    return true;
+}
+
+inline bool ThreadedTableServer::poll(long timeout) {
+    zmq::pollitem_t items[] = {
+            {(void *) *frontend_, 0, ZMQ_POLLIN, 0},
+            {(void *) *replies_,  0, ZMQ_POLLIN, 0}
+    };
+
+    int rc = zmq_poll(&items[0], 2, timeout);
+    if (-1 != rc) {
+        if (items[0].revents & ZMQ_POLLIN)
+            dispatchRequests();
+
+        if (items[1].revents & ZMQ_POLLIN)
+            forwardReplies();
+    }
+
+    if (!splits_.empty())
+        expireSplits();
+
+    return true;
+}
+
+inline void ThreadedTableServer::stop() {
+    if (!running_)
+        return;
+
+    running_ = false;
+    for (auto &t : threads_)
+        t.join();
+    threads_.clear();
+
+    workers_.clear();
+    splits_.clear();
+    replies_.reset();
+    frontend_.reset();
+}
+
+inline size_t ThreadedTableServer::route(zmq::message_t &request, std::string &table, rpc::Request &rpc_request) {
+    table.clear();
+    rpc_request.Clear();
+
+    // [MessageHeader][name][rpc::Request]
+    if (request.size() < sizeof(MessageHeader))
+        return 0;
+
+    MessageHeader *header = (MessageHeader *) request.data();
+    if (!header->type_is_name || header->msgsize() != request.size())
+        return 0;
+
+    const char *name = (const char *) request.data() + sizeof(MessageHeader);
+    if (rpc_request_name_.compare(0, std::string::npos, name, header->type_len) != 0)
+        return 0;
+
+    if (!rpc_request.ParseFromArray(name + header->type_len, header->size - header->type_len)) {
+        rpc_request.Clear();
+        return 0;
+    }
+
+    // tt::Get/Set/Del share the same (type=1, key=2) fields,
+    // and the repeated keys(=2) of MGet/MSet/MDel parse as their last key
+    tt::Get tablekey;
+    if (!tablekey.ParseFromString(rpc_request.body()))
+        return 0;
+
+    table = tablekey.type();
+    return workerOf(tablekey.type(), tablekey.key());
+}
+
+inline void ThreadedTableServer::dispatchRequests() {
+    std::string table;
+    rpc::Request rpc_request;
+    for (size_t i = 0; i < budget_; ++i) {
+        if (!frontend_->recv(&idmsg_, ZMQ_DONTWAIT))
+            break;
+        frontend_->recv(&empty_);
+        frontend_->recv(&request_);
+
+        size_t worker = route(request_, table, rpc_request);
+
+        if (split(rpc_request, table))
+            continue;
+
+        sendToWorker(worker, idmsg_, table, request_);
+    }
+}
+
+inline void ThreadedTableServer::sendToWorker(size_t worker, zmq::message_t &idmsg, const std::string &table,
+                                              zmq::message_t &request) {
+    auto it = stats_.find(table);
+    if (it != stats_.end()) {
+        TableQueueStat *stat = it->second.get();
+        uint32_t pending = ++stat->pending;
+        uint32_t maxpending = stat->max_pending;
+        while (pending > maxpending && !stat->max_pending.compare_exchange_weak(maxpending, pending));
+    }
+
+    zmq::message_t tablemsg(table.data(), table.size());
+    workers_[worker]->send(idmsg, ZMQ_SNDMORE);
+    workers_[worker]->send(tablemsg, ZMQ_SNDMORE);
+    workers_[worker]->send(request);
+}
+
+inline void ThreadedTableServer::forwardReplies() {
+    for (size_t i = 0; i < budget_; ++i) {
+        if (!replies_->recv(&idmsg_, ZMQ_DONTWAIT))
+            break;
+        replies_->recv(&request_);
+
+        if (!splits_.empty() && splitReplied(idmsg_, request_))
+            continue;
+
+        zmq::message_t empty;
+        frontend_->send(idmsg_, ZMQ_SNDMORE);
+        frontend_->send(empty, ZMQ_SNDMORE);
+        frontend_->send(request_);
+    }
+}
+
+//
+// Parts of the multi-key requests
+//
+inline int64_t tableNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline int tableSplitCount(const tt::MGet &request) { return request.keys_size(); }
+
+inline int tableSplitCount(const tt::MDel &request) { return request.keys_size(); }
+
+// keys and values in pairs, or not split
+inline int tableSplitCount(const tt::MSet &request) {
+    return request.keys_size() == request.values_size() ? request.keys_size() : 0;
+}
+
+inline void tableSplitCopy(const tt::MGet &from, int i, tt::MGet &to) { to.add_keys(from.keys(i)); }
+
+inline void tableSplitCopy(const tt::MDel &from, int i, tt::MDel &to) { to.add_keys(from.keys(i)); }
+
+inline void tableSplitCopy(const tt::MSet &from, int i, tt::MSet &to) {
+    to.add_keys(from.keys(i));
+    to.add_values(from.values(i));
+}
+
+// the replies of the parts back in the order of the keys
+inline void tableSplitMerge(tt::MGetReply &merged, const std::vector<tt::MGetReply> &parts,
+                            const std::vector<std::vector<int>> &positions, size_t total) {
+    for (size_t i = 0; i < total; ++i)
+        merged.add_items()->set_retcode(1);
+
+    for (size_t p = 0; p < parts.size(); ++p) {
+        for (size_t j = 0; j < positions[p].size() && (int) j < parts[p].items_size(); ++j)
+            *merged.mutable_items(positions[p][j]) = parts[p].items(j);
+    }
+}
+
+template<typename ReplyT>
+inline void tableSplitMerge(ReplyT &merged, const std::vector<ReplyT> &parts,
+                            const std::vector<std::vector<int>> &positions, size_t total) {
+    for (size_t i = 0; i < total; ++i) {
+        merged.add_keys();
+        merged.add_retcodes(1);
+    }
+
+    for (size_t p = 0; p < parts.size(); ++p) {
+        for (size_t j = 0; j < positions[p].size(); ++j) {
+            if ((int) j < parts[p].keys_size())
+                merged.set_keys(positions[p][j], parts[p].keys(j));
+            if ((int) j < parts[p].retcodes_size())
+                merged.set_retcodes(positions[p][j], parts[p].retcodes(j));
+        }
+    }
+}
+
+template<typename ReplyT>
+inline bool tableSplitMerge(const std::vector<rpc::Reply> &replies, const std::vector<std::vector<int>> &positions,
+                            size_t total, rpc::Reply &merged) {
+    std::vector<ReplyT> parts(replies.size());
+    for (size_t p = 0; p < replies.size(); ++p) {
+        if (!parts[p].ParseFromString(replies[p].body()))
+            return false;
+    }
+
+    ReplyT reply;
+    reply.set_type(parts.size() ? parts[0].type() : "");
+    tableSplitMerge(reply, parts, positions, total);
+    return reply.SerializeToString(merged.mutable_body());
+}
+
+template<typename MultiT>
+bool ThreadedTableServer::splitKeys(const rpc::Request &rpc_request, const std::string &table) {
+    MultiT request;
+    if (!request.ParseFromString(rpc_request.body()))
         return false;
+
+    // worker -> positions of its keys
+    std::map<size_t, std::vector<int>> owners;
+    for (int i = 0; i < tableSplitCount(request); ++i)
+        owners[workerOf(table, request.keys(i))].push_back(i);
+
+    if (owners.size() <= 1)
+        return false;
+
+    Split &split = splits_[++lastsplit_];
+    split.client.assign((char *) idmsg_.data(), idmsg_.size());
+    split.request = rpc_request;
+    split.request.clear_body();
+    split.table = table;
+    split.total = tableSplitCount(request);
+    split.parts.resize(owners.size());
+    split.waiting = owners.size();
+    split.started = tableNowMs();
+
+    for (auto &owner : owners) {
+        size_t part = split.positions.size();
+        split.positions.push_back(owner.second);
+
+        MultiT partrequest;
+        partrequest.set_type(request.type());
+        for (int i : owner.second)
+            tableSplitCopy(request, i, partrequest);
+
+        rpc::Request rpc_part = rpc_request;
+        partrequest.SerializeToString(rpc_part.mutable_body());
+
+        auto buffer = std::make_shared<MessageBuffer>();
+        if (!MessageNameDispatcher<>::write2Buffer(*buffer, rpc_part)) {
+            // never replied, failed as a whole
+            split.parts[part] = RPCCallbackBase::makeReply(rpc_request);
+            split.parts[part].set_errcode(rpc::REQUEST_INVALID);
+            split.waiting--;
+            continue;
+        }
+
+        std::string tag(1, '\0');
+        tag += "split:" + std::to_string(lastsplit_) + ":" + std::to_string(part);
+        zmq::message_t tagmsg(tag.data(), tag.size());
+        zmq::message_t partmsg;
+        zmqZeroCopyMsg(partmsg, buffer);
+        sendToWorker(owner.first, tagmsg, table, partmsg);
+    }
+
+    // no part was sent, nothing will reply
+    if (split.waiting == 0)
+        replySplit(splits_.find(lastsplit_));
+    return true;
+}
+
+inline bool ThreadedTableServer::split(const rpc::Request &rpc_request, const std::string &table) {
+    if (rpc_request.request() == MessageName<tt::MGet>::value())
+        return splitKeys<tt::MGet>(rpc_request, table);
+    if (rpc_request.request() == MessageName<tt::MSet>::value())
+        return splitKeys<tt::MSet>(rpc_request, table);
+    if (rpc_request.request() == MessageName<tt::MDel>::value())
+        return splitKeys<tt::MDel>(rpc_request, table);
+    return false;
+}
+
+inline bool ThreadedTableServer::splitReplied(zmq::message_t &idmsg, zmq::message_t &reply) {
+    // "\0split:<split>:<part>", ROUTER identities never start with a 0 but the 5 bytes generated ones
+    static const char prefix[] = "split:";
+    const char *tag = (const char *) idmsg.data();
+    if (idmsg.size() <= sizeof(prefix) || tag[0] != '\0' || memcmp(tag + 1, prefix, sizeof(prefix) - 1) != 0)
+        return false;
+
+    std::string ids(tag + sizeof(prefix), idmsg.size() - sizeof(prefix));
+    uint64_t id = std::strtoull(ids.c_str(), nullptr, 10);
+    size_t colon = ids.find(':');
+    size_t part = colon == std::string::npos ? 0 : std::strtoull(ids.c_str() + colon + 1, nullptr, 10);
+
+    auto it = splits_.find(id);
+    if (it == splits_.end() || part >= it->second.parts.size())
+        return true;
+
+    Split &split = it->second;
+    rpc::Reply &partreply = split.parts[part];
+    MessageHeader *header = (MessageHeader *) reply.data();
+    const char *body = (const char *) reply.data() + sizeof(MessageHeader);
+    if (reply.size() < sizeof(MessageHeader) || header->msgsize() != reply.size()
+        || !partreply.ParseFromArray(body + header->type_len, header->size - header->type_len)) {
+        partreply = RPCCallbackBase::makeReply(split.request);
+        partreply.set_errcode(rpc::REPLY_PACK_ERROR);
+    }
+
+    if (--split.waiting == 0)
+        replySplit(it);
+    return true;
+}
+
+inline void ThreadedTableServer::replySplit(SplitMap::iterator it) {
+    Split &split = it->second;
+    rpc::Reply merged;
+    mergeReplies(split, merged);
+
+    auto buffer = std::make_shared<MessageBuffer>();
+    if (MessageNameDispatcher<>::write2Buffer(*buffer, merged)) {
+        zmq::message_t clientmsg(split.client.data(), split.client.size());
+        zmq::message_t empty;
+        zmq::message_t replymsg;
+        zmqZeroCopyMsg(replymsg, buffer);
+        frontend_->send(clientmsg, ZMQ_SNDMORE);
+        frontend_->send(empty, ZMQ_SNDMORE);
+        frontend_->send(replymsg);
+    }
+
+    splits_.erase(it);
+}
+
+inline void ThreadedTableServer::expireSplits() {
+    int64_t now = tableNowMs();
+    if (now - last_expire_ < 1000)
+        return;
+    last_expire_ = now;
+
+    // the client has given up by now, a late part is dropped by splitReplied
+    for (auto it = splits_.begin(); it != splits_.end();) {
+        if (now - it->second.started >= split_timeout_ms_) {
+            LOGB_WARN("TinyTable", "split {} of {} expired, {} parts not back",
+                      it->first, it->second.table, it->second.waiting);
+            it = splits_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+inline void ThreadedTableServer::mergeReplies(Split &split, rpc::Reply &merged) {
+    // the first failed part fails the request
+    for (auto &part : split.parts) {
+        if (part.errcode() != rpc::NOERROR) {
+            merged = part;
+            return;
+        }
+    }
+
+    merged = RPCCallbackBase::makeReply(split.request);
+    if (split.parts.size() && split.parts[0].has_trace())
+        *merged.mutable_trace() = split.parts[0].trace();
+
+    bool ok = false;
+    const std::string &name = split.request.request();
+    if (name == MessageName<tt::MGet>::value())
+        ok = tableSplitMerge<tt::MGetReply>(split.parts, split.positions, split.total, merged);
+    else if (name == MessageName<tt::MSet>::value())
+        ok = tableSplitMerge<tt::MSetReply>(split.parts, split.positions, split.total, merged);
+    else if (name == MessageName<tt::MDel>::value())
+        ok = tableSplitMerge<tt::MDelReply>(split.parts, split.positions, split.total, merged);
+
+    merged.set_errcode(ok ? rpc::NOERROR : rpc::REPLY_PACK_ERROR);
+}
+
+inline uint32_t ThreadedTableServer::queueDepth(const std::string &table) {
+    auto it = stats_.find(table);
+    if (it != stats_.end())
+        return it->second->pending;
+    return 0;
+}
+
+inline std::string ThreadedTableServer::statString() {
+    std::ostringstream oss;
+    for (auto &s : stats_) {
+        oss << s.first << ":"
+            << s.second->pending << "/"
+            << s.second->max_pending << "/"
+            << s.second->processed << " ";
     }
+    return oss.str();
 }
 
 #endif //TINYWORLD_TINYTABLE_SERVER_IN_H
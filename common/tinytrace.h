@@ -0,0 +1,294 @@
+// Copyright (c) 2017 david++
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef TINYWORLD_TINYTRACE_H
+#define TINYWORLD_TINYTRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <functional>
+
+//////////////////////////////////////////////////////////
+//
+// Tracing:
+//
+//   A sampled request carries its trace context(rpc::TraceContext) through
+//   every RPC hop. Each hop records spans into an in-process buffer, and
+//   the exporter appends them to a file, one span per line:
+//
+//      trace_id span_id parent_id start_us duration_us name
+//
+//   Tracer::instance().setSampleRate(0.01);    // 1% of new requests
+//   Tracer::instance().exportTo("trace.log");
+//
+//   {
+//       TraceSpan span("load player");        // child of the current span
+//       ...
+//   }
+//
+/////////////////////////////////////////////////////////
+
+#define TRACE_BUFFER_MAX 65536
+
+struct TraceContext {
+    uint64_t trace_id = 0;
+    uint64_t span_id = 0;
+    uint64_t parent_id = 0;
+    bool sampled = false;
+};
+
+struct TraceSpanRecord {
+    uint64_t trace_id;
+    uint64_t span_id;
+    uint64_t parent_id;
+    int64_t start_us;
+    int64_t duration_us;
+    std::string name;
+};
+
+class Tracer {
+public:
+    static Tracer &instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    ~Tracer() {
+        stop();
+    }
+
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t newId() {
+        static thread_local std::mt19937_64 random{
+                std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id())};
+        uint64_t id = 0;
+        while (!id) id = random();
+        return id;
+    }
+
+    // context of the span running on this thread
+    static TraceContext &current() {
+        static thread_local TraceContext context;
+        return context;
+    }
+
+    // 0 ~ 1, for requests without a trace context
+    void setSampleRate(double rate) {
+        if (rate <= 0)
+            threshold_ = 0;
+        else if (rate >= 1)
+            threshold_ = UINT32_MAX;
+        else
+            threshold_ = static_cast<uint32_t>(rate * UINT32_MAX);
+    }
+
+    bool sample() {
+        uint32_t threshold = threshold_.load(std::memory_order_relaxed);
+        if (!threshold)
+            return false;
+        return static_cast<uint32_t>(newId()) <= threshold;
+    }
+
+    // new root when sampled, otherwise child of the current span
+    static TraceContext child() {
+        TraceContext ctx;
+        TraceContext &parent = current();
+        if (parent.sampled) {
+            ctx.trace_id = parent.trace_id;
+            ctx.parent_id = parent.span_id;
+            ctx.sampled = true;
+        } else if (instance().sample()) {
+            ctx.trace_id = newId();
+            ctx.sampled = true;
+        }
+
+        if (ctx.sampled)
+            ctx.span_id = newId();
+        return ctx;
+    }
+
+    void record(const TraceContext &ctx, const std::string &name, int64_t start_us, int64_t duration_us) {
+        if (!ctx.sampled)
+            return;
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (spans_.size() >= TRACE_BUFFER_MAX) {
+            spans_.pop_front();
+            dropped_++;
+        }
+        spans_.push_back(TraceSpanRecord{ctx.trace_id, ctx.span_id, ctx.parent_id,
+                                         start_us, duration_us < 0 ? 0 : duration_us, name});
+    }
+
+    // take all buffered spans
+    void drain(std::vector<TraceSpanRecord> &spans) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        spans.insert(spans.end(), spans_.begin(), spans_.end());
+        spans_.clear();
+    }
+
+    uint64_t dropped() const { return dropped_; }
+
+    // append buffered spans to filename every interval_ms
+    bool exportTo(const std::string &filename, uint32_t interval_ms = 1000) {
+        std::lock_guard<std::mutex> guard(thread_mutex_);
+        if (running_)
+            return false;
+
+        filename_ = filename;
+        interval_ms_ = interval_ms ? interval_ms : 1000;
+        running_ = true;
+        exporter_ = std::thread(&Tracer::exportLoop, this);
+        return true;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> guard(thread_mutex_);
+        if (!running_)
+            return;
+
+        running_ = false;
+        if (exporter_.joinable())
+            exporter_.join();
+        exportOnce();
+    }
+
+private:
+    void exportLoop() {
+        while (running_) {
+            for (uint32_t slept = 0; running_ && slept < interval_ms_; slept += 100)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            exportOnce();
+        }
+    }
+
+    void exportOnce() {
+        std::vector<TraceSpanRecord> spans;
+        drain(spans);
+        if (spans.empty())
+            return;
+
+        FILE *fp = std::fopen(filename_.c_str(), "a");
+        if (!fp)
+            return;
+
+        for (auto &span : spans) {
+            std::fprintf(fp, "%016llx %016llx %016llx %lld %lld %s\n",
+                         (unsigned long long) span.trace_id,
+                         (unsigned long long) span.span_id,
+                         (unsigned long long) span.parent_id,
+                         (long long) span.start_us,
+                         (long long) span.duration_us,
+                         span.name.c_str());
+        }
+        std::fclose(fp);
+    }
+
+    std::atomic<uint32_t> threshold_{0};
+
+    std::mutex mutex_;
+    std::deque<TraceSpanRecord> spans_;
+    std::atomic<uint64_t> dropped_{0};
+
+    // running_, exporter_ and the settings between exportTo() and stop()
+    std::mutex thread_mutex_;
+    std::atomic<bool> running_{false};
+    std::thread exporter_;
+    std::string filename_;
+    uint32_t interval_ms_ = 1000;
+};
+
+//
+// Make ctx the current context of this thread during the scope
+//
+class TraceScope {
+public:
+    TraceScope(const TraceContext &ctx) : saved_(Tracer::current()) {
+        Tracer::current() = ctx;
+    }
+
+    ~TraceScope() {
+        Tracer::current() = saved_;
+    }
+
+private:
+    TraceContext saved_;
+};
+
+//
+// Child span of the current one, only recorded when the trace is sampled
+//
+class TraceSpan {
+public:
+    TraceSpan(const char *name) {
+        if (start())
+            name_ = name;
+    }
+
+    TraceSpan(const std::string &name) {
+        if (start())
+            name_ = name;
+    }
+
+    ~TraceSpan() {
+        if (!ctx_.sampled)
+            return;
+
+        Tracer::current() = saved_;
+        Tracer::instance().record(ctx_, name_, start_us_, Tracer::now_us() - start_us_);
+    }
+
+    const TraceContext &context() const { return ctx_; }
+
+private:
+    bool start() {
+        TraceContext &parent = Tracer::current();
+        if (!parent.sampled)
+            return false;
+
+        saved_ = parent;
+        ctx_.trace_id = parent.trace_id;
+        ctx_.parent_id = parent.span_id;
+        ctx_.span_id = Tracer::newId();
+        ctx_.sampled = true;
+        start_us_ = Tracer::now_us();
+        Tracer::current() = ctx_;
+        return true;
+    }
+
+    std::string name_;
+    TraceContext ctx_;
+    TraceContext saved_;
+    int64_t start_us_ = 0;
+};
+
+#endif //TINYWORLD_TINYTRACE_H
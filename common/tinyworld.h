@@ -21,9 +21,11 @@
 #ifndef _COMMON_TINTYWORLD_H
 #define _COMMON_TINTYWORLD_H
 
+#include <atomic>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 
 #define TINY_NAMESPACE_BEGIN // namespace tiny {
@@ -43,6 +45,52 @@ struct RunOnceHelper {
         RunOnceHelper reg_obj_##tagname(reg_func_##tagname); \
         void reg_func_##tagname()
 
+//
+// 类型编号: 每个类型第一次使用时分配一个连续的编号(从0开始)，
+// 用来代替typeid(T).name()做查找，取编号只需读一个静态变量
+//
+struct TypeIndexBase {
+protected:
+    static size_t next() {
+        static std::atomic<size_t> counter(0);
+        return counter++;
+    }
+};
+
+template<typename T>
+struct TypeIndex : TypeIndexBase {
+    static size_t value() {
+        static const size_t index = next();
+        return index;
+    }
+};
+
+//
+// 按类型编号存放的槽位(注册时写入，之后只读)
+//
+template<typename Ptr>
+class TypeSlots {
+public:
+    typedef typename Ptr::element_type Element;
+
+    template<typename T>
+    void set(const Ptr &ptr) {
+        size_t index = TypeIndex<T>::value();
+        if (index >= slots_.size())
+            slots_.resize(index + 1);
+        slots_[index] = ptr;
+    }
+
+    template<typename T>
+    Element *get() const {
+        size_t index = TypeIndex<T>::value();
+        return index < slots_.size() ? slots_[index].get() : nullptr;
+    }
+
+private:
+    std::vector<Ptr> slots_;
+};
+
 //
 // 输出二进制(仿照`hexdump -C`命令)
 //
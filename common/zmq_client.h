@@ -89,7 +89,7 @@ protected:
     //
     void on_recv(zmq::message_t &request) {
         try {
-            msg_dispatcher_.dispatch(std::string((char*)request.data(), request.size()));
+            msg_dispatcher_.dispatch((const char *) request.data(), request.size());
         }
         catch (std::exception &err) {
             LOG_ERROR("ZMQ", "recv: %s", err.what());
@@ -58,6 +58,22 @@ inline void dumpmsg(zmq::message_t &message) {
 }
 
 
+//
+// Zero-copy frame: ZMQ keeps the buffer alive until the frame is sent
+//
+inline void zmqFreeMessageBuffer(void *data, void *hint) {
+    delete static_cast<MessageBufferPtr *>(hint);
+}
+
+inline void zmqZeroCopyMsg(zmq::message_t &msg, const MessageBufferPtr &buffer) {
+    msg.rebuild((void *) buffer->data(), buffer->size(), zmqFreeMessageBuffer, new MessageBufferPtr(buffer));
+}
+
+//
+// Max messages processed per zmq_poll wakeup
+//
+#define ZMQ_POLL_BUDGET 256
+
 //
 // ZMQAsyncServer - Async Server
 // ZMQBroker      - Broker
@@ -69,9 +85,11 @@ public:
     typedef MessageNameDispatcher<const std::string &> MsgDispatcher;
 
     ZMQAsyncServer(MsgDispatcher &dispatcher = MsgDispatcher::instance())
-            : msg_dispatcher_(dispatcher) {
+            : msg_dispatcher_(dispatcher), budget_(ZMQ_POLL_BUDGET) {
     }
 
+    void setPollBudget(size_t budget) { budget_ = budget ? budget : 1; }
+
     bool bind(const std::string &address) {
         LOG_TRACE("ZMQ", "Server listening : %s", address.c_str());
 
@@ -86,19 +104,19 @@ public:
 
         int rc = zmq_poll(&items[0], 1, timeout);
         if (-1 != rc) {
-            //  If we got a reply, process it
+            //  Drain all ready requests(up to the budget) per wakeup
             if (items[0].revents & ZMQ_POLLIN) {
-                zmq::message_t idmsg;
-                socket_->recv(&idmsg);
-                std::string id((char *) idmsg.data(), idmsg.size());
+                for (size_t i = 0; i < budget_; ++i) {
+                    if (!socket_->recv(&idmsg_, ZMQ_DONTWAIT))
+                        break;
 
-                zmq::message_t empty;
-                socket_->recv(&empty);
+                    // ROUTER delivers multipart messages atomically
+                    socket_->recv(&empty_);
+                    socket_->recv(&request_);
 
-                zmq::message_t request;
-                socket_->recv(&request);
-
-                on_recv(id, request);
+                    client_.assign((char *) idmsg_.data(), idmsg_.size());
+                    on_recv(client_, request_);
+                }
             }
         }
 
@@ -110,12 +128,19 @@ public:
     //
     template<typename MsgT>
     void send(const std::string &client, const MsgT &msg) {
-        MessageBuffer buffer;
-        MsgDispatcher::template write2Buffer(buffer, msg);
+        auto buffer = std::make_shared<MessageBuffer>();
+        MsgDispatcher::template write2Buffer(*buffer, msg);
+        send(client, buffer);
+    }
 
+    //
+    // Send binary to the specified client(zero-copy)
+    //
+    void send(const std::string &client, const MessageBufferPtr &buffer) {
         zmq::message_t idmsg(client.data(), client.size());
         zmq::message_t empty;
-        zmq::message_t reply(buffer.data(), buffer.size());
+        zmq::message_t reply;
+        zmqZeroCopyMsg(reply, buffer);
 
         socket_->send(idmsg, ZMQ_SNDMORE);
         socket_->send(empty, ZMQ_SNDMORE);
@@ -125,15 +150,9 @@ public:
 protected:
     void on_recv(std::string &client, zmq::message_t &request) {
         try {
-            auto replybin = msg_dispatcher_.dispatch(std::string((char *) request.data(), request.size()), client);
-            if (replybin) {
-                zmq::message_t idmsg(client.data(), client.size());
-                zmq::message_t empty;
-                zmq::message_t reply(replybin->data(), replybin->size());
-                socket_->send(idmsg, ZMQ_SNDMORE);
-                socket_->send(empty, ZMQ_SNDMORE);
-                socket_->send(reply);
-            }
+            auto replybin = msg_dispatcher_.dispatch((const char *) request.data(), request.size(), client);
+            if (replybin)
+                send(client, replybin);
         }
         catch (std::exception &err) {
             LOG_ERROR("ZMQ", "recv: %s", err.what());
@@ -145,18 +164,33 @@ private:
     std::shared_ptr<zmq::socket_t> socket_;
 
     MsgDispatcher &msg_dispatcher_;
+
+    // Reused receiving frames
+    zmq::message_t idmsg_;
+    zmq::message_t empty_;
+    zmq::message_t request_;
+    std::string client_;
+
+    size_t budget_;
 };
 
 
 class ZMQBroker {
 public:
-    ZMQBroker(std::shared_ptr<zmq::context_t> context = NULL) {
+    ZMQBroker(std::shared_ptr<zmq::context_t> context = NULL)
+            : budget_(ZMQ_POLL_BUDGET), frontend_msgs_(0), backend_msgs_(0) {
         if (context == NULL)
             context_.reset(new zmq::context_t(1));
         else
             context_ = context;
     }
 
+    void setPollBudget(size_t budget) { budget_ = budget ? budget : 1; }
+
+    // Forwarded messages: FRONTEND->BACKEND / BACKEND->FRONTEND
+    uint64_t frontendMsgs() const { return frontend_msgs_; }
+    uint64_t backendMsgs() const { return backend_msgs_; }
+
     bool bind(const std::string &frontend, const std::string &backend) {
         LOG_TRACE("ZMQ", "Proxy Frontend listening : %s", frontend.c_str());
         LOG_TRACE("ZMQ", "Proxy Backend  listening : %s", backend.c_str());
@@ -181,40 +215,49 @@ public:
         };
 
         //  Switch messages between sockets
-        if (true) {
-            zmq::message_t message;
-            int more;               //  Multipart detection
+        zmq::poll(&items[0], 2, timeout);
 
-            zmq::poll(&items[0], 2, timeout);
+        size_t frontend = 0;
+        size_t backend = 0;
 
-            if (items[0].revents & ZMQ_POLLIN) {
-                while (1) {
-                    //  Process all parts of the message
-                    frontend_socket_->recv(&message);
-//                    dumpmsg(message);
-                    LOGGER_DEBUG("ZMQBroker", "FRONTEND->BACKEND")
-                    size_t more_size = sizeof(more);
-                    frontend_socket_->getsockopt(ZMQ_RCVMORE, &more, &more_size);
-                    backend_socket_->send(message, more ? ZMQ_SNDMORE : 0);
-
-                    if (!more)
-                        break;      //  Last message part
-                }
-            }
-            if (items[1].revents & ZMQ_POLLIN) {
-                while (1) {
-                    //  Process all parts of the message
-                    backend_socket_->recv(&message);
-//                    dumpmsg(message);
-                    LOGGER_DEBUG("ZMQBroker", "BACKEND->FRONTEND")
-                    size_t more_size = sizeof(more);
-                    backend_socket_->getsockopt(ZMQ_RCVMORE, &more, &more_size);
-                    frontend_socket_->send(message, more ? ZMQ_SNDMORE : 0);
-                    if (!more)
-                        break;      //  Last message part
-                }
+        if (items[0].revents & ZMQ_POLLIN)
+            frontend = forward(*frontend_socket_, *backend_socket_);
+
+        if (items[1].revents & ZMQ_POLLIN)
+            backend = forward(*backend_socket_, *frontend_socket_);
+
+        frontend_msgs_ += frontend;
+        backend_msgs_ += backend;
+
+        if (frontend || backend)
+            LOGB_TRACE("ZMQ", "Broker forwarded: frontend={} backend={}", frontend, backend);
+    }
+
+protected:
+    //
+    // Forward whole multipart messages until none is ready or the budget is used up.
+    // Frames are handed over to the other socket without copying.
+    //
+    size_t forward(zmq::socket_t &from, zmq::socket_t &to) {
+        size_t count = 0;
+        int more = 0;
+        size_t more_size = sizeof(more);
+
+        for (; count < budget_; ++count) {
+            if (!from.recv(&message_, ZMQ_DONTWAIT))
+                break;
+
+            while (true) {
+                from.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+                to.send(message_, more ? ZMQ_SNDMORE : 0);
+                if (!more)
+                    break;      //  Last message part
+
+                from.recv(&message_);
             }
         }
+
+        return count;
     }
 
 private:
@@ -224,6 +267,12 @@ private:
 
     std::string frontend_address_;
     std::string backend_address_;
+
+    zmq::message_t message_;
+
+    size_t budget_;
+    uint64_t frontend_msgs_;
+    uint64_t backend_msgs_;
 };
 
 class ZMQWorker {
@@ -291,7 +340,7 @@ protected:
         zmq::message_t err;
 
         try {
-            auto replybin = msg_dispatcher_.dispatch(std::string((char*)request.data(), request.size()));
+            auto replybin = msg_dispatcher_.dispatch((const char *) request.data(), request.size());
             if (replybin) {
                 zmq::message_t reply(replybin->data(), replybin->size());
                 socket_->send(reply);
@@ -3,6 +3,7 @@
 #include "async.h"
 #include "eventloop.h"
 #include "redis.h"
+#include "redis_pubsub.h"
 #include "tinylogger.h"
 
 uint32_t randint(uint64_t start, uint64_t end) {
@@ -271,12 +272,37 @@ void demo_zset() {
     }));
 }
 
+void demo_pubsub() {
+    static RedisPubSub bus("redis://127.0.0.1:6379");
+    if (bus.channels())
+        return;
+
+    // two handlers of one type, the message is decoded once for both
+    bus.subscribe<std::vector<std::string>>("world.chat", [](const std::vector<std::string> &chat) {
+        LOGGER_INFO("pubsub", "chat-1: " << chat[0] << ": " << chat[1]);
+    });
+    bus.subscribe<std::vector<std::string>>("world.chat", [](const std::vector<std::string> &chat) {
+        LOGGER_INFO("pubsub", "chat-2: " << chat[0] << ": " << chat[1]);
+    });
+
+    bus.psubscribe("guild.*", [](const RedisStringView &channel, const RedisStringView &payload) {
+        LOGGER_INFO("pubsub", channel.str() << ": " << payload.str());
+    });
+
+    // published in the same tick, one EVALSHA
+    EventLoop::instance()->onTimer([]() {
+        bus.publish("world.chat", std::vector<std::string>{"David++", "hello"});
+        bus.publish("guild.1001", std::string("guild 1001 level up"));
+        bus.publish("guild.1002", std::string("guild 1002 disbanded"));
+    }, 1, 0.5);
+}
+
 int main(int argc, const char *argv[]) {
     std::srand(std::time(0));
 
     if (argc < 2) {
         std::cout << "Usage:" << argv[0]
-                  << " simple | hash | key | list" << std::endl;
+                  << " simple | hash | key | list | pubsub" << std::endl;
         return 1;
     }
 
@@ -303,6 +329,8 @@ int main(int argc, const char *argv[]) {
             demo_key();
         else if ("zset" == op)
             demo_zset();
+        else if ("pubsub" == op)
+            demo_pubsub();
 
     }, 2, 1);
 
@@ -13,6 +13,7 @@
 #include <unordered_set>
 #include "tinyserializer.h"
 #include "tinyserializer_proto.h"
+#include "tinyserializer_proto_wire.h"
 #include "tinyorm.h"
 #include "tinyorm_mysql.h"
 
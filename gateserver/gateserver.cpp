@@ -71,7 +71,7 @@ void GateServer::syncInfo2Login()
 		Cmd::Server::SyncGateUserCount sync;
 		sync.set_gate_ip(listen.host);
 		sync.set_gate_port(listen.port);
-		sync.set_usercount(acceptor()->size());
+		sync.set_usercount(sessionCount());
 		connector()->sendTo(1, sync);
 	}
 }
\ No newline at end of file
@@ -5,9 +5,20 @@
 #include "loginserver.h"
 #include <boost/lexical_cast.hpp>
 
+/// retcode: 请求过于频繁
+const uint32 kRetCode_Throttled = 2;
+
 void onRegisterWithDeviceID(Cmd::Account::RegisterWithDeviceIDRequest* proto, 
 	NetAsio::ConnectionPtr conn)
 {
+	if (!LoginServer::instance()->allow(conn))
+	{
+		Cmd::Account::RegisterWithDeviceIDReply reply;
+		reply.set_retcode(kRetCode_Throttled);
+		conn->send(reply);
+		return;
+	}
+
 	ScopedMySqlConnection mysql(LoginServer::account_dbpool);
 	if (mysql)
 	{
@@ -85,6 +96,14 @@ void onRegisterBindNamePassword(Cmd::Account::RegisterBindNamePasswordRequest* p
 void onLoginWithNamePasswd(Cmd::Account::LoginWithNamePasswdReq* proto, 
 	NetAsio::ConnectionPtr conn)
 {
+	if (!LoginServer::instance()->allow(conn, proto->username()))
+	{
+		Cmd::Account::LoginWithNamePasswdRep reply;
+		reply.set_retcode(kRetCode_Throttled);
+		conn->send(reply);
+		return;
+	}
+
 	ScopedMySqlConnection mysql(LoginServer::account_dbpool);
 	if (mysql)
 	{
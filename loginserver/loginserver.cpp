@@ -10,6 +10,7 @@
 static LoggerPtr logger(Logger::getLogger("login"));
 
 MySqlConnectionPool* LoginServer::account_dbpool = NULL;
+RedisConnectionPool* LoginServer::ratelimit_pool = NULL;
 
 #include "account.h"
 
@@ -22,7 +23,7 @@ void onSyncFromGate(Cmd::Server::SyncGateUserCount* proto,
 	LOG4CXX_INFO(logger, "收到网关信息:" <<  proto->gate_ip() << ":" << proto->gate_port() << ", 连接数量:" << proto->usercount());
 }
 
-LoginServer::LoginServer() : AppBase("loginserver")
+LoginServer::LoginServer() : AppBase("loginserver"), ip_bucket_(20, 5, 4), account_window_(5, 60000)
 {
 	user_msg_dispatcher_.bind<Cmd::Account::RegisterWithDeviceIDRequest, NetAsio::ConnectionPtr>(
 		onRegisterWithDeviceID);
@@ -84,6 +85,22 @@ bool LoginServer::init()
 		createTables();
 	}
 
+	// 限流: <redis>不配置则不限
+	if (config_.get<std::string>("redis", "").size())
+	{
+		LoginServer::ratelimit_pool = new RedisConnectionPool();
+		LoginServer::ratelimit_pool->setServerAddress(config_.get<std::string>("redis"));
+		LoginServer::ratelimit_pool->createAll();
+
+		ip_bucket_ = TokenBucket(config_.get("ratelimit.<xmlattr>.ip_burst", 20),
+			config_.get("ratelimit.<xmlattr>.ip_rate", 5.0),
+			config_.get("ratelimit.<xmlattr>.ip_batch", 4));
+		account_window_ = SlidingWindow(config_.get("ratelimit.<xmlattr>.account_limit", 5),
+			config_.get("ratelimit.<xmlattr>.account_window", 60000));
+
+		limiter_.reset(new RedisRateLimiter(LoginServer::ratelimit_pool));
+	}
+
 	id_ = config_.get("<xmlattr>.id", 0);
 
 	const size_t iothreads = config_.get("iothreads", 1);
@@ -154,6 +171,28 @@ void LoginServer::fini()
 }
 
 
+bool LoginServer::allow(NetAsio::ConnectionPtr conn, const std::string& account)
+{
+	if (!limiter_)
+		return true;
+
+	boost::system::error_code ec;
+	boost::asio::ip::tcp::endpoint remote = conn->socket().remote_endpoint(ec);
+	if (!ec && !limiter_->acquire("login:ip:" + remote.address().to_string(), ip_bucket_))
+	{
+		LOG4CXX_WARN(logger, "IP请求过于频繁:" << remote.address().to_string());
+		return false;
+	}
+
+	if (account.size() && !limiter_->hit("login:account:" + account, account_window_))
+	{
+		LOG4CXX_WARN(logger, "账号请求过于频繁:" << account);
+		return false;
+	}
+
+	return true;
+}
+
 void LoginServer::run()
 {
 	if (io_service_pool_)
@@ -3,12 +3,16 @@
 
 #include "app.h"
 #include "mydb.h"
+#include "myredis_ratelimit.h"
 
 class LoginServer : public AppBase
 {
 public:
 	static MySqlConnectionPool* account_dbpool;
 
+	/// 限流(可选), 多个登录服务器共享
+	static RedisConnectionPool* ratelimit_pool;
+
 public:
 	LoginServer();
 
@@ -22,6 +26,9 @@ public:
 	virtual void run();
 	virtual void fini();
 
+	/// 登录/注册限流: 每IP令牌桶, 有账号时再按账号滑动窗口
+	bool allow(NetAsio::ConnectionPtr conn, const std::string& account = "");
+
 	boost::asio::io_service* get_signal_service()
 	{
 		return worker_pool_ ? &worker_pool_->get_io_service() : NULL;
@@ -63,6 +70,11 @@ private:
 
 	/// 配置
 	boost::property_tree::ptree config_;
+
+	/// 限流
+	boost::shared_ptr<RedisRateLimiter> limiter_;
+	TokenBucket ip_bucket_;
+	SlidingWindow account_window_;
 };
 
 #endif // _LOGINSERVER_H
\ No newline at end of file
@@ -0,0 +1,182 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include "mycache2_codec.h"
+
+using mycache::KVMap;
+using mycache::HashCodec;
+using mycache::HasKVMap;
+
+struct CodecPlayer {
+    int id = 0;
+    std::string name;
+    float salary = 0;
+    std::vector<int> scores;
+};
+
+RUN_ONCE(CodecPlayer) {
+    StructFactory::instance().declare<CodecPlayer>("CodecPlayer")
+            .property("id", &CodecPlayer::id, 1)
+            .property("name", &CodecPlayer::name, 2)
+            .property("salary", &CodecPlayer::salary, 3)
+            .property<ProtoSerializer>("scores", &CodecPlayer::scores, 4);
+}
+
+// parseFromKVMap taking a const KVMap&
+struct CodecUser {
+    std::string name;
+    std::string age;
+
+    bool parseFromKVMap(const KVMap &kvs) {
+        KVMap::const_iterator it = kvs.find("name");
+        if (it == kvs.end())
+            return false;
+        name = it->second;
+        it = kvs.find("age");
+        age = (it != kvs.end() ? it->second : "");
+        return true;
+    }
+
+    bool saveToKVMap(KVMap &kvs) const {
+        kvs["name"] = name;
+        kvs["age"] = age;
+        return true;
+    }
+};
+
+struct CodecLegacyUser {
+    bool parseFromKVMap(KVMap &kvs) { return true; }
+    bool saveToKVMap(KVMap &kvs) const { return true; }
+};
+
+// redisReply trees built in memory, as hiredis would return them
+struct FakeReply {
+    std::vector<std::string> strings;
+    std::vector<redisReply> elements;
+    std::vector<redisReply *> pointers;
+    redisReply array;
+
+    // "" at a nil index
+    FakeReply(const std::vector<std::string> &items, const std::vector<size_t> &nils = std::vector<size_t>())
+            : strings(items), elements(items.size()), pointers(items.size()) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            redisReply &r = elements[i];
+            std::memset(&r, 0, sizeof(r));
+            bool nil = std::find(nils.begin(), nils.end(), i) != nils.end();
+            r.type = nil ? REDIS_REPLY_NIL : REDIS_REPLY_STRING;
+            r.str = nil ? nullptr : &strings[i][0];
+            r.len = nil ? 0 : strings[i].size();
+            pointers[i] = &r;
+        }
+        std::memset(&array, 0, sizeof(array));
+        array.type = REDIS_REPLY_ARRAY;
+        array.elements = pointers.size();
+        array.element = pointers.data();
+    }
+
+    RedisReplyView view() { return RedisReplyView(&array); }
+};
+
+TEST_CASE("KVMap types detected by either signature", "[HashCodec]") {
+    REQUIRE(HasKVMap<CodecUser>::value);
+    REQUIRE(HasKVMap<CodecLegacyUser>::value);
+    REQUIRE_FALSE(HasKVMap<CodecPlayer>::value);
+}
+
+TEST_CASE("BinaryField round trip", "[HashCodec]") {
+    typedef BinaryField<int, ProtoSerializer<int>> IntField;
+    typedef BinaryField<double, ProtoSerializer<double>> DoubleField;
+    typedef BinaryField<std::string, ProtoSerializer<std::string>> StringField;
+    typedef BinaryField<std::vector<int>, ProtoSerializer<std::vector<int>>> VectorField;
+
+    std::string bin;
+    int i = 0;
+    IntField::encode(-12345, bin);
+    REQUIRE(bin.size() == sizeof(int));
+    REQUIRE(IntField::decode(i, bin.data(), bin.size()));
+    REQUIRE(i == -12345);
+    REQUIRE_FALSE(IntField::decode(i, bin.data(), bin.size() - 1));
+
+    double d = 0;
+    DoubleField::encode(3.25, bin);
+    REQUIRE(DoubleField::decode(d, bin.data(), bin.size()));
+    REQUIRE(d == 3.25);
+
+    std::string s;
+    StringField::encode(std::string("a\0b", 3), bin);
+    REQUIRE(bin == std::string("a\0b", 3));
+    REQUIRE(StringField::decode(s, bin.data(), bin.size()));
+    REQUIRE(s == std::string("a\0b", 3));
+
+    std::vector<int> v;
+    VectorField::encode({1, 2, 3}, bin);
+    REQUIRE(VectorField::decode(v, bin.data(), bin.size()));
+    REQUIRE(v == std::vector<int>({1, 2, 3}));
+}
+
+TEST_CASE("reflected struct through HMSET and HGETALL/HMGET", "[HashCodec]") {
+    CodecPlayer p;
+    p.id = 7;
+    p.name = "david";
+    p.salary = 1.5;
+    p.scores = {10, 20};
+
+    std::vector<std::string> args;
+    REQUIRE(HashCodec<CodecPlayer>::encode(args, "player:7", p));
+    REQUIRE(args.size() == 2 + 2 * 4);
+    REQUIRE(args[0] == "HMSET");
+    REQUIRE(args[1] == "player:7");
+
+    // HGETALL replies the field/value pairs
+    FakeReply hash(std::vector<std::string>(args.begin() + 2, args.end()));
+    CodecPlayer q;
+    REQUIRE(HashCodec<CodecPlayer>::decode(q, hash.view()));
+    REQUIRE(q.id == 7);
+    REQUIRE(q.name == "david");
+    REQUIRE(q.salary == 1.5);
+    REQUIRE(q.scores == p.scores);
+
+    // HMGET name id salary, salary not there
+    FakeReply values({args[5], args[3], ""}, {2});
+    CodecPlayer r;
+    REQUIRE(HashCodec<CodecPlayer>::decodeFields(r, {"name", "id", "salary"}, values.view()));
+    REQUIRE(r.id == 7);
+    REQUIRE(r.name == "david");
+    REQUIRE(r.salary == 0);
+
+    // all nil: not found
+    FakeReply nils({"", ""}, {0, 1});
+    REQUIRE_FALSE(HashCodec<CodecPlayer>::decodeFields(r, {"name", "id"}, nils.view()));
+
+    // a field of the wrong size
+    FakeReply bad({"id", "x"});
+    REQUIRE_FALSE(HashCodec<CodecPlayer>::decode(r, bad.view()));
+}
+
+TEST_CASE("KVMap type through HMSET and HGETALL/HMGET", "[HashCodec]") {
+    CodecUser u;
+    u.name = "david";
+    u.age = "18";
+
+    std::vector<std::string> args;
+    REQUIRE(HashCodec<CodecUser>::encode(args, "user:1", u));
+    REQUIRE(args == std::vector<std::string>({"HMSET", "user:1", "age", "18", "name", "david"}));
+
+    FakeReply hash(std::vector<std::string>(args.begin() + 2, args.end()));
+    CodecUser v;
+    REQUIRE(HashCodec<CodecUser>::decode(v, hash.view()));
+    REQUIRE(v.name == "david");
+    REQUIRE(v.age == "18");
+
+    FakeReply values({"david", ""}, {1});
+    CodecUser w;
+    REQUIRE(HashCodec<CodecUser>::decodeFields(w, {"name", "age"}, values.view()));
+    REQUIRE(w.name == "david");
+    REQUIRE(w.age == "");
+
+    FakeReply empty(std::vector<std::string>{});
+    REQUIRE_FALSE(HashCodec<CodecUser>::decode(w, empty.view()));
+}
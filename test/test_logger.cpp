@@ -142,6 +142,34 @@ void test_tinylogger()
 	LOGGER_FATAL(__FUNCTION__, "hello " << 2011 << " !");
 }
 
+void test_tinylogger_async()
+{
+	SimpleLogger::instance().set_level(SIMPLE_LOGGER_DEBUG);
+	SimpleLogger::instance().start_async("test_tinylogger.log", 1024 * 1024, 3600);
+
+	for (int i = 0; i < 10000; ++ i)
+	{
+		LOG_TRACE(__FUNCTION__, "disabled %d", i);
+		LOGGER_DEBUG(__FUNCTION__, "hello " << i << " !");
+	}
+
+	SimpleLogger::instance().stop();
+	LOGGER_INFO(__FUNCTION__, "dropped: " << SimpleLogger::instance().dropped());
+}
+
+// tinylogdump test_tinylogger.blog
+void test_tinylogger_binary()
+{
+	LOGB_INFO(__FUNCTION__, "text now: {} {} {}", 2011, "hello", 3.14);
+
+	SimpleLogger::instance().start_async("test_tinylogger.blog", 1024 * 1024, 3600, true);
+
+	for (int i = 0; i < 10000; ++ i)
+		LOGB_DEBUG(__FUNCTION__, "hello {} {} !", i, std::string("world"));
+
+	SimpleLogger::instance().stop();
+}
+
 
 int main(int argc, char **argv)
 {
@@ -160,6 +188,8 @@ int main(int argc, char **argv)
 	}
 
 	test_tinylogger();
+	test_tinylogger_async();
+	test_tinylogger_binary();
 	return 0;
 
 	//initSMTP();
@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "tinymetrics.h"
+
+TEST_CASE("histogram buckets", "[Metrics]") {
+    for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull}) {
+        size_t bucket = HistogramMetric::bucket(v);
+        REQUIRE(bucket < HistogramMetric::kBuckets);
+        REQUIRE(HistogramMetric::upper(bucket) >= v);
+        if (bucket)
+            REQUIRE(HistogramMetric::upper(bucket - 1) < v);
+    }
+}
+
+TEST_CASE("counter and histogram from threads", "[Metrics]") {
+    CounterMetric &counter = Metrics::counter("test.count");
+    HistogramMetric &histogram = Metrics::histogram("test.latency_us");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&counter, &histogram]() {
+            for (uint64_t i = 1; i <= 1000; ++i) {
+                counter.inc();
+                histogram.observe(i);
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    REQUIRE(counter.value() == 4000);
+    REQUIRE(&Metrics::counter("test.count") == &counter);
+
+    HistogramMetric::Snapshot snap = histogram.snapshot();
+    REQUIRE(snap.count == 4000);
+    REQUIRE(snap.max == 1000);
+    REQUIRE(snap.mean() == Approx(500.5));
+
+    // within a bucket(12.5%)
+    REQUIRE(snap.percentile(0.5) >= 500);
+    REQUIRE(snap.percentile(0.5) <= 500 * 1.125);
+    REQUIRE(snap.percentile(0.99) >= 990);
+    REQUIRE(snap.percentile(0.99) <= 1000);
+}
+
+TEST_CASE("gauge", "[Metrics]") {
+    GaugeMetric &gauge = Metrics::gauge("test.gauge");
+    gauge.set(10);
+    gauge.add(5);
+    gauge.sub(3);
+    REQUIRE(gauge.value() == 12);
+
+    std::string dump = Metrics::instance().dumpString();
+    REQUIRE(dump.find("gauge     test.gauge 12") != std::string::npos);
+}
+
+TEST_CASE("remove", "[Metrics]") {
+    Metrics::histogram("test.removed").observe(1);
+    REQUIRE(Metrics::instance().dumpString().find("test.removed") != std::string::npos);
+
+    Metrics::remove("test.removed");
+    REQUIRE(Metrics::instance().dumpString().find("test.removed") == std::string::npos);
+
+    // a new one under the same name
+    REQUIRE(Metrics::histogram("test.removed").snapshot().count == 0);
+}
+
+static std::string httpGet(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    std::string response;
+    if (::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        ::send(fd, "GET / HTTP/1.0\r\n\r\n", 18, MSG_NOSIGNAL);
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0)
+            response.append(buf, n);
+    }
+    ::close(fd);
+    return response;
+}
+
+TEST_CASE("reporter serves, stops and serves again", "[Metrics]") {
+    MetricsReporter &reporter = MetricsReporter::instance();
+    Metrics::counter("test.served").inc();
+
+    const uint16_t port = 19000 + ::getpid() % 1000;
+    REQUIRE(reporter.serveHttp(port));
+    REQUIRE_FALSE(reporter.serveHttp(port));
+    REQUIRE(httpGet(port).find("test.served") != std::string::npos);
+
+    // from several threads at once
+    std::vector<std::thread> stoppers;
+    for (int i = 0; i < 4; ++i)
+        stoppers.emplace_back([&reporter]() { reporter.stop(); });
+    for (auto &t : stoppers)
+        t.join();
+    REQUIRE(httpGet(port).empty());
+
+    REQUIRE(reporter.serveHttp(port));
+    REQUIRE(httpGet(port).find("200 OK") != std::string::npos);
+    reporter.stop();
+}
@@ -0,0 +1,217 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+#include <ev.h>
+#include <hiredis/hiredis.h>
+#include "redis_pubsub.h"
+
+using namespace tiny;
+
+// a blocking connection beside the loop, to look at the server
+struct LocalRedis {
+    LocalRedis() {
+        struct timeval timeout = {0, 200 * 1000};
+        context = redisConnectWithTimeout("127.0.0.1", 6379, timeout);
+        if (context && context->err) {
+            redisFree(context);
+            context = nullptr;
+        }
+    }
+
+    ~LocalRedis() {
+        if (context) redisFree(context);
+    }
+
+    std::string command(const std::vector<std::string> &args) {
+        std::vector<const char *> argv;
+        std::vector<size_t> argvlen;
+        for (auto &arg : args) {
+            argv.push_back(arg.data());
+            argvlen.push_back(arg.size());
+        }
+
+        redisReply *reply = (redisReply *) redisCommandArgv(context, (int) args.size(), argv.data(), argvlen.data());
+        std::string result;
+        if (reply && reply->type == REDIS_REPLY_INTEGER)
+            result = std::to_string(reply->integer);
+        else if (reply && reply->str)
+            result.assign(reply->str, reply->len);
+        if (reply) freeReplyObject(reply);
+        return result;
+    }
+
+    // cmdstat_<name>:calls=N of INFO commandstats
+    long long calls(const std::string &name) {
+        std::string info = command({"INFO", "commandstats"});
+        std::string tag = "cmdstat_" + name + ":calls=";
+        size_t at = info.find(tag);
+        return at == std::string::npos ? 0 : std::atoll(info.c_str() + at + tag.size());
+    }
+
+    redisContext *context = nullptr;
+};
+
+// deserialize() calls, to see a message decoded once for all its handlers
+static int s_decoded = 0;
+
+template<typename T>
+struct CountingSerializer {
+    std::string serialize(const T &object) const {
+        return ProtoSerializer<T>().serialize(object);
+    }
+
+    bool deserialize(T &object, const std::string &bin) const {
+        s_decoded++;
+        return ProtoSerializer<T>().deserialize(object, bin);
+    }
+};
+
+typedef std::vector<std::string> Chat;
+
+// steps at the given seconds of the loop, then stop it
+static void runSteps(EventLoop &loop, const std::vector<std::pair<double, std::function<void()>>> &steps) {
+    double last = 0;
+    for (auto &step : steps) {
+        std::function<void()> fn = step.second;
+        bool done = false;
+        loop.onTimer([fn, done]() mutable {
+            if (!done) {
+                done = true;
+                fn();
+            }
+        }, 0, step.first);
+        last = std::max(last, step.first);
+    }
+
+    struct ev_loop *evloop = loop.evLoop();
+    loop.onTimer([evloop]() { ev_break(evloop, EVBREAK_ALL); }, 0, last + 0.5);
+    loop.run();
+}
+
+static std::string channel(const std::string &name) {
+    return "test.pubsub." + name + "." + std::to_string(::getpid());
+}
+
+TEST_CASE("typed fan-out decodes once per type", "[PubSub]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    EventLoop loop(false);
+    RedisPubSub bus("redis://127.0.0.1:6379", &loop);
+    const std::string chat = channel("chat");
+
+    std::vector<std::string> got;
+    bus.subscribe<Chat, CountingSerializer>(chat, [&got](const Chat &msg) { got.push_back("a:" + msg[1]); });
+    bus.subscribe<Chat, CountingSerializer>(chat, [&got](const Chat &msg) { got.push_back("b:" + msg[1]); });
+    bus.subscribe(chat, [&got](const RedisStringView &from, const RedisStringView &payload) {
+        got.push_back("raw:" + from.str());
+    });
+    REQUIRE(bus.channels() == 1);
+
+    s_decoded = 0;
+    runSteps(loop, {
+            {0.3, [&bus, &chat]() { bus.publish<Chat, CountingSerializer>(chat, Chat{"david", "hi"}); }},
+    });
+
+    // the groups of a channel run in no given order
+    std::sort(got.begin(), got.end());
+    REQUIRE(s_decoded == 1);
+    REQUIRE(got == std::vector<std::string>({"a:hi", "b:hi", "raw:" + chat}));
+}
+
+TEST_CASE("messages of a tick go in one EVALSHA", "[PubSub]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    EventLoop loop(false);
+    RedisPubSub bus("redis://127.0.0.1:6379", &loop);
+    const std::string pattern = channel("guild") + ".*";
+
+    std::vector<std::string> got;
+    bus.psubscribe(pattern, [&got](const RedisStringView &from, const RedisStringView &payload) {
+        got.push_back(payload.str());
+    });
+
+    long long evalsha = 0, publish = 0;
+    runSteps(loop, {
+            {0.3, [&]() {
+                evalsha = redis.calls("evalsha");
+                publish = redis.calls("publish");
+                for (int i = 0; i < 5; ++i)
+                    bus.publish(channel("guild") + ".1", std::to_string(i));
+            }},
+    });
+
+    REQUIRE(got == std::vector<std::string>({"0", "1", "2", "3", "4"}));
+    // PUBLISHed by the script
+    REQUIRE(redis.calls("evalsha") == evalsha + 1);
+    REQUIRE(redis.calls("publish") == publish + 5);
+}
+
+TEST_CASE("subscribed again after the subscriber is lost", "[PubSub]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    EventLoop loop(false);
+    RedisPubSub bus("redis://127.0.0.1:6379", &loop);
+    const std::string news = channel("news");
+
+    std::vector<std::string> got;
+    bus.subscribe(news, [&got](const RedisStringView &from, const RedisStringView &payload) {
+        got.push_back(payload.str());
+    });
+
+    runSteps(loop, {
+            {0.3, [&]() { bus.publish(news, "before"); }},
+            // drop the subscriber connections
+            {0.5, [&]() { redis.command({"CLIENT", "KILL", "TYPE", "pubsub"}); }},
+            // check() runs every second and subscribes again
+            {2.8, [&]() { bus.publish(news, "after"); }},
+    });
+
+    REQUIRE(got == std::vector<std::string>({"before", "after"}));
+    REQUIRE(bus.channels() == 1);
+}
+
+TEST_CASE("a pattern and a channel of the same name", "[PubSub]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    EventLoop loop(false);
+    RedisPubSub bus("redis://127.0.0.1:6379", &loop);
+    const std::string name = channel("star") + "*";
+
+    std::vector<std::string> got;
+    bus.psubscribe(name, [&got](const RedisStringView &from, const RedisStringView &payload) {
+        got.push_back("p:" + payload.str());
+    });
+    bus.subscribe(name, [&got](const RedisStringView &from, const RedisStringView &payload) {
+        got.push_back("s:" + payload.str());
+    });
+    REQUIRE(bus.channels() == 2);
+
+    runSteps(loop, {
+            {0.3, [&]() {
+                bus.publish(name, "both");
+                bus.publish(channel("star") + ".1", "pattern");
+            }},
+    });
+
+    std::sort(got.begin(), got.end());
+    REQUIRE(got == std::vector<std::string>({"p:both", "p:pattern", "s:both"}));
+}
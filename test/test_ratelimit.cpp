@@ -0,0 +1,162 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <hiredis/hiredis.h>
+#include "redis_ratelimit.h"
+
+TEST_CASE("reserved tokens are spent locally", "[RateLimit]") {
+    RedisTokenCache cache;
+    REQUIRE(cache.take("ip:1", 0) == RedisTokenCache::kMiss);
+
+    cache.put("ip:1", 2, 1000, 0);
+    REQUIRE(cache.take("ip:1", 10) == RedisTokenCache::kGranted);
+    REQUIRE(cache.take("ip:1", 20) == RedisTokenCache::kGranted);
+
+    // used up: ask Redis again
+    REQUIRE(cache.take("ip:1", 30) == RedisTokenCache::kMiss);
+    REQUIRE(cache.size() == 0);
+}
+
+TEST_CASE("refused keys until the deadline", "[RateLimit]") {
+    RedisTokenCache cache;
+    cache.put("ip:2", 0, 100, 0);
+    REQUIRE(cache.take("ip:2", 50) == RedisTokenCache::kDenied);
+    REQUIRE(cache.take("ip:2", 100) == RedisTokenCache::kMiss);
+    REQUIRE(cache.size() == 0);
+}
+
+TEST_CASE("expired keys swept when full", "[RateLimit]") {
+    RedisTokenCache cache(2);
+    cache.put("a", 1, 10, 0);
+    cache.put("b", 1, 100, 0);
+    cache.put("c", 1, 100, 50);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.take("a", 50) == RedisTokenCache::kMiss);
+    REQUIRE(cache.take("b", 50) == RedisTokenCache::kGranted);
+}
+
+TEST_CASE("window members unique per hit and per process", "[RateLimit]") {
+    SlidingWindow window(2, 1000);
+    std::vector<std::string> a = RedisRateLimit::windowArgs(window, 1000);
+    std::vector<std::string> b = RedisRateLimit::windowArgs(window, 1000);
+    REQUIRE(a[3] != b[3]);
+    REQUIRE(a[3].find("1000-" + RedisRateLimit::nonce() + "-") == 0);
+    REQUIRE(RedisRateLimit::nonce().size() == 16);
+}
+
+TEST_CASE("deny for about one token", "[RateLimit]") {
+    REQUIRE(RedisRateLimit::denyFor(TokenBucket(10, 5)) == 200);
+    REQUIRE(RedisRateLimit::denyFor(TokenBucket(10, 0.1, 1, 1000)) == 1000);
+}
+
+//
+// The scripts themselves, run by EVAL on a local redis-server
+// (127.0.0.1:6379), skipped with a warning when there is none
+//
+struct LocalRedis {
+    LocalRedis() {
+        struct timeval timeout = {0, 200 * 1000};
+        context = redisConnectWithTimeout("127.0.0.1", 6379, timeout);
+        if (context && context->err) {
+            redisFree(context);
+            context = nullptr;
+        }
+    }
+
+    ~LocalRedis() {
+        if (context) redisFree(context);
+    }
+
+    // integer reply of the script, -1 if an error
+    long long eval(const RedisScriptPtr &script, const std::string &key, const std::vector<std::string> &args) {
+        return command(script->evalArgs({key}, args));
+    }
+
+    long long command(const std::vector<std::string> &args) {
+        std::vector<const char *> argv;
+        std::vector<size_t> argvlen;
+        for (auto &arg : args) {
+            argv.push_back(arg.data());
+            argvlen.push_back(arg.size());
+        }
+
+        redisReply *reply = (redisReply *) redisCommandArgv(context, (int) args.size(), argv.data(), argvlen.data());
+        long long result = (reply && reply->type == REDIS_REPLY_INTEGER) ? reply->integer : -1;
+        if (reply) freeReplyObject(reply);
+        return result;
+    }
+
+    std::string key(const std::string &name) {
+        std::string key = "test:ratelimit:" + name + ":" + std::to_string(::getpid());
+        command({"DEL", key});
+        return key;
+    }
+
+    redisContext *context = nullptr;
+};
+
+TEST_CASE("token bucket script", "[RateLimit][redis]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    const int64_t now = 1000000;
+    TokenBucket bucket(3, 1);   // 3 burst, 1/s
+    std::string key = redis.key("bucket");
+
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 2, now)) == 2);
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 2, now)) == 1);
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 1, now + 500)) == 0);
+
+    // one token a second
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 2, now + 1500)) == 1);
+    REQUIRE(redis.command({"PTTL", key}) > 0);
+    redis.command({"DEL", key});
+}
+
+TEST_CASE("token bucket script without refill", "[RateLimit][redis]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    const int64_t now = 1000000;
+    TokenBucket bucket(2, 0);
+    std::string key = redis.key("fixed");
+
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 5, now)) == 2);
+    REQUIRE(redis.eval(RedisRateLimit::tokenBucket(), key, RedisRateLimit::bucketArgs(bucket, 1, now + 100000)) == 0);
+    REQUIRE(redis.command({"PTTL", key}) == -1);
+    redis.command({"DEL", key});
+}
+
+TEST_CASE("sliding window script", "[RateLimit][redis]") {
+    LocalRedis redis;
+    if (!redis.context) {
+        WARN("no redis-server on 127.0.0.1:6379");
+        return;
+    }
+
+    const int64_t now = 1000000;
+    SlidingWindow window(2, 1000);
+    std::string key = redis.key("window");
+
+    REQUIRE(redis.eval(RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, now)) == 1);
+    REQUIRE(redis.eval(RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, now + 1)) == 1);
+    REQUIRE(redis.eval(RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, now + 2)) == 0);
+
+    // the first hit left the window
+    REQUIRE(redis.eval(RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, now + 1000)) == 1);
+    REQUIRE(redis.eval(RedisRateLimit::slidingWindow(), key, RedisRateLimit::windowArgs(window, now + 1000)) == 0);
+
+    std::string counter = redis.key("counter");
+    REQUIRE(redis.eval(RedisRateLimit::counter(), counter, RedisRateLimit::counterArgs(2, 1000)) == 2);
+    REQUIRE(redis.eval(RedisRateLimit::counter(), counter, RedisRateLimit::counterArgs(1, 1000)) == 3);
+
+    redis.command({"DEL", key});
+    redis.command({"DEL", counter});
+}
@@ -9,6 +9,7 @@
 #include "tinyserializer.h"
 #include "tinyserializer_proto.h"
 #include "tinyserializer_proto_dyn.h"
+#include "tinyorm.h"
 
 #include "../example/player.pb.h"
 
@@ -249,3 +250,86 @@ TEST_CASE("serialize<ProtoDynSerializer> defined struct", "[ProtoDynSerializer]"
     CHECK(w.type == w2.type);
     CHECK(w.name == w2.name);
 }
+
+
+TEST_CASE("column codec of TableDescriptor", "[FieldCodec]") {
+
+    SECTION("text to scalar") {
+        int8_t i8 = 0;
+        REQUIRE(FieldText<int8_t>::parse(i8, "-128", 4));
+        CHECK(i8 == -128);
+
+        uint64_t u64 = 0;
+        REQUIRE(FieldText<uint64_t>::parse(u64, "18446744073709551615", 20));
+        CHECK(u64 == 18446744073709551615ull);
+
+        double d = 0;
+        REQUIRE(FieldText<double>::parse(d, "3.25", 4));
+        CHECK(d == 3.25);
+
+        bool b = false;
+        REQUIRE(FieldText<bool>::parse(b, "1", 1));
+        CHECK(b);
+
+        uint32_t bad = 0;
+        CHECK_FALSE(FieldText<uint32_t>::parse(bad, "12a", 3));
+    }
+
+    SECTION("member by ordinal") {
+        FieldCodec_T<Weapon, uint32_t> type(&Weapon::type);
+        FieldCodec_T<Weapon, std::string> name(&Weapon::name);
+
+        Weapon w;
+        REQUIRE(type.decode(w, "22", 2));
+        REQUIRE(name.decode(w, "Blade", 5));
+        CHECK(w.type == 22);
+        CHECK(w.name == "Blade");
+
+        std::ostringstream oss;
+        type.encode(oss, w);
+        CHECK(oss.str() == "22");
+
+        std::string buf;
+        CHECK(name.quoted());
+        CHECK(&name.text(w, buf) == &w.name);
+    }
+}
+
+TEST_CASE("integer column text", "[FieldText]") {
+    int8_t i8 = 0;
+    REQUIRE(FieldText<int8_t>::parse(i8, "-128", 4));
+    REQUIRE(i8 == -128);
+    REQUIRE_FALSE(FieldText<int8_t>::parse(i8, "128", 3));
+
+    uint16_t u16 = 0;
+    REQUIRE(FieldText<uint16_t>::parse(u16, "65535", 5));
+    REQUIRE(u16 == 65535);
+    REQUIRE_FALSE(FieldText<uint16_t>::parse(u16, "65536", 5));
+    REQUIRE_FALSE(FieldText<uint16_t>::parse(u16, "-1", 2));
+
+    int64_t i64 = 0;
+    REQUIRE(FieldText<int64_t>::parse(i64, "-9223372036854775808", 20));
+    REQUIRE(i64 == INT64_MIN);
+    REQUIRE_FALSE(FieldText<int64_t>::parse(i64, "9223372036854775808", 19));
+
+    uint64_t u64 = 0;
+    REQUIRE(FieldText<uint64_t>::parse(u64, "+18446744073709551615", 21));
+    REQUIRE(u64 == UINT64_MAX);
+    REQUIRE_FALSE(FieldText<uint64_t>::parse(u64, "18446744073709551616", 20));
+
+    // not a whole decimal
+    int32_t i32 = 7;
+    REQUIRE_FALSE(FieldText<int32_t>::parse(i32, "", 0));
+    REQUIRE_FALSE(FieldText<int32_t>::parse(i32, "-", 1));
+    REQUIRE_FALSE(FieldText<int32_t>::parse(i32, " 1", 2));
+    REQUIRE_FALSE(FieldText<int32_t>::parse(i32, "1x", 2));
+    REQUIRE(i32 == 7);
+
+    // only size bytes
+    REQUIRE(FieldText<int32_t>::parse(i32, "12", 1));
+    REQUIRE(i32 == 1);
+
+    bool b = false;
+    REQUIRE(FieldText<bool>::parse(b, "1", 1));
+    REQUIRE(b);
+}
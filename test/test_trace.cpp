@@ -0,0 +1,174 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+#include "tinytrace.h"
+
+static std::vector<TraceSpanRecord> drained() {
+    std::vector<TraceSpanRecord> spans;
+    Tracer::instance().drain(spans);
+    return spans;
+}
+
+TEST_CASE("sample rate threshold", "[Trace]") {
+    Tracer &tracer = Tracer::instance();
+
+    int sampled = 0;
+    tracer.setSampleRate(0);
+    for (int i = 0; i < 1000; ++i)
+        sampled += tracer.sample() ? 1 : 0;
+    REQUIRE(sampled == 0);
+    REQUIRE_FALSE(Tracer::child().sampled);
+
+    tracer.setSampleRate(1);
+    for (int i = 0; i < 1000; ++i)
+        sampled += tracer.sample() ? 1 : 0;
+    REQUIRE(sampled == 1000);
+
+    tracer.setSampleRate(-1);
+    REQUIRE_FALSE(tracer.sample());
+
+    // about half
+    tracer.setSampleRate(0.5);
+    sampled = 0;
+    for (int i = 0; i < 10000; ++i)
+        sampled += tracer.sample() ? 1 : 0;
+    REQUIRE(sampled > 4000);
+    REQUIRE(sampled < 6000);
+
+    tracer.setSampleRate(0);
+}
+
+TEST_CASE("parent and child ids of spans", "[Trace]") {
+    drained();
+
+    // not sampled: nothing recorded
+    {
+        TraceSpan span("unsampled");
+        REQUIRE_FALSE(span.context().sampled);
+    }
+    REQUIRE(drained().empty());
+
+    Tracer::instance().setSampleRate(1);
+    TraceContext root = Tracer::child();
+    Tracer::instance().setSampleRate(0);
+    REQUIRE(root.sampled);
+    REQUIRE(root.trace_id != 0);
+    REQUIRE(root.span_id != 0);
+    REQUIRE(root.parent_id == 0);
+
+    TraceContext inner;
+    {
+        TraceScope scope(root);
+        REQUIRE(Tracer::current().span_id == root.span_id);
+
+        TraceSpan outer("outer");
+        REQUIRE(outer.context().trace_id == root.trace_id);
+        REQUIRE(outer.context().parent_id == root.span_id);
+        {
+            TraceSpan span("inner");
+            inner = span.context();
+            REQUIRE(inner.parent_id == outer.context().span_id);
+            REQUIRE(Tracer::current().span_id == inner.span_id);
+
+            // a child context of the running span, as RPCHolder takes it
+            TraceContext call = Tracer::child();
+            REQUIRE(call.trace_id == root.trace_id);
+            REQUIRE(call.parent_id == inner.span_id);
+        }
+        REQUIRE(Tracer::current().span_id == outer.context().span_id);
+    }
+    REQUIRE_FALSE(Tracer::current().sampled);
+
+    std::vector<TraceSpanRecord> spans = drained();
+    REQUIRE(spans.size() == 2);
+    REQUIRE(spans[0].name == "inner");
+    REQUIRE(spans[0].span_id == inner.span_id);
+    REQUIRE(spans[1].name == "outer");
+    REQUIRE(spans[1].parent_id == root.span_id);
+    REQUIRE(spans[1].duration_us >= spans[0].duration_us);
+}
+
+TEST_CASE("buffer overflow drops the oldest", "[Trace]") {
+    drained();
+
+    TraceContext ctx;
+    ctx.trace_id = 1;
+    ctx.span_id = 2;
+    ctx.sampled = true;
+
+    uint64_t dropped = Tracer::instance().dropped();
+    for (int i = 0; i < TRACE_BUFFER_MAX + 10; ++i)
+        Tracer::instance().record(ctx, std::to_string(i), i, 1);
+    REQUIRE(Tracer::instance().dropped() == dropped + 10);
+
+    std::vector<TraceSpanRecord> spans = drained();
+    REQUIRE(spans.size() == TRACE_BUFFER_MAX);
+    REQUIRE(spans.front().name == "10");
+
+    // negative durations clamp to 0, unsampled contexts are not recorded
+    Tracer::instance().record(ctx, "clock", 100, -5);
+    ctx.sampled = false;
+    Tracer::instance().record(ctx, "unsampled", 100, 5);
+    spans = drained();
+    REQUIRE(spans.size() == 1);
+    REQUIRE(spans[0].duration_us == 0);
+}
+
+TEST_CASE("exporter line format", "[Trace]") {
+    drained();
+
+    char filename[] = "/tmp/test_trace.XXXXXX";
+    int fd = mkstemp(filename);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    TraceContext ctx;
+    ctx.trace_id = 0xabc;
+    ctx.span_id = 0x12;
+    ctx.parent_id = 0x1;
+    ctx.sampled = true;
+    Tracer::instance().record(ctx, "load player", 1500000000000000LL, 42);
+
+    REQUIRE(Tracer::instance().exportTo(filename, 100));
+    REQUIRE_FALSE(Tracer::instance().exportTo(filename, 100));
+    Tracer::instance().stop();
+
+    std::ifstream in(filename);
+    std::string line;
+    REQUIRE(std::getline(in, line));
+    REQUIRE(line == "0000000000000abc 0000000000000012 0000000000000001 1500000000000000 42 load player");
+    REQUIRE_FALSE(std::getline(in, line));
+
+    unlink(filename);
+}
+
+TEST_CASE("exporter started and stopped from several threads", "[Trace]") {
+    char filename[] = "/tmp/test_trace.XXXXXX";
+    int fd = mkstemp(filename);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    for (int round = 0; round < 20; ++round) {
+        std::atomic<int> started{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&started, &filename]() {
+                if (Tracer::instance().exportTo(filename, 100))
+                    started++;
+                Tracer::instance().stop();
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        REQUIRE(started >= 1);
+    }
+    Tracer::instance().stop();
+
+    unlink(filename);
+}
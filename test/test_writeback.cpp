@@ -0,0 +1,105 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+
+#include "catch.hpp"
+
+#include <unistd.h>
+#include "mycached_writeback.h"
+
+static std::string journalPath(const std::string& name)
+{
+	std::string path = "/tmp/test_writeback." + std::to_string(::getpid()) + "." + name;
+	remove(path.c_str());
+	remove((path + ".flushing").c_str());
+	return path;
+}
+
+TEST_CASE("journal replayed by the next run", "[WriteBack]") {
+	std::string path = journalPath("replay");
+	{
+		MyCacheWriteBack writeback(0, path);
+		REQUIRE(writeback.open());
+		REQUIRE(writeback.push("a", "1", 10));
+		REQUIRE(writeback.push("b", "2", 11));
+		REQUIRE(writeback.push("a", "3", 12));
+		REQUIRE(writeback.erase("b", 13));
+	}
+
+	MyCacheWriteBack writeback(0, path);
+	REQUIRE(writeback.open());
+	REQUIRE(writeback.pending() == 2);
+
+	MyCacheWriteBack::Entry entry;
+	REQUIRE(writeback.lookup("a", entry));
+	REQUIRE(entry.value == "3");
+	REQUIRE(entry.version == 12);
+	REQUIRE(writeback.lookup("b", entry));
+	REQUIRE(entry.erased);
+
+	remove(path.c_str());
+}
+
+TEST_CASE("torn trailing record dropped", "[WriteBack]") {
+	std::string path = journalPath("torn");
+	{
+		MyCacheWriteBack writeback(0, path);
+		REQUIRE(writeback.open());
+		REQUIRE(writeback.push("a", "1", 10));
+		REQUIRE(writeback.push("b", "2", 11));
+	}
+
+	// crashed in the middle of a record: op, key length and part of the key
+	FILE* fp = fopen(path.c_str(), "ab");
+	REQUIRE(fp);
+	uint8_t op = 0;
+	uint32_t size = 100;
+	fwrite(&op, sizeof(op), 1, fp);
+	fwrite(&size, sizeof(size), 1, fp);
+	fwrite("cc", 2, 1, fp);
+	fclose(fp);
+
+	{
+		MyCacheWriteBack writeback(0, path);
+		REQUIRE(writeback.open());
+		REQUIRE(writeback.pending() == 2);
+
+		MyCacheWriteBack::Entry entry;
+		REQUIRE_FALSE(writeback.lookup("cc", entry));
+
+		// the journal was rewritten without the tail, new records still count
+		REQUIRE(writeback.push("c", "3", 12));
+	}
+
+	MyCacheWriteBack writeback(0, path);
+	REQUIRE(writeback.open());
+	REQUIRE(writeback.pending() == 3);
+
+	MyCacheWriteBack::Entry entry;
+	REQUIRE(writeback.lookup("c", entry));
+	REQUIRE(entry.value == "3");
+
+	remove(path.c_str());
+}
+
+TEST_CASE("older versions don't replace newer ones", "[WriteBack]") {
+	std::string path = journalPath("version");
+	{
+		MyCacheWriteBack writeback(0, path);
+		REQUIRE(writeback.open());
+		REQUIRE(writeback.push("a", "B", 20));
+		REQUIRE(writeback.push("a", "A", 19));
+
+		MyCacheWriteBack::Entry entry;
+		REQUIRE(writeback.lookup("a", entry));
+		REQUIRE(entry.value == "B");
+	}
+
+	MyCacheWriteBack writeback(0, path);
+	REQUIRE(writeback.open());
+
+	MyCacheWriteBack::Entry entry;
+	REQUIRE(writeback.lookup("a", entry));
+	REQUIRE(entry.value == "B");
+	REQUIRE(entry.version == 20);
+
+	remove(path.c_str());
+}
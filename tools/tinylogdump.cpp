@@ -0,0 +1,296 @@
+//
+// Render binary logs written by SimpleLogger::start_async(..., true)
+//
+//   protoc -I. --include_imports --descriptor_set_out=protos.desc *.proto
+//   tinylogdump [-d protos.desc] ... logfile ...
+//
+// Protobuf arguments are decoded with the messages in the descriptor
+// sets, unknown types are shown as <type:size bytes>.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+
+#include "tinylogger.h"
+
+using namespace google::protobuf;
+
+struct Site {
+    int level = 0;
+    std::string name;
+    std::string fmt;
+    std::string file;
+    uint32_t line = 0;
+};
+
+struct Reader {
+    Reader(const char *data, size_t size) : p(data), end(data + size) {}
+
+    template<typename T>
+    bool pod(T &v) {
+        if ((size_t) (end - p) < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool str(std::string &s) {
+        uint32_t n = 0;
+        if (!pod(n) || (size_t) (end - p) < n) return false;
+        s.assign(p, n);
+        p += n;
+        return true;
+    }
+
+    const char *p;
+    const char *end;
+};
+
+class LogDumper {
+public:
+    LogDumper(DescriptorPool const *pool) : pool_(pool) {}
+
+    bool dump(const std::string &filename) {
+        std::ifstream ifs(filename, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "open failed: " << filename << std::endl;
+            return false;
+        }
+        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+        // a site record may come after its first events, so each session is read twice
+        size_t session = 0;
+        while (session < content.size()) {
+            size_t next = scan(content, session);
+            render(content, session, next);
+            session = next;
+        }
+        return true;
+    }
+
+private:
+    bool record(const std::string &content, size_t pos, uint32_t &size, uint8_t &kind) {
+        Reader r(content.data() + pos, content.size() - pos);
+        if (!r.pod(size) || !r.pod(kind) || size < sizeof(size) + sizeof(kind) || pos + size > content.size())
+            return false;
+        return true;
+    }
+
+    // collect sites up to the next session head
+    size_t scan(const std::string &content, size_t begin) {
+        sites_.clear();
+
+        size_t pos = begin;
+        uint32_t size = 0;
+        uint8_t kind = 0;
+        while (pos < content.size() && record(content, pos, size, kind)) {
+            if (kind == TINYLOG_RECORD_HEAD && pos != begin)
+                return pos;
+
+            if (kind == TINYLOG_RECORD_SITE) {
+                Reader r(content.data() + pos + 5, size - 5);
+                uint32_t id = 0;
+                uint8_t level = 0;
+                Site site;
+                if (r.pod(id) && r.pod(level) && r.str(site.name) && r.str(site.fmt) && r.str(site.file) && r.pod(site.line)) {
+                    site.level = level;
+                    sites_[id] = site;
+                }
+            }
+            pos += size;
+        }
+
+        if (pos < content.size())
+            std::cerr << "broken record at " << pos << std::endl;
+        return content.size();
+    }
+
+    void render(const std::string &content, size_t begin, size_t end) {
+        size_t pos = begin;
+        uint32_t size = 0;
+        uint8_t kind = 0;
+        while (pos < end && record(content, pos, size, kind)) {
+            const char *body = content.data() + pos + 5;
+            if (kind == TINYLOG_RECORD_TEXT)
+                std::cout.write(body, size - 5);
+            else if (kind == TINYLOG_RECORD_EVENT)
+                event(body, size - 5);
+            pos += size;
+        }
+    }
+
+    void event(const char *data, size_t size) {
+        Reader r(data, size);
+        uint32_t id = 0;
+        int64_t us = 0;
+        if (!r.pod(id) || !r.pod(us))
+            return;
+
+        auto it = sites_.find(id);
+        if (it == sites_.end()) {
+            std::cout << "<unknown site " << id << ">" << std::endl;
+            return;
+        }
+        const Site &site = it->second;
+
+        std::string text;
+        const char *fmt = site.fmt.c_str();
+        while (true) {
+            const char *holder = std::strstr(fmt, "{}");
+            if (!holder || r.p >= r.end) {
+                text += fmt;
+                break;
+            }
+            text.append(fmt, holder - fmt);
+            if (!arg(r, text)) {
+                text += "<broken>";
+                break;
+            }
+            fmt = holder + 2;
+        }
+
+        char nowstr[64] = "";
+        std::time_t now = us / 1000000;
+        struct tm tm;
+        localtime_r(&now, &tm);
+        std::strftime(nowstr, sizeof(nowstr), "%Y-%m-%d %H:%M:%S", &tm);
+
+        char usstr[16] = "";
+        snprintf(usstr, sizeof(usstr), ".%06d", (int) (us % 1000000));
+
+        std::cout << nowstr << usstr << " " << std::setw(5) << SimpleLogger::instance().level_name(site.level)
+                  << ": [" << site.name << "] - " << text << std::endl;
+    }
+
+    bool arg(Reader &r, std::string &out) {
+        uint8_t tag = 0;
+        if (!r.pod(tag))
+            return false;
+
+        switch (tag) {
+            case TINYLOG_ARG_INT: {
+                int64_t v = 0;
+                if (!r.pod(v)) return false;
+                out += std::to_string((long long) v);
+                return true;
+            }
+            case TINYLOG_ARG_UINT: {
+                uint64_t v = 0;
+                if (!r.pod(v)) return false;
+                out += std::to_string((unsigned long long) v);
+                return true;
+            }
+            case TINYLOG_ARG_BOOL: {
+                uint8_t v = 0;
+                if (!r.pod(v)) return false;
+                out += (v ? "true" : "false");
+                return true;
+            }
+            case TINYLOG_ARG_DOUBLE: {
+                double v = 0;
+                if (!r.pod(v)) return false;
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%g", v);
+                out += buf;
+                return true;
+            }
+            case TINYLOG_ARG_STRING: {
+                std::string v;
+                if (!r.str(v)) return false;
+                out += v;
+                return true;
+            }
+            case TINYLOG_ARG_PROTO: {
+                std::string type, bytes;
+                if (!r.str(type) || !r.str(bytes)) return false;
+                out += message(type, bytes);
+                return true;
+            }
+            case TINYLOG_ARG_TRUNCATED: {
+                std::string type;
+                uint32_t n = 0;
+                if (!r.str(type) || !r.pod(n)) return false;
+                out += "<" + type + ":" + std::to_string(n) + " bytes, truncated>";
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string message(const std::string &type, const std::string &bytes) {
+        const Descriptor *descriptor = pool_ ? pool_->FindMessageTypeByName(type) : NULL;
+        if (descriptor) {
+            std::unique_ptr<Message> msg(factory_.GetPrototype(descriptor)->New());
+            if (msg->ParsePartialFromString(bytes))
+                return msg->ShortDebugString();
+        }
+        return "<" + type + ":" + std::to_string(bytes.size()) + " bytes>";
+    }
+
+    const DescriptorPool *pool_;
+    DynamicMessageFactory factory_;
+    std::map<uint32_t, Site> sites_;
+};
+
+void usage() {
+    std::cerr << "usage: tinylogdump [-d protos.desc] ... logfile ..." << std::endl;
+}
+
+bool loadDescriptorSet(DescriptorPool &pool, const std::string &filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    FileDescriptorSet set;
+    if (!ifs || !set.ParseFromIstream(&ifs)) {
+        std::cerr << "load descriptor set failed: " << filename << std::endl;
+        return false;
+    }
+
+    for (int i = 0; i < set.file_size(); ++i) {
+        if (!pool.FindFileByName(set.file(i).name()) && !pool.BuildFile(set.file(i)))
+            std::cerr << "build failed: " << set.file(i).name() << std::endl;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    DescriptorPool pool;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:h")) != -1) {
+        switch (opt) {
+            case 'd':
+                loadDescriptorSet(pool, optarg);
+                break;
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    LogDumper dumper(&pool);
+    int rc = EXIT_SUCCESS;
+    for (int i = optind; i < argc; ++i) {
+        if (!dumper.dump(argv[i]))
+            rc = EXIT_FAILURE;
+    }
+    return rc;
+}
@@ -267,31 +267,122 @@ class StructDescription:
     def generateSerialize(self, depth, file=sys.stdout):
         printline(file, depth, '')
         printline(file, depth, 'std::string %s::serialize() const {' % self.name)
-        printline(file, depth + 1, '%sProto proto;' % self.name)
-        for f in self.fields:
-            if f.type_sql == "OBJECT":
-                printline(file, depth + 1, 'proto.set_%s(::serialize(%s));' % (f.name, f.name))
-            else:
-                printline(file, depth + 1, 'proto.set_%s(%s);' % (f.name, f.name))
-
-        printline(file, depth + 1, 'return proto.SerializeAsString();')
+        printline(file, depth + 1, 'return ::ProtoSerializer<%s>().serialize(*this);' % self.name)
         printline(file, depth, '}')
         printline(file, depth, '')
 
     def generateDeserialize(self, depth, file=sys.stdout):
         printline(file, depth, '')
         printline(file, depth, 'bool %s::deserialize(const std::string &data) {' % self.name)
-        printline(file, depth + 1, '%sProto proto;' % self.name)
-        printline(file, depth + 1, 'if (!proto.ParseFromString(data)) return false;')
-        for f in self.fields:
+        printline(file, depth + 1, 'return ::ProtoSerializer<%s>().deserialize(*this, data);' % self.name)
+        printline(file, depth, '}')
+        printline(file, depth, '')
+
+    #
+    # ProtoSerializer<T>: wire format of %sProto, written/read directly
+    #
+    def generateProtoSerializer(self, depth, file=sys.stdout):
+        cpp_name = 'tiny::%s' % self.name
+        fields = sorted(self.fields, key=lambda f: f.num)
+
+        printline(file, depth, '')
+        printline(file, depth, 'template<>')
+        printline(file, depth, 'struct ProtoSerializer<%s> {' % cpp_name)
+        printline(file, depth + 1, 'std::string serialize(const %s &obj) const {' % cpp_name)
+        printline(file, depth + 2, 'std::string data;')
+        printline(file, depth + 2, '{')
+        printline(file, depth + 3, 'google::protobuf::io::StringOutputStream stream(&data);')
+        printline(file, depth + 3, 'ProtoWire::Output os(&stream);')
+        for f in fields:
             if f.type_sql == "OBJECT":
-                printline(file, depth + 1, '::deserialize(%s, proto.%s());' % (f.name, f.name))
+                printline(file, depth + 3, 'ProtoWire::write(os, %d, ::serialize(obj.%s));' % (f.num, f.name))
             else:
-                printline(file, depth + 1, '%s = proto.%s();' % (f.name, f.name))
+                printline(file, depth + 3, 'ProtoWire::write(os, %d, obj.%s);' % (f.num, f.name))
+        printline(file, depth + 2, '}')
+        printline(file, depth + 2, 'return data;')
+        printline(file, depth + 1, '}')
+        printline(file, depth + 1, '')
+        printline(file, depth + 1, 'bool deserialize(%s &obj, const std::string &data) const {' % cpp_name)
+        printline(file, depth + 2, 'ProtoWire::Input is(reinterpret_cast<const uint8_t *>(data.data()), static_cast<int>(data.size()));')
+        printline(file, depth + 2, 'while (uint32_t tag = is.ReadTag()) {')
+        printline(file, depth + 3, 'bool ok = false;')
+        printline(file, depth + 3, 'switch (ProtoWire::WFL::GetTagFieldNumber(tag)) {')
+        for f in fields:
+            if f.type_sql == "OBJECT":
+                printline(file, depth + 4, 'case %d: {' % f.num)
+                printline(file, depth + 5, 'std::string bin;')
+                printline(file, depth + 5, 'ok = ProtoWire::read(is, tag, bin) && ::deserialize(obj.%s, bin);' % f.name)
+                printline(file, depth + 5, 'break;')
+                printline(file, depth + 4, '}')
+            else:
+                printline(file, depth + 4, 'case %d: ok = ProtoWire::read(is, tag, obj.%s); break;' % (f.num, f.name))
+        printline(file, depth + 4, 'default: ok = ProtoWire::skip(is, tag); break;')
+        printline(file, depth + 3, '}')
+        printline(file, depth + 3, 'if (!ok) return false;')
+        printline(file, depth + 2, '}')
+        printline(file, depth + 2, 'return true;')
+        printline(file, depth + 1, '}')
+        printline(file, depth, '};')
+
+    #
+    # RowCodec<T>: columns by ordinal, the same order as generateORM
+    #
+    def generateRowCodec(self, depth, file=sys.stdout):
+        cpp_name = 'tiny::%s' % self.name
 
-        printline(file, depth + 1, 'return true;')
-        printline(file, depth, '}')
         printline(file, depth, '')
+        printline(file, depth, 'template<>')
+        printline(file, depth, 'struct RowCodec<%s> {' % cpp_name)
+        printline(file, depth + 1, 'static const bool generated = true;')
+        printline(file, depth + 1, '')
+
+        printline(file, depth + 1, 'static bool decode(%s &obj, size_t ordinal, const char *data, size_t size) {' % cpp_name)
+        printline(file, depth + 2, 'switch (ordinal) {')
+        for i, f in enumerate(self.fields):
+            if f.type_sql == "OBJECT":
+                printline(file, depth + 3, 'case %d: return size == 0 || ::deserialize(obj.%s, std::string(data, size));' % (i, f.name))
+            else:
+                printline(file, depth + 3, 'case %d: return FieldText<%s>::parse(obj.%s, data, size);' % (i, f.type_cpp, f.name))
+        printline(file, depth + 2, '}')
+        printline(file, depth + 2, 'return false;')
+        printline(file, depth + 1, '}')
+        printline(file, depth + 1, '')
+
+        printline(file, depth + 1, 'static bool quoted(size_t ordinal) {')
+        printline(file, depth + 2, 'switch (ordinal) {')
+        for i, f in enumerate(self.fields):
+            if f.type_sql != "OBJECT":
+                printline(file, depth + 3, 'case %d: return FieldText<%s>::quoted;' % (i, f.type_cpp))
+        printline(file, depth + 2, '}')
+        printline(file, depth + 2, 'return true;')
+        printline(file, depth + 1, '}')
+        printline(file, depth + 1, '')
+
+        printline(file, depth + 1, 'static void encode(std::ostream &os, const %s &obj, size_t ordinal) {' % cpp_name)
+        printline(file, depth + 2, 'switch (ordinal) {')
+        for i, f in enumerate(self.fields):
+            if f.type_sql == "OBJECT":
+                printline(file, depth + 3, 'case %d: os << ::serialize(obj.%s); break;' % (i, f.name))
+            else:
+                printline(file, depth + 3, 'case %d: FieldText<%s>::write(os, obj.%s); break;' % (i, f.type_cpp, f.name))
+        printline(file, depth + 2, '}')
+        printline(file, depth + 1, '}')
+        printline(file, depth + 1, '')
+
+        printline(file, depth + 1, 'static const std::string &text(const %s &obj, size_t ordinal, std::string &buf) {' % cpp_name)
+        printline(file, depth + 2, 'switch (ordinal) {')
+        for i, f in enumerate(self.fields):
+            if f.type_sql == "OBJECT":
+                printline(file, depth + 3, 'case %d: buf = ::serialize(obj.%s); return buf;' % (i, f.name))
+            elif f.type_cpp == 'std::string':
+                printline(file, depth + 3, 'case %d: return obj.%s;' % (i, f.name))
+        printline(file, depth + 2, '}')
+        printline(file, depth + 2, 'std::ostringstream oss;')
+        printline(file, depth + 2, 'encode(oss, obj, ordinal);')
+        printline(file, depth + 2, 'buf = oss.str();')
+        printline(file, depth + 2, 'return buf;')
+        printline(file, depth + 1, '}')
+        printline(file, depth, '};')
 
 
 #############################################
@@ -348,6 +439,16 @@ class FileDescription:
             desc.generateStruct(0, outfile)
 
         printline(outfile, 0, "} // namespace tiny")
+        printline(outfile, 0, "")
+
+        # static codecs, picked up by ProtoSerializer<T> and TinyMySqlORM
+        for desc in self.descriptors:
+            desc.generateProtoSerializer(0, outfile)
+        for desc in self.descriptors:
+            if desc.need_orm:
+                desc.generateRowCodec(0, outfile)
+
+        printline(outfile, 0, "")
         printline(outfile, 0, "#endif // __TINYOBJ_%s__" % self.filename.upper())
 
         print >> sys.stderr, '[INFO] ', filepath, 'is generated.'
@@ -357,7 +458,6 @@ class FileDescription:
         filepath = output_dir + '/' + self.filename + '.cpp'
         outfile = codecs.open(filepath, 'w+', "utf-8")
         printline(outfile, 0, '#include "%s.h"' % self.filename)
-        printline(outfile, 0, '#include "%s.pb.h"' % self.filename)
         printline(outfile, 0, "")
         printline(outfile, 0, "namespace tiny {")
         for desc in self.descriptors: